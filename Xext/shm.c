@@ -57,6 +57,8 @@ in this Software without prior written authorization from The Open Group.
 #include <sys/mman.h>
 #include "protocol-versions.h"
 #include "busfault.h"
+#include "damage.h"
+#include "xacestr.h"
 
 /* Needed for Solaris cross-zone shared memory extension */
 #ifdef HAVE_SHMCTL64
@@ -121,6 +123,52 @@ static DevPrivateKeyRec shmPixmapPrivateKeyRec;
 static ShmFuncs miFuncs = { NULL, NULL };
 static ShmFuncs fbFuncs = { fbShmCreatePixmap, NULL };
 
+/*
+ * Copies of at least this many bytes between a segment and a pixmap in
+ * system memory are done on a worker thread; zero disables them
+ */
+unsigned long ShmAsyncThreshold;
+
+typedef struct _ShmAsyncJob {
+    struct xorg_list entry;
+    ClientPtr client;
+    ShmDescPtr shmdesc;
+    PixmapPtr pixmap;
+    Bool put;
+    RegionRec region;           /* pixmap coordinates */
+    char *image;                /* image origin in the segment */
+    int stride;
+    int dx, dy;                 /* image origin in pixmap coordinates */
+    int cpp;
+    Bool send;
+    union {
+        xShmCompletionEvent event;
+        xShmGetImageReply reply;
+    } u;
+} ShmAsyncJobRec, *ShmAsyncJobPtr;
+
+static WorkerPoolPtr shmAsyncPool;
+static struct xorg_list shmAsyncJobs;
+
+/*
+ * Damage tracked for ShmGetImageDamage, one per client and drawable
+ */
+typedef struct _ShmCapture {
+    struct xorg_list entry;
+    XID id;                     /* owned by the client */
+    ClientPtr client;
+    DrawablePtr pDraw;
+    DamagePtr pDamage;
+    ShmDescPtr shmdesc;         /* segment holding the previous capture */
+    CARD32 offset;
+    xRectangle rect;
+} ShmCaptureRec, *ShmCapturePtr;
+
+static RESTYPE ShmCaptureType;
+static struct xorg_list shmCaptures;
+
+#define ShmFullMask(depth) ((depth) >= 32 ? (Mask) ~0 : (((Mask) 1 << (depth)) - 1))
+
 #define ShmGetScreenPriv(s) ((ShmScrPrivateRec *)dixLookupPrivate(&(s)->devPrivates, shmScrPrivateKey))
 
 #define VERIFY_SHMSEG(shmseg,shmdesc,client) \
@@ -230,6 +278,11 @@ ShmResetProc(ExtensionEntry * extEntry)
 {
     int i;
 
+    if (shmAsyncPool) {
+        WorkerPoolDestroy(shmAsyncPool);
+        shmAsyncPool = NULL;
+    }
+
     for (i = 0; i < screenInfo.numScreens; i++)
         ShmRegisterFuncs(screenInfo.screens[i], NULL);
 }
@@ -460,6 +513,256 @@ ProcShmDetach(ClientPtr client)
     return Success;
 }
 
+/*
+ * Asynchronous transfers.
+ *
+ * A large ZPixmap image moving between a segment and a pixmap whose
+ * bits live in system memory is copied by a worker thread while the
+ * requesting client sleeps. The pixmap must be referenced only by its
+ * resource, so any other request touching it has to look it up first;
+ * such lookups wait for the pending copies, keeping them ordered after
+ * the transfer.
+ */
+
+static void
+ShmAsyncCopy(void *data)
+{
+    ShmAsyncJobPtr job = data;
+    PixmapPtr pPixmap = job->pixmap;
+    BoxPtr pbox = RegionRects(&job->region);
+    int nbox = RegionNumRects(&job->region);
+
+    for (; nbox--; pbox++) {
+        int len = (pbox->x2 - pbox->x1) * job->cpp;
+        int h = pbox->y2 - pbox->y1;
+        char *bits = (char *) pPixmap->devPrivate.ptr +
+            pbox->y1 * pPixmap->devKind + pbox->x1 * job->cpp;
+        char *image = job->image +
+            (pbox->y1 - job->dy) * job->stride +
+            (pbox->x1 - job->dx) * job->cpp;
+
+        while (h--) {
+            if (job->put)
+                memcpy(bits, image, len);
+            else
+                memcpy(image, bits, len);
+            bits += pPixmap->devKind;
+            image += job->stride;
+        }
+    }
+}
+
+static void
+ShmAsyncDone(void *data)
+{
+    ShmAsyncJobPtr job = data;
+    ClientPtr client = job->client;
+
+    xorg_list_del(&job->entry);
+
+    if (job->put)
+        DamageDamageRegion(&job->pixmap->drawable, &job->region);
+
+    if (client) {
+        if (job->send) {
+            if (job->put)
+                WriteEventsToClient(client, 1, (xEvent *) &job->u.event);
+            else
+                WriteToClient(client, sizeof(xShmGetImageReply),
+                              &job->u.reply);
+        }
+        ClientWakeup(client);
+    }
+
+    RegionUninit(&job->region);
+    dixDestroyPixmap(job->pixmap, 0);
+    ShmDetachSegment(job->shmdesc, 0);
+    free(job);
+}
+
+/*
+ * Only called if the client goes away while its copy is pending
+ */
+static Bool
+ShmAsyncWakeClient(ClientPtr client, void *closure)
+{
+    ShmAsyncJobPtr job = closure;
+
+    job->client = NULL;
+    ClientWakeup(client);
+    return TRUE;
+}
+
+#ifdef XACE
+static void
+ShmAsyncResourceAccess(CallbackListPtr *pcbl, void *unused, void *calldata)
+{
+    XaceResourceAccessRec *rec = calldata;
+    ShmAsyncJobPtr job;
+
+    if (rec->rtype != RT_PIXMAP)
+        return;
+
+    xorg_list_for_each_entry(job, &shmAsyncJobs, entry) {
+        if (job->pixmap == rec->res) {
+            WorkerPoolDrain(shmAsyncPool);
+            return;
+        }
+    }
+}
+#endif
+
+static Bool
+ShmAsyncEligible(DrawablePtr pDraw, int depth, unsigned long size)
+{
+    PixmapPtr pPixmap = (PixmapPtr) pDraw;
+
+    if (!shmAsyncPool || size < ShmAsyncThreshold)
+        return FALSE;
+#ifdef PANORAMIX
+    if (!noPanoramiXExtension)
+        return FALSE;
+#endif
+    if (pDraw->type != DRAWABLE_PIXMAP)
+        return FALSE;
+    if (ShmGetScreenPriv(pDraw->pScreen)->shmFuncs != &fbFuncs)
+        return FALSE;
+    if (!pPixmap->devPrivate.ptr || pPixmap->refcnt != 1)
+        return FALSE;
+    if (pDraw->bitsPerPixel < 8 || pDraw->bitsPerPixel != BitsPerPixel(depth))
+        return FALSE;
+    return TRUE;
+}
+
+static Bool
+ShmAsyncQueue(ClientPtr client, ShmAsyncJobPtr job)
+{
+    if (RegionNil(&job->region))
+        goto bail;
+
+    if (!ClientSleep(client, ShmAsyncWakeClient, job))
+        goto bail;
+
+    job->client = client;
+    job->pixmap->refcnt++;
+    job->shmdesc->refcnt++;
+    xorg_list_append(&job->entry, &shmAsyncJobs);
+
+    if (!WorkerPoolQueue(shmAsyncPool, ShmAsyncCopy, ShmAsyncDone, job)) {
+        xorg_list_del(&job->entry);
+        ClientWakeup(client);
+        dixDestroyPixmap(job->pixmap, 0);
+        ShmDetachSegment(job->shmdesc, 0);
+        goto bail;
+    }
+    return TRUE;
+
+bail:
+    RegionUninit(&job->region);
+    free(job);
+    return FALSE;
+}
+
+static Bool
+ShmAsyncPutImage(ClientPtr client, DrawablePtr pDraw, GCPtr pGC,
+                 ShmDescPtr shmdesc, long length)
+{
+    ShmAsyncJobPtr job;
+    BoxRec box;
+
+    REQUEST(xShmPutImageReq);
+
+    if (stuff->format != ZPixmap ||
+        !ShmAsyncEligible(pDraw, stuff->depth,
+                          length * (unsigned long) stuff->srcHeight))
+        return FALSE;
+
+    if (pGC->alu != GXcopy || !pGC->pCompositeClip ||
+        (pGC->planemask & ShmFullMask(pDraw->depth)) != ShmFullMask(pDraw->depth))
+        return FALSE;
+
+    job = calloc(1, sizeof(ShmAsyncJobRec));
+    if (!job)
+        return FALSE;
+
+    job->put = TRUE;
+    job->shmdesc = shmdesc;
+    job->pixmap = (PixmapPtr) pDraw;
+    job->image = shmdesc->addr + stuff->offset;
+    job->stride = length;
+    job->dx = stuff->dstX - stuff->srcX;
+    job->dy = stuff->dstY - stuff->srcY;
+    job->cpp = pDraw->bitsPerPixel >> 3;
+
+    /* Snapshot the clip, later changes to the GC must not affect the copy */
+    box.x1 = stuff->dstX;
+    box.y1 = stuff->dstY;
+    box.x2 = stuff->dstX + stuff->srcWidth;
+    box.y2 = stuff->dstY + stuff->srcHeight;
+    RegionInit(&job->region, &box, 1);
+    RegionIntersect(&job->region, &job->region, pGC->pCompositeClip);
+
+    if (stuff->sendEvent) {
+        job->send = TRUE;
+        job->u.event = (xShmCompletionEvent) {
+            .type = ShmCompletionCode,
+            .drawable = stuff->drawable,
+            .minorEvent = X_ShmPutImage,
+            .majorEvent = ShmReqCode,
+            .shmseg = stuff->shmseg,
+            .offset = stuff->offset
+        };
+    }
+
+    return ShmAsyncQueue(client, job);
+}
+
+static Bool
+ShmAsyncGetImage(ClientPtr client, DrawablePtr pDraw, ShmDescPtr shmdesc,
+                 xShmGetImageReply *xgi)
+{
+    ShmAsyncJobPtr job;
+    BoxRec box;
+
+    REQUEST(xShmGetImageReq);
+
+    if (stuff->format != ZPixmap || !ShmAsyncEligible(pDraw, pDraw->depth, xgi->size))
+        return FALSE;
+
+    if ((stuff->planeMask & ShmFullMask(pDraw->depth)) != ShmFullMask(pDraw->depth))
+        return FALSE;
+
+    job = calloc(1, sizeof(ShmAsyncJobRec));
+    if (!job)
+        return FALSE;
+
+    job->put = FALSE;
+    job->shmdesc = shmdesc;
+    job->pixmap = (PixmapPtr) pDraw;
+    job->image = shmdesc->addr + stuff->offset;
+    job->stride = PixmapBytePad(stuff->width, pDraw->depth);
+    job->dx = stuff->x;
+    job->dy = stuff->y;
+    job->cpp = pDraw->bitsPerPixel >> 3;
+
+    box.x1 = stuff->x;
+    box.y1 = stuff->y;
+    box.x2 = stuff->x + stuff->width;
+    box.y2 = stuff->y + stuff->height;
+    RegionInit(&job->region, &box, 1);
+
+    job->send = TRUE;
+    job->u.reply = *xgi;
+    if (client->swapped) {
+        swaps(&job->u.reply.sequenceNumber);
+        swapl(&job->u.reply.length);
+        swapl(&job->u.reply.visual);
+        swapl(&job->u.reply.size);
+    }
+
+    return ShmAsyncQueue(client, job);
+}
+
 /*
  * If the given request doesn't exactly match PutImage's constraints,
  * wrap the image in a scratch pixmap header and let CopyArea sort it out.
@@ -574,6 +877,9 @@ ProcShmPutImage(ClientPtr client)
         return BadValue;
     }
 
+    if (ShmAsyncPutImage(client, pDraw, pGC, shmdesc, length))
+        return Success;
+
     if ((((stuff->format == ZPixmap) && (stuff->srcX == 0)) ||
          ((stuff->format != ZPixmap) &&
           (stuff->srcX < screenInfo.bitmapScanlinePad) &&
@@ -681,6 +987,9 @@ ProcShmGetImage(ClientPtr client)
     VERIFY_SHMSIZE(shmdesc, stuff->offset, length, client);
     xgi.size = length;
 
+    if (length && ShmAsyncGetImage(client, pDraw, shmdesc, &xgi))
+        return Success;
+
     if (length == 0) {
         /* nothing to do */
     }
@@ -729,6 +1038,336 @@ ProcShmGetImage(ClientPtr client)
     return Success;
 }
 
+/*
+ * Damage-driven capture.
+ *
+ * Each client capturing a drawable gets a damage object accumulating
+ * changes between captures. As long as the client keeps capturing the
+ * same rectangle into the same place, only the damaged boxes are
+ * fetched; anything else starts over with a full capture.
+ */
+
+static void
+ShmCaptureDamageDestroy(DamagePtr pDamage, void *closure)
+{
+    ShmCapturePtr capture = closure;
+
+    capture->pDamage = NULL;
+    if (capture->id)
+        FreeResource(capture->id, RT_NONE);
+}
+
+static int
+ShmCaptureFree(void *value, XID id)
+{
+    ShmCapturePtr capture = value;
+
+    capture->id = 0;
+    xorg_list_del(&capture->entry);
+    if (capture->pDamage)
+        DamageDestroy(capture->pDamage);
+    if (capture->shmdesc)
+        ShmDetachSegment(capture->shmdesc, 0);
+    free(capture);
+    return Success;
+}
+
+static ShmCapturePtr
+ShmCaptureFind(ClientPtr client, DrawablePtr pDraw)
+{
+    ShmCapturePtr capture;
+
+    xorg_list_for_each_entry(capture, &shmCaptures, entry) {
+        if (capture->client == client && capture->pDraw == pDraw)
+            return capture;
+    }
+    return NULL;
+}
+
+static ShmCapturePtr
+ShmCaptureGet(ClientPtr client, DrawablePtr pDraw)
+{
+    ShmCapturePtr capture;
+
+    capture = ShmCaptureFind(client, pDraw);
+    if (capture)
+        return capture;
+
+    capture = calloc(1, sizeof(ShmCaptureRec));
+    if (!capture)
+        return NULL;
+
+    capture->client = client;
+    capture->pDraw = pDraw;
+    capture->id = FakeClientID(client->index);
+    capture->pDamage = DamageCreate(NULL, ShmCaptureDamageDestroy,
+                                    DamageReportNone, FALSE,
+                                    pDraw->pScreen, capture);
+    if (!capture->pDamage) {
+        free(capture);
+        return NULL;
+    }
+    xorg_list_add(&capture->entry, &shmCaptures);
+
+    if (!AddResource(capture->id, ShmCaptureType, capture))
+        return NULL;
+
+    DamageRegister(pDraw, capture->pDamage);
+    return capture;
+}
+
+/*
+ * Clip the damage accumulated since the previous capture to @box.
+ * Damage too fragmented to fetch box by box is fetched as its extents;
+ * sub-byte pixels are fetched in whole rows.
+ */
+void
+ShmClipCaptureDamage(RegionPtr pRegion, RegionPtr pDamaged, BoxPtr box,
+                     int bitsPerPixel)
+{
+    RegionReset(pRegion, box);
+    RegionIntersect(pRegion, pRegion, pDamaged);
+
+    if (RegionNotEmpty(pRegion) &&
+        (RegionNumRects(pRegion) > SHM_CAPTURE_MAX_RECTS ||
+         bitsPerPixel < 8)) {
+        BoxRec extents = *RegionExtents(pRegion);
+
+        if (bitsPerPixel < 8) {
+            extents.x1 = box->x1;
+            extents.x2 = box->x2;
+        }
+        RegionReset(pRegion, &extents);
+    }
+}
+
+/*
+ * Compute the region to fetch, clipped to @rect, and reset the damage
+ */
+static void
+ShmCaptureRegion(ShmCapturePtr capture, ShmDescPtr shmdesc, CARD32 offset,
+                 xRectangle *rect, RegionPtr pRegion)
+{
+    BoxRec box = {
+        .x1 = rect->x,
+        .y1 = rect->y,
+        .x2 = rect->x + rect->width,
+        .y2 = rect->y + rect->height
+    };
+
+    if (capture->shmdesc != shmdesc || capture->offset != offset ||
+        memcmp(&capture->rect, rect, sizeof(xRectangle)) != 0) {
+        if (capture->shmdesc)
+            ShmDetachSegment(capture->shmdesc, 0);
+        shmdesc->refcnt++;
+        capture->shmdesc = shmdesc;
+        capture->offset = offset;
+        capture->rect = *rect;
+        RegionReset(pRegion, &box);
+    }
+    else {
+        ShmClipCaptureDamage(pRegion, DamageRegion(capture->pDamage), &box,
+                             capture->pDraw->bitsPerPixel);
+    }
+
+    DamageEmpty(capture->pDamage);
+}
+
+static int
+ProcShmGetImageDamage(ClientPtr client)
+{
+    DrawablePtr pDraw;
+    xShmGetImageDamageReply rep;
+    ShmDescPtr shmdesc;
+    ShmCapturePtr capture;
+    RegionPtr pVisibleRegion = NULL;
+    RegionRec region;
+    xRectangle rect, *rects;
+    BoxPtr pbox;
+    char *image, *tmp = NULL;
+    long stride, length;
+    int nbox, i, rc;
+
+    REQUEST(xShmGetImageDamageReq);
+
+    REQUEST_SIZE_MATCH(xShmGetImageDamageReq);
+    rc = dixLookupDrawable(&pDraw, stuff->drawable, client, 0, DixReadAccess);
+    if (rc != Success)
+        return rc;
+    VERIFY_SHMPTR(stuff->shmseg, stuff->offset, TRUE, shmdesc, client);
+    if (pDraw->type == DRAWABLE_WINDOW) {
+        if (!((WindowPtr) pDraw)->realized ||
+            pDraw->x + stuff->x < 0 ||
+            pDraw->x + stuff->x + (int) stuff->width > pDraw->pScreen->width ||
+            pDraw->y + stuff->y < 0 ||
+            pDraw->y + stuff->y + (int) stuff->height > pDraw->pScreen->height ||
+            stuff->x < 0 || stuff->x + (int) stuff->width > pDraw->width ||
+            stuff->y < 0 || stuff->y + (int) stuff->height > pDraw->height)
+            return BadMatch;
+    }
+    else {
+        if (stuff->x < 0 ||
+            stuff->x + (int) stuff->width > pDraw->width ||
+            stuff->y < 0 || stuff->y + (int) stuff->height > pDraw->height)
+            return BadMatch;
+    }
+
+    stride = PixmapBytePad(stuff->width, pDraw->depth);
+    length = stride * stuff->height;
+    VERIFY_SHMSIZE(shmdesc, stuff->offset, length, client);
+
+    capture = ShmCaptureGet(client, pDraw);
+    if (!capture)
+        return BadAlloc;
+
+    rect = (xRectangle) {
+        .x = stuff->x,
+        .y = stuff->y,
+        .width = stuff->width,
+        .height = stuff->height
+    };
+    RegionNull(&region);
+    ShmCaptureRegion(capture, shmdesc, stuff->offset, &rect, &region);
+
+    nbox = RegionNumRects(&region);
+    pbox = RegionRects(&region);
+    rects = xallocarray(nbox, sizeof(xRectangle));
+    if (nbox && !rects) {
+        /* The segment contents are unknown now */
+        capture->rect.width = 0;
+        RegionUninit(&region);
+        return BadAlloc;
+    }
+
+    if (pDraw->type == DRAWABLE_WINDOW) {
+        pVisibleRegion = NotClippedByChildren((WindowPtr) pDraw);
+        if (pVisibleRegion)
+            RegionTranslate(pVisibleRegion, -pDraw->x, -pDraw->y);
+    }
+
+    image = shmdesc->addr + stuff->offset;
+    for (i = 0; i < nbox; i++, pbox++) {
+        int w = pbox->x2 - pbox->x1;
+        int h = pbox->y2 - pbox->y1;
+        char *dst = image + (pbox->y1 - stuff->y) * stride +
+            (pbox->x1 - stuff->x) * (pDraw->bitsPerPixel >> 3);
+
+        if (w == stuff->width) {
+            (*pDraw->pScreen->GetImage) (pDraw, pbox->x1, pbox->y1, w, h,
+                                         ZPixmap, ~0, dst);
+        }
+        else {
+            long boxStride = PixmapBytePad(w, pDraw->depth);
+            long boxLen = w * (pDraw->bitsPerPixel >> 3);
+            char *src, *bits;
+            int y;
+
+            bits = realloc(tmp, boxStride * h);
+            if (!bits) {
+                /* Rows are packed, so fetch them one at a time instead */
+                for (y = 0, bits = dst; y < h; y++, bits += stride)
+                    (*pDraw->pScreen->GetImage) (pDraw, pbox->x1,
+                                                 pbox->y1 + y, w, 1,
+                                                 ZPixmap, ~0, bits);
+            }
+            else {
+                tmp = bits;
+                (*pDraw->pScreen->GetImage) (pDraw, pbox->x1, pbox->y1, w, h,
+                                             ZPixmap, ~0, tmp);
+                for (src = tmp, bits = dst; h--;
+                     src += boxStride, bits += stride)
+                    memcpy(bits, src, boxLen);
+            }
+        }
+
+        if (pVisibleRegion)
+            XaceCensorImage(client, pVisibleRegion, stride, pDraw,
+                            pbox->x1, pbox->y1, w, pbox->y2 - pbox->y1,
+                            ZPixmap, dst);
+
+        rects[i] = (xRectangle) {
+            .x = pbox->x1,
+            .y = pbox->y1,
+            .width = w,
+            .height = pbox->y2 - pbox->y1
+        };
+    }
+
+    free(tmp);
+    if (pVisibleRegion)
+        RegionDestroy(pVisibleRegion);
+    RegionUninit(&region);
+
+    rep = (xShmGetImageDamageReply) {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = bytes_to_int32(nbox * sizeof(xRectangle)),
+        .visual = pDraw->type == DRAWABLE_WINDOW ?
+            wVisual((WindowPtr) pDraw) : None,
+        .depth = pDraw->depth,
+        .size = length,
+        .nRects = nbox
+    };
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swapl(&rep.visual);
+        swapl(&rep.size);
+        swapl(&rep.nRects);
+        SwapShorts((short *) rects, nbox * 4);
+    }
+    WriteToClient(client, sizeof(xShmGetImageDamageReply), &rep);
+    if (nbox)
+        WriteToClient(client, nbox * sizeof(xRectangle), rects);
+    free(rects);
+
+    return Success;
+}
+
+static int
+ProcShmReleaseImageDamage(ClientPtr client)
+{
+    DrawablePtr pDraw;
+    ShmCapturePtr capture;
+    int rc;
+
+    REQUEST(xShmReleaseImageDamageReq);
+
+    REQUEST_SIZE_MATCH(xShmReleaseImageDamageReq);
+    rc = dixLookupDrawable(&pDraw, stuff->drawable, client, 0, DixReadAccess);
+    if (rc != Success)
+        return rc;
+
+    capture = ShmCaptureFind(client, pDraw);
+    if (capture)
+        FreeResource(capture->id, RT_NONE);
+
+    return Success;
+}
+
+static int
+ProcShmCaptureQueryVersion(ClientPtr client)
+{
+    xShmCaptureQueryVersionReply rep = {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = 0,
+        .majorVersion = SERVER_SHM_CAPTURE_MAJOR_VERSION,
+        .minorVersion = SERVER_SHM_CAPTURE_MINOR_VERSION,
+    };
+
+    REQUEST_SIZE_MATCH(xShmCaptureQueryVersionReq);
+
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swaps(&rep.majorVersion);
+        swaps(&rep.minorVersion);
+    }
+    WriteToClient(client, sizeof(xShmCaptureQueryVersionReply), &rep);
+    return Success;
+}
+
 #ifdef PANORAMIX
 static int
 ProcPanoramiXShmPutImage(ClientPtr client)
@@ -1431,6 +2070,41 @@ SProcShmCreatePixmap(ClientPtr client)
     return ProcShmCreatePixmap(client);
 }
 
+static int _X_COLD
+SProcShmGetImageDamage(ClientPtr client)
+{
+    REQUEST(xShmGetImageDamageReq);
+    swaps(&stuff->length);
+    REQUEST_SIZE_MATCH(xShmGetImageDamageReq);
+    swapl(&stuff->drawable);
+    swaps(&stuff->x);
+    swaps(&stuff->y);
+    swaps(&stuff->width);
+    swaps(&stuff->height);
+    swapl(&stuff->shmseg);
+    swapl(&stuff->offset);
+    return ProcShmGetImageDamage(client);
+}
+
+static int _X_COLD
+SProcShmReleaseImageDamage(ClientPtr client)
+{
+    REQUEST(xShmReleaseImageDamageReq);
+    swaps(&stuff->length);
+    REQUEST_SIZE_MATCH(xShmReleaseImageDamageReq);
+    swapl(&stuff->drawable);
+    return ProcShmReleaseImageDamage(client);
+}
+
+static int _X_COLD
+SProcShmCaptureQueryVersion(ClientPtr client)
+{
+    REQUEST(xShmCaptureQueryVersionReq);
+
+    swaps(&stuff->length);
+    return ProcShmCaptureQueryVersion(client);
+}
+
 #ifdef SHM_FD_PASSING
 static int _X_COLD
 SProcShmAttachFd(ClientPtr client)
@@ -1483,6 +2157,40 @@ SProcShmDispatch(ClientPtr client)
     }
 }
 
+static int
+ProcShmCaptureDispatch(ClientPtr client)
+{
+    REQUEST(xReq);
+
+    switch (stuff->data) {
+    case X_ShmCaptureQueryVersion:
+        return ProcShmCaptureQueryVersion(client);
+    case X_ShmGetImageDamage:
+        return ProcShmGetImageDamage(client);
+    case X_ShmReleaseImageDamage:
+        return ProcShmReleaseImageDamage(client);
+    default:
+        return BadRequest;
+    }
+}
+
+static int _X_COLD
+SProcShmCaptureDispatch(ClientPtr client)
+{
+    REQUEST(xReq);
+
+    switch (stuff->data) {
+    case X_ShmCaptureQueryVersion:
+        return SProcShmCaptureQueryVersion(client);
+    case X_ShmGetImageDamage:
+        return SProcShmGetImageDamage(client);
+    case X_ShmReleaseImageDamage:
+        return SProcShmReleaseImageDamage(client);
+    default:
+        return BadRequest;
+    }
+}
+
 void
 ShmExtensionInit(void)
 {
@@ -1520,7 +2228,9 @@ ShmExtensionInit(void)
             }
     }
     ShmSegType = CreateNewResourceType(ShmDetachSegment, "ShmSeg");
-    if (ShmSegType &&
+    ShmCaptureType = CreateNewResourceType(ShmCaptureFree, "ShmCapture");
+    xorg_list_init(&shmCaptures);
+    if (ShmSegType && ShmCaptureType &&
         (extEntry = AddExtension(SHMNAME, ShmNumberEvents, ShmNumberErrors,
                                  ProcShmDispatch, SProcShmDispatch,
                                  ShmResetProc, StandardMinorOpcode))) {
@@ -1529,5 +2239,22 @@ ShmExtensionInit(void)
         BadShmSegCode = extEntry->errorBase;
         SetResourceTypeErrorValue(ShmSegType, BadShmSegCode);
         EventSwapVector[ShmCompletionCode] = (EventSwapPtr) SShmCompletionEvent;
+
+        /* Damage-driven capture into MIT-SHM segments */
+        AddExtension(SHM_CAPTURE_NAME, 0, 0,
+                     ProcShmCaptureDispatch, SProcShmCaptureDispatch,
+                     NULL, StandardMinorOpcode);
     }
+
+    xorg_list_init(&shmAsyncJobs);
+#ifdef XACE
+    if (ShmAsyncThreshold &&
+        XaceRegisterCallback(XACE_RESOURCE_ACCESS, ShmAsyncResourceAccess, NULL)) {
+        shmAsyncPool = WorkerPoolCreate("ShmAsync", 1);
+        if (shmAsyncPool && !WorkerPoolThreads(shmAsyncPool)) {
+            WorkerPoolDestroy(shmAsyncPool);
+            shmAsyncPool = NULL;
+        }
+    }
+#endif
 }
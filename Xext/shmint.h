@@ -28,6 +28,7 @@
 #include "screenint.h"
 #include "pixmap.h"
 #include "gc.h"
+#include "regionstr.h"
 
 #define XSHM_PUT_IMAGE_ARGS \
     DrawablePtr		/* dst */, \
@@ -51,6 +52,92 @@
     int		/* depth */, \
     char *                      /* addr */
 
+/*
+ * XORG-SHM-CAPTURE is a server private extension, not part of the MIT-SHM
+ * protocol; its requests take MIT-SHM segments and report MIT-SHM errors,
+ * and it is only present along with MIT-SHM.
+ *
+ * ShmGetImageDamage: like ShmGetImage with a ZPixmap format and all planes,
+ * but only the parts of the rectangle damaged since the client's previous
+ * capture of the drawable into the same segment and offset are written.
+ * The reply is followed by nRects rectangles, in drawable coordinates,
+ * covering everything that was updated.
+ *
+ * The first capture of a drawable starts tracking its damage for the
+ * client, and the segment last captured into stays referenced even if the
+ * client detaches it. Both last until ShmReleaseImageDamage is sent for
+ * the drawable, the drawable is destroyed or the client disconnects.
+ */
+#define SHM_CAPTURE_NAME                "XORG-SHM-CAPTURE"
+
+#define X_ShmCaptureQueryVersion        0
+#define X_ShmGetImageDamage             1
+#define X_ShmReleaseImageDamage         2
+
+typedef struct _ShmCaptureQueryVersion {
+    CARD8 reqType;              /* always ShmCaptureReqCode */
+    CARD8 captureReqType;       /* always X_ShmCaptureQueryVersion */
+    CARD16 length;
+} xShmCaptureQueryVersionReq;
+
+#define sz_xShmCaptureQueryVersionReq   4
+
+typedef struct {
+    BYTE type;                  /* X_Reply */
+    CARD8 pad0;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD16 majorVersion;
+    CARD16 minorVersion;
+    CARD32 pad1;
+    CARD32 pad2;
+    CARD32 pad3;
+    CARD32 pad4;
+    CARD32 pad5;
+} xShmCaptureQueryVersionReply;
+
+#define sz_xShmCaptureQueryVersionReply 32
+
+typedef struct _ShmGetImageDamage {
+    CARD8 reqType;              /* always ShmCaptureReqCode */
+    CARD8 captureReqType;       /* always X_ShmGetImageDamage */
+    CARD16 length;
+    CARD32 drawable;
+    INT16 x, y;
+    CARD16 width, height;
+    CARD32 shmseg;
+    CARD32 offset;
+} xShmGetImageDamageReq;
+
+#define sz_xShmGetImageDamageReq        24
+
+typedef struct {
+    BYTE type;                  /* X_Reply */
+    CARD8 depth;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD32 visual;
+    CARD32 size;
+    CARD32 nRects;
+    CARD32 pad0;
+    CARD32 pad1;
+    CARD32 pad2;
+} xShmGetImageDamageReply;
+
+#define sz_xShmGetImageDamageReply      32
+
+typedef struct _ShmReleaseImageDamage {
+    CARD8 reqType;              /* always ShmCaptureReqCode */
+    CARD8 captureReqType;       /* always X_ShmReleaseImageDamage */
+    CARD16 length;
+    CARD32 drawable;
+} xShmReleaseImageDamageReq;
+
+#define sz_xShmReleaseImageDamageReq    8
+
+/* Damage more fragmented than this is captured as its extents */
+#define SHM_CAPTURE_MAX_RECTS   64
+
 typedef struct _ShmFuncs {
     PixmapPtr (*CreatePixmap) (XSHM_CREATE_PIXMAP_ARGS);
     void (*PutImage) (XSHM_PUT_IMAGE_ARGS);
@@ -86,6 +173,12 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  ShmRegisterFbFuncs(ScreenPtr pScreen);
 
+extern _X_EXPORT unsigned long ShmAsyncThreshold;
+
+extern void
+ShmClipCaptureDamage(RegionPtr pRegion, RegionPtr pDamaged, BoxPtr box,
+                     int bitsPerPixel);
+
 extern _X_EXPORT RESTYPE ShmSegType;
 extern _X_EXPORT int ShmCompletionCode;
 extern _X_EXPORT int BadShmSegCode;
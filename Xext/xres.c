@@ -51,7 +51,7 @@ typedef struct {
     int           numIds;
     int           resultBytes;
     struct xorg_list   response;
-    int           sentClientMasks[MAXCLIENTS];
+    int          *sentClientMasks; /* indexed by client */
 } ConstructClientIdCtx;
 
 /** @brief Holds the structure for information required to
@@ -142,13 +142,14 @@ DestroyFragments(struct xorg_list *frags)
 
 /** @brief Constructs a context record for ConstructClientId* functions
            to use */
-static void
+static Bool
 InitConstructClientIdCtx(ConstructClientIdCtx *ctx)
 {
     ctx->numIds = 0;
     ctx->resultBytes = 0;
     xorg_list_init(&ctx->response);
-    memset(ctx->sentClientMasks, 0, sizeof(ctx->sentClientMasks));
+    ctx->sentClientMasks = calloc(currentMaxClients, sizeof(int));
+    return ctx->sentClientMasks != NULL;
 }
 
 /** @brief Destroys a context record, releases all memory (except the storage
@@ -157,6 +158,7 @@ static void
 DestroyConstructClientIdCtx(ConstructClientIdCtx *ctx)
 {
     DestroyFragments(&ctx->response);
+    free(ctx->sentClientMasks);
 }
 
 static Bool
@@ -568,12 +570,13 @@ ProcXResQueryClientIds (ClientPtr client)
     int                       rc;
     ConstructClientIdCtx      ctx;
 
-    InitConstructClientIdCtx(&ctx);
-
     REQUEST_AT_LEAST_SIZE(xXResQueryClientIdsReq);
     REQUEST_FIXED_SIZE(xXResQueryClientIdsReq,
                        stuff->numSpecs * sizeof(specs[0]));
 
+    if (!InitConstructClientIdCtx(&ctx))
+        return BadAlloc;
+
     rc = ConstructClientIds(client, stuff->numSpecs, specs, &ctx);
 
     if (rc == Success) {
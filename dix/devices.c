@@ -1342,8 +1342,7 @@ InitValuatorClassDeviceStruct(DeviceIntPtr dev, int numAxes, Atom *labels,
 
     valc->sourceid = dev->id;
     valc->motion = NULL;
-    valc->first_motion = 0;
-    valc->last_motion = 0;
+    valc->motion_count = 0;
     valc->h_scroll_axis = -1;
     valc->v_scroll_axis = -1;
 
@@ -161,6 +161,8 @@ static void KillAllClients(void);
 
 static int nextFreeClientID;    /* always MIN free client ID */
 
+static int clientsSize;         /* number of entries in clients[] */
+
 static int nClients;            /* number of authorized clients */
 
 CallbackListPtr ClientStateCallback;
@@ -1270,7 +1272,6 @@ ProcCloseFont(ClientPtr client)
 int
 ProcQueryFont(ClientPtr client)
 {
-    xQueryFontReply *reply;
     FontPtr pFont;
     int rc;
 
@@ -1281,36 +1282,7 @@ ProcQueryFont(ClientPtr client)
     if (rc != Success)
         return rc;
 
-    {
-        xCharInfo *pmax = FONTINKMAX(pFont);
-        xCharInfo *pmin = FONTINKMIN(pFont);
-        int nprotoxcistructs;
-        int rlength;
-
-        nprotoxcistructs = (pmax->rightSideBearing == pmin->rightSideBearing &&
-                            pmax->leftSideBearing == pmin->leftSideBearing &&
-                            pmax->descent == pmin->descent &&
-                            pmax->ascent == pmin->ascent &&
-                            pmax->characterWidth == pmin->characterWidth) ?
-            0 : N2dChars(pFont);
-
-        rlength = sizeof(xQueryFontReply) +
-            FONTINFONPROPS(FONTCHARSET(pFont)) * sizeof(xFontProp) +
-            nprotoxcistructs * sizeof(xCharInfo);
-        reply = calloc(1, rlength);
-        if (!reply) {
-            return BadAlloc;
-        }
-
-        reply->type = X_Reply;
-        reply->length = bytes_to_int32(rlength - sizeof(xGenericReply));
-        reply->sequenceNumber = client->sequence;
-        QueryFont(pFont, reply, nprotoxcistructs);
-
-        WriteReplyToClient(client, rlength, reply);
-        free(reply);
-        return Success;
-    }
+    return SendQueryFontReply(client, pFont);
 }
 
 int
@@ -3501,6 +3473,25 @@ KillAllClients(void)
         }
 }
 
+/**
+ * Make room in clients[] for every client index an XID can carry with the
+ * current client limit, so that clients[CLIENT_ID(id)] may be looked up
+ * for any id.  LimitClients may still be raised by the DDX once the server
+ * client exists, so this is checked again for every new client.
+ */
+void
+InitClientsTable(void)
+{
+    int size = 1 << ResourceClientBits();
+
+    if (size <= clientsSize)
+        return;
+
+    clients = xnfreallocarray(clients, size, sizeof(ClientPtr));
+    memset(clients + clientsSize, 0, (size - clientsSize) * sizeof(ClientPtr));
+    clientsSize = size;
+}
+
 void
 InitClient(ClientPtr client, int i, void *ospriv)
 {
@@ -3531,8 +3522,10 @@ NextAvailableClient(void *ospriv)
     ClientPtr client;
     xReq data;
 
+    InitClientsTable();
+
     i = nextFreeClientID;
-    if (i == LimitClients)
+    if (i >= LimitClients)
         return (ClientPtr) NULL;
     clients[i] = client =
         dixAllocateObjectWithPrivates(ClientRec, PRIVATE_CLIENT);
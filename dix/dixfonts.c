@@ -86,6 +86,71 @@ static int size_slept_fpes = 0;
 static FontPathElementPtr *slept_fpes = (FontPathElementPtr *) 0;
 static xfont2_pattern_cache_ptr patternCache;
 
+/*
+ * Fonts are kept open for a while after the last client closes them, so
+ * that applications which open the same fonts each time they start find
+ * them, glyphs and all, in the pattern cache.  The list is ordered from
+ * the most to the least recently opened, and holds a reference to each
+ * font along with the name it was first opened by.
+ */
+#define FONT_RETAIN_MAX 32
+
+typedef struct {
+    FontPtr font;
+    char *name;
+    int len;
+} RetainedFontRec;
+
+static RetainedFontRec retained_fonts[FONT_RETAIN_MAX];
+static int num_retained_fonts;
+
+/* Fonts to open again in the background after a server reset */
+static RetainedFontRec prefetch_fonts[FONT_RETAIN_MAX];
+static int num_prefetch_fonts;
+static Bool prefetch_queued;
+
+/* Font private holding the reply to QueryFont */
+static int query_font_index = -1;
+
+#define FONT_OPEN_REPORT_INTERVAL 10000000      /* us */
+
+/*
+ * Replies to ListFonts and ListFontsWithInfo, by pattern and maximum
+ * number of names, most recently used first.  The font path elements only
+ * rescan their directories when the font path is set, so the replies stay
+ * valid until then.  Listings which had to wait for a font server aren't
+ * kept, as its fonts may change behind our back.
+ *
+ * The data is what follows the reply for ListFonts, and the replies with
+ * their names for ListFontsWithInfo, each padded to 4 bytes as on the
+ * wire.
+ */
+#define FONT_LIST_CACHE_MAX 16
+
+typedef struct _FontListCache {
+    struct _FontListCache *next;
+    CARD8 reqType;
+    int max_names;
+    int patlen;
+    char pattern[XLFDMAXFONTNAMELEN];
+    int nreplies;
+    int length;
+    int size;
+    char *data;
+} FontListCacheRec, *FontListCachePtr;
+
+static FontListCachePtr font_list_cache;
+
+static struct {
+    unsigned opened;
+    unsigned cached;
+    unsigned suspended;
+    unsigned failed;
+    CARD64 latency;
+    CARD64 latency_max;
+    CARD64 report_time;
+} FontOpenStats;
+
 static int
 FontToXError(int err)
 {
@@ -229,6 +294,88 @@ FreeFPE(FontPathElementPtr fpe)
     }
 }
 
+static void
+FontOpenAccount(CARD64 start, Bool cached, Bool suspended, Bool failed)
+{
+    CARD64 now = GetTimeInMicros();
+
+    FontOpenStats.opened++;
+    FontOpenStats.cached += cached;
+    FontOpenStats.suspended += suspended;
+    FontOpenStats.failed += failed;
+    FontOpenStats.latency += now - start;
+    FontOpenStats.latency_max = max(FontOpenStats.latency_max, now - start);
+
+    if (!FontOpenStats.report_time)
+        FontOpenStats.report_time = now;
+    if (now - FontOpenStats.report_time < FONT_OPEN_REPORT_INTERVAL)
+        return;
+
+    LogMessageVerb(X_INFO, 4,
+                   "Opened %u fonts, %u from the cache, %u suspended, "
+                   "%u failed, latency %llu us average, %llu us max\n",
+                   FontOpenStats.opened, FontOpenStats.cached,
+                   FontOpenStats.suspended, FontOpenStats.failed,
+                   (unsigned long long) (FontOpenStats.latency /
+                                         FontOpenStats.opened),
+                   (unsigned long long) FontOpenStats.latency_max);
+
+    memset(&FontOpenStats, 0, sizeof(FontOpenStats));
+    FontOpenStats.report_time = now;
+}
+
+static void
+ReleaseRetainedFont(int i)
+{
+    RetainedFontRec rf = retained_fonts[i];
+
+    num_retained_fonts--;
+    memmove(&retained_fonts[i], &retained_fonts[i + 1],
+            (num_retained_fonts - i) * sizeof(RetainedFontRec));
+    free(rf.name);
+    CloseFont(rf.font, (Font) 0);
+}
+
+/**
+ * Move @pfont to the front of the retained fonts, taking a reference to it
+ * if it isn't there yet, and closing the least recently used font to make
+ * room if needed.
+ */
+static void
+RetainFont(FontPtr pfont, const char *name, int len)
+{
+    RetainedFontRec rf;
+    int i;
+
+    if (!pfont->info.cachable)
+        return;
+
+    for (i = 0; i < num_retained_fonts; i++) {
+        if (retained_fonts[i].font == pfont)
+            break;
+    }
+
+    if (i < num_retained_fonts)
+        rf = retained_fonts[i];
+    else {
+        rf.name = malloc(len);
+        if (!rf.name)
+            return;
+        memcpy(rf.name, name, len);
+        rf.len = len;
+        rf.font = pfont;
+        pfont->refcnt++;
+
+        if (num_retained_fonts == FONT_RETAIN_MAX)
+            ReleaseRetainedFont(FONT_RETAIN_MAX - 1);
+        i = num_retained_fonts++;
+    }
+
+    memmove(&retained_fonts[1], &retained_fonts[0],
+            i * sizeof(RetainedFontRec));
+    retained_fonts[0] = rf;
+}
+
 static Bool
 doOpenFont(ClientPtr client, OFclosurePtr c)
 {
@@ -314,6 +461,7 @@ doOpenFont(ClientPtr client, OFclosurePtr c)
         if (err == Suspended) {
             if (!ClientIsAsleep(client))
                 ClientSleep(client, (ClientSleepProcPtr) doOpenFont, c);
+            c->suspended = TRUE;
             return TRUE;
         }
         break;
@@ -355,7 +503,9 @@ doOpenFont(ClientPtr client, OFclosurePtr c)
     if (patternCache && pfont != c->non_cachable_font)
         xfont2_cache_font_pattern(patternCache, c->origFontName, c->origFontNameLen,
                                   pfont);
+    RetainFont(pfont, c->origFontName, c->origFontNameLen);
  bail:
+    FontOpenAccount(c->start, FALSE, c->suspended, err != Successful);
     if (err != Successful && c->client != serverClient) {
         SendErrorToClient(c->client, X_OpenFont, 0,
                           c->fontid, FontToXError(err));
@@ -377,6 +527,7 @@ OpenFont(ClientPtr client, XID fid, Mask flags, unsigned lenfname,
     OFclosurePtr c;
     int i;
     FontPtr cached = (FontPtr) 0;
+    CARD64 start = GetTimeInMicros();
 
     if (!lenfname || lenfname > XLFDMAXFONTNAMELEN)
         return BadName;
@@ -404,6 +555,8 @@ OpenFont(ClientPtr client, XID fid, Mask flags, unsigned lenfname,
             if (!AddResource(fid, RT_FONT, (void *) cached))
                 return BadAlloc;
             cached->refcnt++;
+            RetainFont(cached, pfontname, lenfname);
+            FontOpenAccount(start, TRUE, FALSE, FALSE);
             return Success;
         }
     }
@@ -439,6 +592,8 @@ OpenFont(ClientPtr client, XID fid, Mask flags, unsigned lenfname,
     c->fnamelen = lenfname;
     c->flags = flags;
     c->non_cachable_font = cached;
+    c->start = start;
+    c->suspended = FALSE;
 
     (void) doOpenFont(client, c);
     return Success;
@@ -476,6 +631,8 @@ CloseFont(void *value, XID fid)
 #ifdef XF86BIGFONT
         XF86BigfontFreeFontShm(pfont);
 #endif
+        if (query_font_index >= 0)
+            free(FontGetPrivate(pfont, query_font_index));
         fpe = pfont->fpe;
         (*fpe_functions[fpe->type]->close_font) (fpe, pfont);
         FreeFPE(fpe);
@@ -549,6 +706,161 @@ QueryFont(FontPtr pFont, xQueryFontReply * pReply, int nProtoCCIStructs)
     return;
 }
 
+/**
+ * Sends the QueryFont reply for pFont to client.  The reply is built the
+ * first time it is asked for, and then shared by all clients until the
+ * font is closed.
+ */
+int
+SendQueryFontReply(ClientPtr client, FontPtr pFont)
+{
+    xQueryFontReply *reply = NULL, *swapped;
+    xCharInfo *pmax = FONTINKMAX(pFont);
+    xCharInfo *pmin = FONTINKMIN(pFont);
+    int nprotoxcistructs;
+    int rlength;
+    Bool cached;
+
+    if (query_font_index >= 0)
+        reply = FontGetPrivate(pFont, query_font_index);
+
+    if (reply)
+        rlength = sizeof(xGenericReply) + (reply->length << 2);
+    else {
+        nprotoxcistructs = (pmax->rightSideBearing == pmin->rightSideBearing &&
+                            pmax->leftSideBearing == pmin->leftSideBearing &&
+                            pmax->descent == pmin->descent &&
+                            pmax->ascent == pmin->ascent &&
+                            pmax->characterWidth == pmin->characterWidth) ?
+            0 : N2dChars(pFont);
+
+        rlength = sizeof(xQueryFontReply) +
+            FONTINFONPROPS(FONTCHARSET(pFont)) * sizeof(xFontProp) +
+            nprotoxcistructs * sizeof(xCharInfo);
+        reply = calloc(1, rlength);
+        if (!reply)
+            return BadAlloc;
+
+        reply->type = X_Reply;
+        reply->length = bytes_to_int32(rlength - sizeof(xGenericReply));
+        QueryFont(pFont, reply, nprotoxcistructs);
+
+        cached = query_font_index >= 0 &&
+            xfont2_font_set_private(pFont, query_font_index, reply);
+        if (!cached) {
+            reply->sequenceNumber = client->sequence;
+            WriteReplyToClient(client, rlength, reply);
+            free(reply);
+            return Success;
+        }
+    }
+
+    reply->sequenceNumber = client->sequence;
+    if (client->swapped) {
+        /* Swapping is done in place */
+        swapped = malloc(rlength);
+        if (!swapped)
+            return BadAlloc;
+        memcpy(swapped, reply, rlength);
+        WriteReplyToClient(client, rlength, swapped);
+        free(swapped);
+    }
+    else
+        WriteReplyToClient(client, rlength, reply);
+    return Success;
+}
+
+static FontListCachePtr
+FontListCacheStart(CARD8 reqType, const unsigned char *pattern, int patlen,
+                   int max_names)
+{
+    FontListCachePtr fc = calloc(1, sizeof(FontListCacheRec));
+
+    if (fc) {
+        fc->reqType = reqType;
+        fc->max_names = max_names;
+        fc->patlen = patlen;
+        memcpy(fc->pattern, pattern, patlen);
+    }
+    return fc;
+}
+
+static void
+FontListCacheFree(FontListCachePtr fc)
+{
+    if (fc) {
+        free(fc->data);
+        free(fc);
+    }
+}
+
+static Bool
+FontListCacheAppend(FontListCachePtr fc, const void *data, int len)
+{
+    int padded = pad_to_int32(len);
+
+    if (fc->length + padded > fc->size) {
+        int size = max(fc->size * 2, fc->length + padded);
+        char *p = realloc(fc->data, max(size, 1024));
+
+        if (!p)
+            return FALSE;
+        fc->data = p;
+        fc->size = max(size, 1024);
+    }
+    memcpy(fc->data + fc->length, data, len);
+    memset(fc->data + fc->length + len, 0, padded - len);
+    fc->length += padded;
+    return TRUE;
+}
+
+static void
+FontListCacheInsert(FontListCachePtr fc)
+{
+    FontListCachePtr *prev;
+    int n = 0;
+
+    fc->next = font_list_cache;
+    font_list_cache = fc;
+
+    for (prev = &font_list_cache; *prev; prev = &(*prev)->next) {
+        if (++n > FONT_LIST_CACHE_MAX) {
+            FontListCacheFree(*prev);
+            *prev = NULL;
+            break;
+        }
+    }
+}
+
+static FontListCachePtr
+FontListCacheFind(CARD8 reqType, const unsigned char *pattern, int patlen,
+                  int max_names)
+{
+    FontListCachePtr fc, *prev;
+
+    for (prev = &font_list_cache; (fc = *prev); prev = &fc->next) {
+        if (fc->reqType == reqType && fc->max_names == max_names &&
+            fc->patlen == patlen && memcmp(fc->pattern, pattern, patlen) == 0) {
+            *prev = fc->next;
+            fc->next = font_list_cache;
+            font_list_cache = fc;
+            return fc;
+        }
+    }
+    return NULL;
+}
+
+static void
+EmptyFontListCache(void)
+{
+    FontListCachePtr fc;
+
+    while ((fc = font_list_cache)) {
+        font_list_cache = fc->next;
+        FontListCacheFree(fc);
+    }
+}
+
 static Bool
 doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
 {
@@ -590,6 +902,8 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
                  c->names);
 
             if (err == Suspended) {
+                FontListCacheFree(c->cache);
+                c->cache = NULL;
                 if (!ClientIsAsleep(client))
                     ClientSleep(client,
                                 (ClientSleepProcPtr) doListFontsAndAliases, c);
@@ -614,6 +928,8 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
                      c->current.patlen, c->current.max_names - c->names->nnames,
                      &c->current.private);
                 if (err == Suspended) {
+                    FontListCacheFree(c->cache);
+                    c->cache = NULL;
                     if (!ClientIsAsleep(client))
                         ClientSleep(client,
                                     (ClientSleepProcPtr) doListFontsAndAliases,
@@ -631,6 +947,8 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
                     ((void *) c->client, fpe, &name, &namelen, &tmpname,
                      &resolvedlen, c->current.private);
                 if (err == Suspended) {
+                    FontListCacheFree(c->cache);
+                    c->cache = NULL;
                     if (!ClientIsAsleep(client))
                         ClientSleep(client,
                                     (ClientSleepProcPtr) doListFontsAndAliases,
@@ -775,6 +1093,13 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
     client->pSwapReplyFunc = ReplySwapVector[X_ListFonts];
     WriteSwappedDataToClient(client, sizeof(xListFontsReply), &reply);
     WriteToClient(client, stringLens + nnames, bufferStart);
+
+    if (c->cache && FontListCacheAppend(c->cache, bufferStart,
+                                        stringLens + nnames)) {
+        c->cache->nreplies = nnames;
+        FontListCacheInsert(c->cache);
+        c->cache = NULL;
+    }
     free(bufferStart);
 
  bail:
@@ -783,18 +1108,35 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
         FreeFPE(c->fpe_list[i]);
     free(c->fpe_list);
     free(c->savedName);
+    FontListCacheFree(c->cache);
     xfont2_free_font_names(names);
     free(c);
     free(resolved);
     return TRUE;
 }
 
+static void
+SendCachedListFonts(ClientPtr client, FontListCachePtr fc)
+{
+    xListFontsReply reply = {
+        .type = X_Reply,
+        .length = bytes_to_int32(fc->length),
+        .nFonts = fc->nreplies,
+        .sequenceNumber = client->sequence
+    };
+
+    client->pSwapReplyFunc = ReplySwapVector[X_ListFonts];
+    WriteSwappedDataToClient(client, sizeof(xListFontsReply), &reply);
+    WriteToClient(client, fc->length, fc->data);
+}
+
 int
 ListFonts(ClientPtr client, unsigned char *pattern, unsigned length,
           unsigned max_names)
 {
     int i;
     LFclosurePtr c;
+    FontListCachePtr fc;
 
     /*
      * The right error to return here would be BadName, however the
@@ -809,6 +1151,12 @@ ListFonts(ClientPtr client, unsigned char *pattern, unsigned length,
     if (i != Success)
         return i;
 
+    fc = FontListCacheFind(X_ListFonts, pattern, length, max_names);
+    if (fc) {
+        SendCachedListFonts(client, fc);
+        return Success;
+    }
+
     if (!(c = malloc(sizeof *c)))
         return BadAlloc;
     c->fpe_list = xallocarray(num_fpes, sizeof(FontPathElementPtr));
@@ -836,6 +1184,7 @@ ListFonts(ClientPtr client, unsigned char *pattern, unsigned length,
     c->current.private = 0;
     c->haveSaved = FALSE;
     c->savedName = 0;
+    c->cache = FontListCacheStart(X_ListFonts, pattern, length, max_names);
     doListFontsAndAliases(client, c);
     return Success;
 }
@@ -875,6 +1224,8 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                 (client, fpe, c->current.pattern, c->current.patlen,
                  c->current.max_names, &c->current.private);
             if (err == Suspended) {
+                FontListCacheFree(c->cache);
+                c->cache = NULL;
                 if (!ClientIsAsleep(client))
                     ClientSleep(client,
                                 (ClientSleepProcPtr) doListFontsWithInfo, c);
@@ -890,6 +1241,8 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                 (client, fpe, &name, &namelen, &pFontInfo,
                  &numFonts, c->current.private);
             if (err == Suspended) {
+                FontListCacheFree(c->cache);
+                c->cache = NULL;
                 if (!ClientIsAsleep(client))
                     ClientSleep(client,
                                 (ClientSleepProcPtr) doListFontsWithInfo, c);
@@ -1006,6 +1359,16 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                 pFP->value = pFontInfo->props[i].value;
                 pFP++;
             }
+            /* Before the reply gets swapped */
+            if (c->cache) {
+                if (FontListCacheAppend(c->cache, reply, length) &&
+                    FontListCacheAppend(c->cache, name, namelen))
+                    c->cache->nreplies++;
+                else {
+                    FontListCacheFree(c->cache);
+                    c->cache = NULL;
+                }
+            }
             WriteSwappedDataToClient(client, length, reply);
             WriteToClient(client, namelen, name);
             if (pFontInfo == &fontInfo) {
@@ -1024,6 +1387,10 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
                                  - sizeof(xGenericReply))
     };
     WriteSwappedDataToClient(client, length, &finalReply);
+    if (c->cache && err == Successful) {
+        FontListCacheInsert(c->cache);
+        c->cache = NULL;
+    }
  bail:
     ClientWakeup(client);
     for (i = 0; i < c->num_fpes; i++)
@@ -1031,16 +1398,60 @@ doListFontsWithInfo(ClientPtr client, LFWIclosurePtr c)
     free(c->reply);
     free(c->fpe_list);
     free(c->savedName);
+    FontListCacheFree(c->cache);
     free(c);
     return TRUE;
 }
 
+static int
+SendCachedListFontsWithInfo(ClientPtr client, FontListCachePtr fc)
+{
+    xListFontsWithInfoReply *reply, *swapped = NULL, finalReply;
+    char *p = fc->data;
+    int length, i;
+
+    client->pSwapReplyFunc = ReplySwapVector[X_ListFontsWithInfo];
+    if (client->swapped) {
+        /* Swapping is done in place, so each reply is copied first */
+        swapped = malloc(fc->length);
+        if (!swapped && fc->length)
+            return BadAlloc;
+    }
+
+    for (i = 0; i < fc->nreplies; i++) {
+        reply = (xListFontsWithInfoReply *) p;
+        length = sizeof(*reply) + reply->nFontProps * sizeof(xFontProp);
+        reply->sequenceNumber = client->sequence;
+        p += length;
+        if (swapped) {
+            memcpy(swapped, reply, length);
+            WriteSwappedDataToClient(client, length, swapped);
+        }
+        else
+            WriteToClient(client, length, reply);
+        WriteToClient(client, reply->nameLength, p);
+        p += pad_to_int32(reply->nameLength);
+    }
+    free(swapped);
+
+    finalReply = (xListFontsWithInfoReply) {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = bytes_to_int32(sizeof(xListFontsWithInfoReply)
+                                 - sizeof(xGenericReply))
+    };
+    WriteSwappedDataToClient(client, sizeof(xListFontsWithInfoReply),
+                             &finalReply);
+    return Success;
+}
+
 int
 StartListFontsWithInfo(ClientPtr client, int length, unsigned char *pattern,
                        int max_names)
 {
     int i;
     LFWIclosurePtr c;
+    FontListCachePtr fc;
 
     /*
      * The right error to return here would be BadName, however the
@@ -1055,6 +1466,10 @@ StartListFontsWithInfo(ClientPtr client, int length, unsigned char *pattern,
     if (i != Success)
         return i;
 
+    fc = FontListCacheFind(X_ListFontsWithInfo, pattern, length, max_names);
+    if (fc)
+        return SendCachedListFontsWithInfo(client, fc);
+
     if (!(c = malloc(sizeof *c)))
         goto badAlloc;
     c->fpe_list = xallocarray(num_fpes, sizeof(FontPathElementPtr));
@@ -1079,6 +1494,8 @@ StartListFontsWithInfo(ClientPtr client, int length, unsigned char *pattern,
     c->savedNumFonts = 0;
     c->haveSaved = FALSE;
     c->savedName = 0;
+    c->cache = FontListCacheStart(X_ListFontsWithInfo, pattern, length,
+                                  max_names);
     doListFontsWithInfo(client, c);
     return Success;
  badAlloc:
@@ -1660,8 +2077,21 @@ SetFontPathElements(int npaths, unsigned char *paths, int *bad, Bool persist)
     font_path_elements = fplist;
     if (patternCache)
         xfont2_empty_font_pattern_cache(patternCache);
+    EmptyFontListCache();
     num_fpes = valid_paths;
 
+    /* Don't keep the elements which were just removed alive */
+    for (i = num_retained_fonts - 1; i >= 0; i--) {
+        int j;
+
+        for (j = 0; j < num_fpes; j++) {
+            if (retained_fonts[i].font->fpe == font_path_elements[j])
+                break;
+        }
+        if (j == num_fpes)
+            ReleaseRetainedFont(i);
+    }
+
     return Success;
  bail:
     *bad = i;
@@ -1865,6 +2295,62 @@ get_client_resolutions(int *num)
     return &res;
 }
 
+/**
+ * Close the fonts which are only kept open by the retained font list, and
+ * remember their names so that PrefetchFonts opens them again in the next
+ * server generation.  This needs to happen while the screens still exist.
+ */
+void
+ReleaseRetainedFonts(void)
+{
+    int i;
+
+    for (i = 0; i < num_prefetch_fonts; i++)
+        free(prefetch_fonts[i].name);
+    num_prefetch_fonts = 0;
+
+    while (num_retained_fonts) {
+        RetainedFontRec *rf = &retained_fonts[0];
+
+        prefetch_fonts[num_prefetch_fonts++] = *rf;
+        rf->name = NULL;
+        ReleaseRetainedFont(0);
+    }
+}
+
+static Bool
+PrefetchFontWork(ClientPtr client, void *closure)
+{
+    RetainedFontRec *rf;
+    XID fid;
+
+    if (!num_prefetch_fonts) {
+        prefetch_queued = FALSE;
+        return TRUE;
+    }
+
+    /* Least recently used first, so that the order is kept */
+    rf = &prefetch_fonts[--num_prefetch_fonts];
+    fid = FakeClientID(0);
+    if (OpenFont(serverClient, fid, FontLoadAll | FontOpenSync,
+                 rf->len, rf->name) == Success)
+        FreeResource(fid, RT_NONE);
+    free(rf->name);
+    return FALSE;
+}
+
+/**
+ * Open the fonts which were in use at the last server reset again, one
+ * at a time while the server is otherwise idle.  They stay open in the
+ * retained font list until the clients which want them come back.
+ */
+void
+PrefetchFonts(void)
+{
+    if (num_prefetch_fonts && !prefetch_queued)
+        prefetch_queued = QueueWorkProc(PrefetchFontWork, NULL, NULL);
+}
+
 void
 FreeFonts(void)
 {
@@ -1872,6 +2358,7 @@ FreeFonts(void)
         xfont2_free_font_pattern_cache(patternCache);
         patternCache = 0;
     }
+    EmptyFontListCache();
     FreeFontPath(font_path_elements, num_fpes, TRUE);
     font_path_elements = 0;
     num_fpes = 0;
@@ -2041,13 +2528,14 @@ static const xfont2_client_funcs_rec xfont2_client_funcs = {
     .adjust_fs_wait_for_delay = adjust_fs_wait_for_delay,
 };
 
-xfont2_pattern_cache_ptr fontPatternCache;
-
 void
 InitFonts(void)
 {
-    if (fontPatternCache)
-	xfont2_free_font_pattern_cache(fontPatternCache);
-    fontPatternCache = xfont2_make_font_pattern_cache();
+    if (patternCache)
+	xfont2_free_font_pattern_cache(patternCache);
+    patternCache = xfont2_make_font_pattern_cache();
     xfont2_init(&xfont2_client_funcs);
+    /* Font private indices are never given back, keep ours across resets */
+    if (query_font_index < 0)
+        query_font_index = xfont2_allocate_font_private_index();
 }
@@ -70,7 +70,7 @@
 #include "listdev.h"            /* for sizing up DeviceClassesChangedEvent */
 #include "probes.h"
 
-/* Number of motion history events to store. */
+/* Number of motion history events to store by default. */
 #define MOTION_HISTORY_SIZE 256
 
 /**
@@ -81,12 +81,14 @@
 InternalEvent *InputEventList = NULL;
 
 /**
- * Pick some arbitrary size for Xi motion history.
+ * Size of the motion history of new devices, set with -motionhistory.
  */
+int motionHistorySize = MOTION_HISTORY_SIZE;
+
 int
 GetMotionHistorySize(void)
 {
-    return MOTION_HISTORY_SIZE;
+    return motionHistorySize;
 }
 
 void
@@ -381,44 +383,83 @@ updateSlaveDeviceCoords(DeviceIntPtr master, DeviceIntPtr pDev)
 
 }
 
+/**
+ * The motion history is a ring of numMotionEvents + 1 entries of
+ * motionHistoryEntrySize() bytes, ordered by timestamp. The extra slot
+ * is the one being written, so the last numMotionEvents entries are
+ * always readable.
+ *
+ * motion_count is the number of entries ever written; entry n lives in
+ * slot n % (numMotionEvents + 1). The input thread writes the entry, then
+ * publishes it by advancing motion_count, without taking the input
+ * lock. Readers on the main thread snapshot motion_count, binary search
+ * the timestamps and copy the entries they want, then check
+ * motion_count again to discard anything the writer may have reused
+ * in the meantime.
+ */
+static int
+motionHistoryEntrySize(DeviceIntPtr pDev)
+{
+    if (IsMaster(pDev))
+        return (sizeof(INT32) * 3 * MAX_VALUATORS) + sizeof(Time);
+    else
+        return (sizeof(INT32) * pDev->valuator->numAxes) + sizeof(Time);
+}
+
+#define motionHistoryEntry(v, n, size) \
+    ((char *) (v)->motion + ((n) % ((v)->numMotionEvents + 1)) * (size))
+
+static Time
+motionHistoryTime(ValuatorClassPtr v, unsigned int n, int size)
+{
+    Time ms;
+
+    memcpy(&ms, motionHistoryEntry(v, n, size), sizeof(Time));
+    return ms;
+}
+
 /**
  * Allocate the motion history buffer.
  */
 void
 AllocateMotionHistory(DeviceIntPtr pDev)
 {
+    ValuatorClassPtr v = pDev->valuator;
     int size;
 
-    free(pDev->valuator->motion);
+    free(v->motion);
+    v->motion = NULL;
+    v->motion_count = 0;
 
-    if (pDev->valuator->numMotionEvents < 1)
+    if (v->numMotionEvents < 1)
         return;
 
     /* An MD must have a motion history size large enough to keep all
      * potential valuators, plus the respective range of the valuators.
      * 3 * INT32 for (min_val, max_val, curr_val))
      */
-    if (IsMaster(pDev))
-        size = sizeof(INT32) * 3 * MAX_VALUATORS;
-    else {
-        ValuatorClassPtr v = pDev->valuator;
-        int numAxes;
+    size = motionHistoryEntrySize(pDev);
 
-        /* XI1 doesn't understand mixed mode devices */
-        for (numAxes = 0; numAxes < v->numAxes; numAxes++)
-            if (valuator_get_mode(pDev, numAxes) != valuator_get_mode(pDev, 0))
-                break;
-        size = sizeof(INT32) * numAxes;
-    }
+    v->motion = calloc(v->numMotionEvents + 1, size);
+    if (!v->motion)
+        ErrorF("[dix] %s: Failed to alloc motion history (%d bytes).\n",
+               pDev->name, size * (v->numMotionEvents + 1));
+}
 
-    size += sizeof(Time);
+/**
+ * Change the number of events kept in the motion history of a device.
+ * The current history is discarded.
+ */
+void
+SetMotionHistorySize(DeviceIntPtr pDev, int nevents)
+{
+    if (!pDev->valuator || nevents < 0)
+        return;
 
-    pDev->valuator->motion = calloc(pDev->valuator->numMotionEvents, size);
-    pDev->valuator->first_motion = 0;
-    pDev->valuator->last_motion = 0;
-    if (!pDev->valuator->motion)
-        ErrorF("[dix] %s: Failed to alloc motion history (%d bytes).\n",
-               pDev->name, size * pDev->valuator->numMotionEvents);
+    input_lock();
+    pDev->valuator->numMotionEvents = nevents;
+    AllocateMotionHistory(pDev);
+    input_unlock();
 }
 
 /**
@@ -432,10 +473,10 @@ int
 GetMotionHistory(DeviceIntPtr pDev, xTimecoord ** buff, unsigned long start,
                  unsigned long stop, ScreenPtr pScreen, BOOL core)
 {
-    char *ibuff = NULL, *obuff;
-    int i = 0, ret = 0;
-    int j, coord;
-    Time current;
+    ValuatorClassPtr v = pDev->valuator;
+    char *ibuff, *obuff, *history;
+    unsigned int count, first, last, lo, hi, mid;
+    int i, j, ret, coord;
 
     /* The size of a single motion event. */
     int size;
@@ -444,110 +485,140 @@ GetMotionHistory(DeviceIntPtr pDev, xTimecoord ** buff, unsigned long start,
     INT16 *corebuf;
     AxisInfo core_axis = { 0 };
 
-    if (!pDev->valuator || !pDev->valuator->numMotionEvents)
+    if (!v || !v->numMotionEvents || !v->motion)
         return 0;
 
     if (core && !pScreen)
         return 0;
 
-    if (IsMaster(pDev))
-        size = (sizeof(INT32) * 3 * MAX_VALUATORS) + sizeof(Time);
-    else
-        size = (sizeof(INT32) * pDev->valuator->numAxes) + sizeof(Time);
+    size = motionHistoryEntrySize(pDev);
 
-    *buff = malloc(size * pDev->valuator->numMotionEvents);
+    *buff = malloc(size * v->numMotionEvents);
     if (!(*buff))
         return 0;
-    obuff = (char *) *buff;
 
-    for (i = pDev->valuator->first_motion;
-         i != pDev->valuator->last_motion;
-         i = (i + 1) % pDev->valuator->numMotionEvents) {
-        /* We index the input buffer by which element we're accessing, which
-         * is not monotonic, and the output buffer by how many events we've
-         * written so far. */
-        ibuff = (char *) pDev->valuator->motion + (i * size);
-        memcpy(&current, ibuff, sizeof(Time));
-
-        if (current > stop) {
-            return ret;
+    count = __atomic_load_n(&v->motion_count, __ATOMIC_ACQUIRE);
+    first = count > v->numMotionEvents ? count - v->numMotionEvents : 0;
+
+    /* first entry at or after start */
+    for (lo = first, hi = count; lo < hi;) {
+        mid = lo + (hi - lo) / 2;
+        if (motionHistoryTime(v, mid, size) < start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = lo;
+
+    /* first entry after stop */
+    for (hi = count; lo < hi;) {
+        mid = lo + (hi - lo) / 2;
+        if (motionHistoryTime(v, mid, size) <= stop)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    last = lo;
+
+    if (first == last)
+        return 0;
+
+    history = malloc((last - first) * size);
+    if (!history)
+        return 0;
+
+    for (i = 0; first + i != last; i++)
+        memcpy(history + i * size, motionHistoryEntry(v, first + i, size),
+               size);
+
+    /* Drop whatever the writer got to while we were copying */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    count = __atomic_load_n(&v->motion_count, __ATOMIC_RELAXED);
+    ibuff = history;
+    if (count - first > v->numMotionEvents) {
+        unsigned int lost = count - first - v->numMotionEvents;
+
+        if (lost >= last - first) {
+            free(history);
+            return 0;
         }
-        else if (current >= start) {
-            if (core) {
-                memcpy(obuff, ibuff, sizeof(Time));     /* copy timestamp */
+        ibuff += lost * size;
+        first += lost;
+    }
 
-                icbuf = (INT32 *) (ibuff + sizeof(Time));
-                corebuf = (INT16 *) (obuff + sizeof(Time));
+    obuff = (char *) *buff;
+    for (ret = 0; first + ret != last; ret++, ibuff += size) {
+        if (core) {
+            memcpy(obuff, ibuff, sizeof(Time));     /* copy timestamp */
 
-                /* fetch x coordinate + range */
-                memcpy(&from.min_value, icbuf++, sizeof(INT32));
-                memcpy(&from.max_value, icbuf++, sizeof(INT32));
-                memcpy(&coord, icbuf++, sizeof(INT32));
+            icbuf = (INT32 *) (ibuff + sizeof(Time));
+            corebuf = (INT16 *) (obuff + sizeof(Time));
 
-                /* scale to screen coords */
-                to = &core_axis;
-                to->max_value = pScreen->width;
-                coord =
-                    rescaleValuatorAxis(coord, &from, to, 0, pScreen->width);
+            /* fetch x coordinate + range */
+            memcpy(&from.min_value, icbuf++, sizeof(INT32));
+            memcpy(&from.max_value, icbuf++, sizeof(INT32));
+            memcpy(&coord, icbuf++, sizeof(INT32));
 
-                memcpy(corebuf, &coord, sizeof(INT16));
-                corebuf++;
+            /* scale to screen coords */
+            to = &core_axis;
+            to->max_value = pScreen->width;
+            coord =
+                rescaleValuatorAxis(coord, &from, to, 0, pScreen->width);
 
-                /* fetch y coordinate + range */
+            memcpy(corebuf, &coord, sizeof(INT16));
+            corebuf++;
+
+            /* fetch y coordinate + range */
+            memcpy(&from.min_value, icbuf++, sizeof(INT32));
+            memcpy(&from.max_value, icbuf++, sizeof(INT32));
+            memcpy(&coord, icbuf++, sizeof(INT32));
+
+            to->max_value = pScreen->height;
+            coord =
+                rescaleValuatorAxis(coord, &from, to, 0, pScreen->height);
+            memcpy(corebuf, &coord, sizeof(INT16));
+
+        }
+        else if (IsMaster(pDev)) {
+            memcpy(obuff, ibuff, sizeof(Time));     /* copy timestamp */
+
+            ocbuf = (INT32 *) (obuff + sizeof(Time));
+            icbuf = (INT32 *) (ibuff + sizeof(Time));
+            for (j = 0; j < MAX_VALUATORS; j++) {
+                if (j >= v->numAxes)
+                    break;
+
+                /* fetch min/max/coordinate */
                 memcpy(&from.min_value, icbuf++, sizeof(INT32));
                 memcpy(&from.max_value, icbuf++, sizeof(INT32));
                 memcpy(&coord, icbuf++, sizeof(INT32));
 
-                to->max_value = pScreen->height;
-                coord =
-                    rescaleValuatorAxis(coord, &from, to, 0, pScreen->height);
-                memcpy(corebuf, &coord, sizeof(INT16));
+                to = (j < v->numAxes) ? &v->axes[j] : NULL;
 
-            }
-            else if (IsMaster(pDev)) {
-                memcpy(obuff, ibuff, sizeof(Time));     /* copy timestamp */
-
-                ocbuf = (INT32 *) (obuff + sizeof(Time));
-                icbuf = (INT32 *) (ibuff + sizeof(Time));
-                for (j = 0; j < MAX_VALUATORS; j++) {
-                    if (j >= pDev->valuator->numAxes)
-                        break;
-
-                    /* fetch min/max/coordinate */
-                    memcpy(&from.min_value, icbuf++, sizeof(INT32));
-                    memcpy(&from.max_value, icbuf++, sizeof(INT32));
-                    memcpy(&coord, icbuf++, sizeof(INT32));
-
-                    to = (j <
-                          pDev->valuator->numAxes) ? &pDev->valuator->
-                        axes[j] : NULL;
-
-                    /* x/y scaled to screen if no range is present */
-                    if (j == 0 && (from.max_value < from.min_value))
-                        from.max_value = pScreen->width;
-                    else if (j == 1 && (from.max_value < from.min_value))
-                        from.max_value = pScreen->height;
-
-                    /* scale from stored range into current range */
-                    coord = rescaleValuatorAxis(coord, &from, to, 0, 0);
-                    memcpy(ocbuf, &coord, sizeof(INT32));
-                    ocbuf++;
-                }
-            }
-            else
-                memcpy(obuff, ibuff, size);
+                /* x/y scaled to screen if no range is present */
+                if (j == 0 && (from.max_value < from.min_value))
+                    from.max_value = pScreen->width;
+                else if (j == 1 && (from.max_value < from.min_value))
+                    from.max_value = pScreen->height;
 
-            /* don't advance by size here. size may be different to the
-             * actually written size if the MD has less valuators than MAX */
-            if (core)
-                obuff += sizeof(INT32) + sizeof(Time);
-            else
-                obuff +=
-                    (sizeof(INT32) * pDev->valuator->numAxes) + sizeof(Time);
-            ret++;
+                /* scale from stored range into current range */
+                coord = rescaleValuatorAxis(coord, &from, to, 0, 0);
+                memcpy(ocbuf, &coord, sizeof(INT32));
+                ocbuf++;
+            }
         }
+        else
+            memcpy(obuff, ibuff, size);
+
+        /* don't advance by size here. size may be different to the
+         * actually written size if the MD has less valuators than MAX */
+        if (core)
+            obuff += sizeof(INT32) + sizeof(Time);
+        else
+            obuff += (sizeof(INT32) * v->numAxes) + sizeof(Time);
     }
 
+    free(history);
     return ret;
 }
 
@@ -566,21 +637,23 @@ static void
 updateMotionHistory(DeviceIntPtr pDev, CARD32 ms, ValuatorMask *mask,
                     double *valuators)
 {
-    char *buff = (char *) pDev->valuator->motion;
-    ValuatorClassPtr v;
+    ValuatorClassPtr v = pDev->valuator;
+    unsigned int count;
+    char *buff;
     int i;
 
-    if (!pDev->valuator->numMotionEvents)
+    if (!v->numMotionEvents || !v->motion)
         return;
 
-    v = pDev->valuator;
-    if (IsMaster(pDev)) {
-        buff += ((sizeof(INT32) * 3 * MAX_VALUATORS) + sizeof(CARD32)) *
-            v->last_motion;
+    /* Readers that saw the previous count must notice the slot is reused */
+    count = v->motion_count;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    buff = motionHistoryEntry(v, count, motionHistoryEntrySize(pDev));
 
-        memcpy(buff, &ms, sizeof(Time));
-        buff += sizeof(Time);
+    memcpy(buff, &ms, sizeof(Time));
+    buff += sizeof(Time);
 
+    if (IsMaster(pDev)) {
         memset(buff, 0, sizeof(INT32) * 3 * MAX_VALUATORS);
 
         for (i = 0; i < v->numAxes; i++) {
@@ -603,16 +676,9 @@ updateMotionHistory(DeviceIntPtr pDev, CARD32 ms, ValuatorMask *mask,
         }
     }
     else {
+        memset(buff, 0, sizeof(INT32) * v->numAxes);
 
-        buff += ((sizeof(INT32) * pDev->valuator->numAxes) + sizeof(CARD32)) *
-            pDev->valuator->last_motion;
-
-        memcpy(buff, &ms, sizeof(Time));
-        buff += sizeof(Time);
-
-        memset(buff, 0, sizeof(INT32) * pDev->valuator->numAxes);
-
-        for (i = 0; i < MAX_VALUATORS; i++) {
+        for (i = 0; i < v->numAxes; i++) {
             int val;
 
             if (valuator_mask_size(mask) <= i || !valuator_mask_isset(mask, i)) {
@@ -625,14 +691,7 @@ updateMotionHistory(DeviceIntPtr pDev, CARD32 ms, ValuatorMask *mask,
         }
     }
 
-    pDev->valuator->last_motion = (pDev->valuator->last_motion + 1) %
-        pDev->valuator->numMotionEvents;
-    /* If we're wrapping around, just keep the circular buffer going. */
-    if (pDev->valuator->first_motion == pDev->valuator->last_motion)
-        pDev->valuator->first_motion = (pDev->valuator->first_motion + 1) %
-            pDev->valuator->numMotionEvents;
-
-    return;
+    __atomic_store_n(&v->motion_count, count + 1, __ATOMIC_RELEASE);
 }
 
 /**
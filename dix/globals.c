@@ -79,7 +79,7 @@ PtrCtrl defaultPointerControl = {
     0
 };
 
-ClientPtr clients[MAXCLIENTS];
+ClientPtr *clients;              /* see InitClientsTable() */
 ClientPtr serverClient;
 int currentMaxClients;          /* current size of clients array */
 long maxBigRequestSize = MAX_BIG_REQUEST_SIZE;
@@ -154,8 +154,7 @@ dix_main(int argc, char *argv[], char *envp[])
         OsInit();
         if (serverGeneration == 1) {
             CreateWellKnownSockets();
-            for (i = 1; i < LimitClients; i++)
-                clients[i] = NullClient;
+            InitClientsTable();
             serverClient = calloc(sizeof(ClientRec), 1);
             if (!serverClient)
                 FatalError("couldn't create server client");
@@ -234,6 +233,7 @@ dix_main(int argc, char *argv[], char *envp[])
             FatalError("could not open default cursor font '%s'",
                        defaultCursorFont);
         }
+        PrefetchFonts();
 
 #ifdef PANORAMIX
         /*
@@ -295,6 +295,7 @@ dix_main(int argc, char *argv[], char *envp[])
 #else
         FreeAllResources();
 #endif
+        ReleaseRetainedFonts();
 
         CloseInput();
 
@@ -598,7 +598,9 @@ CreateNewResourceClass(void)
     return next;
 }
 
-static ClientResourceRec clientTable[MAXCLIENTS];
+/* Grown as clients with higher indices come along */
+static ClientResourceRec *clientTable;
+static int clientTableSize;
 
 static unsigned int
 ilog2(int val)
@@ -620,7 +622,20 @@ ilog2(int val)
 unsigned int
 ResourceClientBits(void)
 {
-    return (ilog2(LimitClients));
+    static int limit;
+    static unsigned int bits;
+
+    /* This is behind every CLIENT_ID(), so only recompute it when the
+     * limit changes.  Limits which aren't a power of two are rounded up,
+     * so that every client index fits in the client field.
+     */
+    if (limit != LimitClients) {
+        limit = LimitClients;
+        bits = ilog2(limit);
+        if ((1 << bits) < limit)
+            bits++;
+    }
+    return bits;
 }
 
 /*****************
@@ -644,6 +659,19 @@ InitClientResources(ClientPtr client)
             return FALSE;
         memcpy(resourceTypes, predefTypes, sizeof(predefTypes));
     }
+    if (client->index >= clientTableSize) {
+        int size = max(client->index + 1, clientTableSize * 2);
+        ClientResourceRec *table;
+
+        table = reallocarray(clientTable, size, sizeof(ClientResourceRec));
+        if (!table)
+            return FALSE;
+        memset(table + clientTableSize, 0,
+               (size - clientTableSize) * sizeof(ClientResourceRec));
+        clientTable = table;
+        clientTableSize = size;
+    }
+
     clientTable[i = client->index].resources =
         malloc(INITBUCKETS * sizeof(ResourcePtr));
     if (!clientTable[i].resources)
@@ -804,12 +832,12 @@ AddResource(XID id, RESTYPE type, void *value)
     XSERVER_RESOURCE_ALLOC(id, type, value, TypeNameString(type));
 #endif
     client = CLIENT_ID(id);
-    rrec = &clientTable[client];
-    if (!rrec->buckets) {
+    if (client >= clientTableSize || !clientTable[client].buckets) {
         ErrorF("[dix] AddResource(%lx, %x, %lx), client=%d \n",
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
+    rrec = &clientTable[client];
     if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
         RebuildTable(client);
     head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
@@ -891,7 +919,7 @@ FreeResource(XID id, RESTYPE skipDeleteFuncType)
     int *eltptr;
     int elements;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
+    if (((cid = CLIENT_ID(id)) < clientTableSize) && clientTable[cid].buckets) {
         head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
         eltptr = &clientTable[cid].elements;
 
@@ -925,7 +953,7 @@ FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
     ResourcePtr res;
     ResourcePtr *prev, *head;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
+    if (((cid = CLIENT_ID(id)) < clientTableSize) && clientTable[cid].buckets) {
         head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
 
         prev = head;
@@ -960,7 +988,7 @@ ChangeResourceValue(XID id, RESTYPE rtype, void *value)
     int cid;
     ResourcePtr res;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
+    if (((cid = CLIENT_ID(id)) < clientTableSize) && clientTable[cid].buckets) {
         res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
 
         for (; res; res = res->next)
@@ -1198,7 +1226,7 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
     if ((rtype & TypeMask) > lastResourceType)
         return BadImplementation;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
+    if ((cid < clientTableSize) && clientTable[cid].buckets) {
         res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
 
         for (; res; res = res->next)
@@ -1233,7 +1261,7 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
 
     *result = NULL;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
+    if ((cid < clientTableSize) && clientTable[cid].buckets) {
         res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
 
         for (; res; res = res->next)
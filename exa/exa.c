@@ -225,6 +225,113 @@ exaPixmapIsPinned(PixmapPtr pPix)
     return pExaPixmap->score == EXA_PIXMAP_SCORE_PINNED;
 }
 
+static void
+exaLogMigrationStats(ScreenPtr pScreen)
+{
+    ExaScreenPriv(pScreen);
+
+    if (!pExaScr->migration_stats.cpu_accesses &&
+        !pExaScr->migration_stats.gpu_accesses)
+        return;
+
+    LogMessageVerb(X_INFO, 4,
+                   "EXA(%d): %lu accelerated and %lu software pixmap accesses\n",
+                   pScreen->myNum, pExaScr->migration_stats.gpu_accesses,
+                   pExaScr->migration_stats.cpu_accesses);
+    LogMessageVerb(X_INFO, 4,
+                   "EXA(%d): %lu uploads (%llu bytes), %lu downloads "
+                   "(%llu bytes)\n", pScreen->myNum,
+                   pExaScr->migration_stats.uploads,
+                   (unsigned long long) pExaScr->migration_stats.bytes_uploaded,
+                   pExaScr->migration_stats.downloads,
+                   (unsigned long long) pExaScr->migration_stats.bytes_downloaded);
+    if (pExaScr->migration == ExaMigrationAdaptive)
+        LogMessageVerb(X_INFO, 4,
+                       "EXA(%d): %lu migrations to offscreen and %lu to "
+                       "system memory avoided\n", pScreen->myNum,
+                       pExaScr->migration_stats.kept_in_sys,
+                       pExaScr->migration_stats.kept_in_fb);
+}
+
+/**
+ * Records an access to the pixmap by the CPU or the accelerator, for the
+ * adaptive migration heuristic.  Older accesses count less and less.
+ */
+void
+exaPixmapNoteAccess(PixmapPtr pPix, Bool gpu)
+{
+    ExaScreenPriv(pPix->drawable.pScreen);
+    ExaPixmapPriv(pPix);
+    CARD32 now;
+
+    if (pExaPixmap == NULL)
+        return;
+
+    if (gpu) {
+        pExaPixmap->gpu_accesses++;
+        pExaScr->migration_stats.gpu_accesses++;
+    }
+    else {
+        pExaPixmap->cpu_accesses++;
+        pExaScr->migration_stats.cpu_accesses++;
+    }
+
+    /* While pixmaps are in use, report the totals every so often */
+    now = GetTimeInMillis();
+    if (!pExaScr->migration_stats.report_time)
+        pExaScr->migration_stats.report_time = now;
+    if ((int) (now - pExaScr->migration_stats.report_time) >=
+        EXA_STATS_REPORT_INTERVAL) {
+        exaLogMigrationStats(pPix->drawable.pScreen);
+        pExaScr->migration_stats.report_time = now;
+    }
+
+    if (pExaPixmap->cpu_accesses + pExaPixmap->gpu_accesses >
+        EXA_ACCESS_HISTORY) {
+        pExaPixmap->cpu_accesses /= 2;
+        pExaPixmap->gpu_accesses /= 2;
+    }
+}
+
+/**
+ * Returns TRUE if the pixmap's recent accesses make it cheaper to keep in
+ * offscreen memory than in system memory.
+ *
+ * Keeping it in offscreen memory costs a copy across the bus for every CPU
+ * access, estimated from the size of the pixmap's previous migrations.
+ * Keeping it in system memory costs a software fallback for every operation
+ * which could have been accelerated; software rendering is cheaper per byte
+ * than a transfer, so that is taken to be an eighth of the pixmap size.
+ *
+ * The pixmap only changes sides once the other one is clearly cheaper, so
+ * that mixed workloads don't have it bounce back and forth.
+ */
+Bool
+exaPixmapWantsGpuCopy(PixmapPtr pPix)
+{
+    ExaPixmapPriv(pPix);
+    uint64_t size, transfer, cpu_cost, gpu_cost;
+
+    if (exaPixmapIsPinned(pPix))
+        return TRUE;
+
+    /* Like the other heuristics, assume acceleration until we know better */
+    if (pExaPixmap->cpu_accesses + pExaPixmap->gpu_accesses <
+        EXA_ACCESS_MIN_HISTORY)
+        return TRUE;
+
+    size = (uint64_t) pExaPixmap->sys_pitch * pPix->drawable.height;
+    transfer = pExaPixmap->transfer_size ? pExaPixmap->transfer_size : size;
+
+    cpu_cost = pExaPixmap->cpu_accesses * transfer;
+    gpu_cost = pExaPixmap->gpu_accesses * (size / 8);
+
+    if (exaPixmapHasGpuCopy(pPix))
+        return cpu_cost <= 2 * gpu_cost;
+    else
+        return 2 * cpu_cost < gpu_cost;
+}
+
 /**
  * exaPixmapHasGpuCopy() is used to determine if a pixmap is in offscreen
  * memory, meaning that acceleration could probably be done to it, and that it
@@ -745,6 +852,8 @@ exaCloseScreen(ScreenPtr pScreen)
     if (ps->Glyphs == exaGlyphs)
         exaGlyphsFini(pScreen);
 
+    exaLogMigrationStats(pScreen);
+
     if (pScreen->BlockHandler == ExaBlockHandler)
         unwrap(pExaScr, pScreen, BlockHandler);
     if (pScreen->WakeupHandler == ExaWakeupHandler)
@@ -1107,10 +1216,14 @@ exaDoMigration(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel)
     ScreenPtr pScreen = pixmaps[0].pPix->drawable.pScreen;
 
     ExaScreenPriv(pScreen);
+    int i;
 
     if (!(pExaScr->info->flags & EXA_OFFSCREEN_PIXMAPS))
         return;
 
+    for (i = 0; i < npixmaps; i++)
+        exaPixmapNoteAccess(pixmaps[i].pPix, can_accel);
+
     if (pExaScr->do_migration)
         (*pExaScr->do_migration) (pixmaps, npixmaps, can_accel);
 }
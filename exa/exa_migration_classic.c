@@ -112,6 +112,7 @@ exaCopyDirty(ExaMigrationPtr migrate, RegionPtr pValidDst, RegionPtr pValidSrc,
 {
     PixmapPtr pPixmap = migrate->pPix;
 
+    ExaScreenPriv(pPixmap->drawable.pScreen);
     ExaPixmapPriv(pPixmap);
     RegionPtr damage = DamageRegion(pExaPixmap->pDamage);
     RegionRec CopyReg;
@@ -121,6 +122,7 @@ exaCopyDirty(ExaMigrationPtr migrate, RegionPtr pValidDst, RegionPtr pValidSrc,
     int nbox;
     Bool access_prepared = FALSE;
     Bool need_sync = FALSE;
+    uint64_t bytes = 0;
 
     /* Damaged bits are valid in current copy but invalid in other one */
     if (pExaPixmap->use_gpu_copy) {
@@ -139,8 +141,6 @@ exaCopyDirty(ExaMigrationPtr migrate, RegionPtr pValidDst, RegionPtr pValidSrc,
     RegionSubtract(&CopyReg, pValidSrc, pValidDst);
 
     if (migrate->as_dst) {
-        ExaScreenPriv(pPixmap->drawable.pScreen);
-
         /* XXX: The pending damage region will be marked as damaged after the
          * operation, so it should serve as an upper bound for the region that
          * needs to be synchronized for the operation. Unfortunately, this
@@ -245,9 +245,28 @@ exaCopyDirty(ExaMigrationPtr migrate, RegionPtr pValidDst, RegionPtr pValidSrc,
         else
             need_sync = TRUE;
 
+        bytes += (uint64_t) (pBox->x2 - pBox->x1) * (pBox->y2 - pBox->y1) *
+            pPixmap->drawable.bitsPerPixel / 8;
         pBox++;
     }
 
+    if (bytes) {
+        if (fallback_index == EXA_PREPARE_DEST) {
+            pExaScr->migration_stats.uploads++;
+            pExaScr->migration_stats.bytes_uploaded += bytes;
+        }
+        else {
+            pExaScr->migration_stats.downloads++;
+            pExaScr->migration_stats.bytes_downloaded += bytes;
+        }
+
+        if (pExaPixmap->transfer_size)
+            pExaPixmap->transfer_size = (pExaPixmap->transfer_size * 3 +
+                                         bytes) / 4;
+        else
+            pExaPixmap->transfer_size = bytes;
+    }
+
     pExaPixmap->use_gpu_copy = save_use_gpu_copy;
     pPixmap->devKind = save_pitch;
 
@@ -737,6 +756,46 @@ exaDoMigration_classic(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel)
             ExaOffscreenMarkUsed(pixmaps[i].pPix);
         }
     }
+    else if (pExaScr->migration == ExaMigrationAdaptive) {
+        /* Pixmaps go wherever their recent accesses say they are cheapest
+         * to keep, see exaPixmapWantsGpuCopy().  Pixmaps staying in
+         * offscreen memory are accessed there by software fallbacks, and
+         * accelerated operations on a destination staying in system memory
+         * fall back to software.
+         */
+        if (!can_accel) {
+            for (i = 0; i < npixmaps; i++) {
+                if (!exaPixmapWantsGpuCopy(pixmaps[i].pPix)) {
+                    exaDoMoveOutPixmap(pixmaps + i);
+                    continue;
+                }
+
+                if (exaPixmapHasGpuCopy(pixmaps[i].pPix)) {
+                    pExaScr->migration_stats.kept_in_fb++;
+                    exaCopyDirtyToFb(pixmaps + i);
+                    ExaOffscreenMarkUsed(pixmaps[i].pPix);
+                }
+                else
+                    exaCopyDirtyToSys(pixmaps + i);
+            }
+            return;
+        }
+
+        for (i = 0; i < npixmaps; i++) {
+            if (pixmaps[i].as_dst &&
+                !exaPixmapHasGpuCopy(pixmaps[i].pPix) &&
+                !exaPixmapWantsGpuCopy(pixmaps[i].pPix)) {
+                pExaScr->migration_stats.kept_in_sys++;
+                return;
+            }
+        }
+
+        for (i = 0; i < npixmaps; i++) {
+            exaDoMoveInPixmap(pixmaps + i);
+            if (exaPixmapHasGpuCopy(pixmaps[i].pPix))
+                ExaOffscreenMarkUsed(pixmaps[i].pPix);
+        }
+    }
 }
 
 void
@@ -75,8 +75,15 @@ exaCreateDriverPixmap_mixed(PixmapPtr pPixmap)
     (*pScreen->ModifyPixmapHeader) (pPixmap, w, h, 0, 0, paddedWidth, NULL);
 }
 
-void
-exaDoMigration_mixed(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel)
+/**
+ * Moves the pixmaps into driver pixmaps if the operation can be
+ * accelerated.  @access is TRUE when the move is for an access to the
+ * pixmaps, which the adaptive heuristic may leave in system memory;
+ * explicit move-ins always happen.
+ */
+static void
+exaMigratePixmaps_mixed(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel,
+                        Bool access)
 {
     int i;
 
@@ -100,8 +107,20 @@ exaDoMigration_mixed(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel)
 
         ExaPixmapPriv(pPixmap);
 
-        if (!pExaPixmap->driverPriv)
+        if (!pExaPixmap->driverPriv) {
+            ExaScreenPriv(pPixmap->drawable.pScreen);
+
+            /* Leave pixmaps mostly used by software fallbacks in system
+             * memory, the operation will fall back as well.
+             */
+            if (access && pExaScr->migration == ExaMigrationAdaptive &&
+                !exaPixmapWantsGpuCopy(pPixmap)) {
+                pExaScr->migration_stats.kept_in_sys++;
+                continue;
+            }
+
             exaCreateDriverPixmap_mixed(pPixmap);
+        }
 
         if (pExaPixmap->pDamage && exaPixmapHasGpuCopy(pPixmap)) {
             ExaScreenPriv(pPixmap->drawable.pScreen);
@@ -126,6 +145,12 @@ exaDoMigration_mixed(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel)
     }
 }
 
+void
+exaDoMigration_mixed(ExaMigrationPtr pixmaps, int npixmaps, Bool can_accel)
+{
+    exaMigratePixmaps_mixed(pixmaps, npixmaps, can_accel, TRUE);
+}
+
 void
 exaMoveInPixmap_mixed(PixmapPtr pPixmap)
 {
@@ -136,7 +161,8 @@ exaMoveInPixmap_mixed(PixmapPtr pPixmap)
     pixmaps[0].pPix = pPixmap;
     pixmaps[0].pReg = NULL;
 
-    exaDoMigration(pixmaps, 1, TRUE);
+    /* Not through exaDoMigration(), this isn't an access to the pixmap */
+    exaMigratePixmaps_mixed(pixmaps, 1, TRUE, FALSE);
 }
 
 void
@@ -174,6 +200,8 @@ exaPrepareAccessReg_mixed(PixmapPtr pPixmap, int index, RegionPtr pReg)
     Bool has_gpu_copy = exaPixmapHasGpuCopy(pPixmap);
     Bool success;
 
+    exaPixmapNoteAccess(pPixmap, FALSE);
+
     success = ExaDoPrepareAccess(pPixmap, index);
 
     if (success && has_gpu_copy && pExaPixmap->pDamage) {
@@ -101,7 +101,8 @@ do { \
 enum ExaMigrationHeuristic {
     ExaMigrationGreedy,
     ExaMigrationAlways,
-    ExaMigrationSmart
+    ExaMigrationSmart,
+    ExaMigrationAdaptive
 };
 
 typedef struct {
@@ -195,6 +196,21 @@ typedef struct {
         Bool retval;
     } access[EXA_NUM_PREPARE_INDICES];
 
+    /* Migration statistics, logged every EXA_STATS_REPORT_INTERVAL while
+     * pixmaps are being used, and when the screen is closed
+     */
+    struct {
+        unsigned long cpu_accesses;
+        unsigned long gpu_accesses;
+        unsigned long uploads;
+        unsigned long downloads;
+        uint64_t bytes_uploaded;
+        uint64_t bytes_downloaded;
+        unsigned long kept_in_sys;  /**< accelerated ops done in software */
+        unsigned long kept_in_fb;   /**< fallbacks done in offscreen memory */
+        CARD32 report_time;
+    } migration_stats;
+
     /* Holds information on fallbacks that cannot be relayed otherwise. */
     unsigned int fallback_flags;
     unsigned int fallback_counter;
@@ -280,6 +296,16 @@ extern DevPrivateKeyRec exaScreenPrivateKeyRec;
 #define EXA_PIXMAP_SCORE_PINNED	    1000
 #define EXA_PIXMAP_SCORE_INIT	    1001
 
+/* The adaptive heuristic's access history is halved once it grows past
+ * EXA_ACCESS_HISTORY, and not acted upon until it holds
+ * EXA_ACCESS_MIN_HISTORY accesses.
+ */
+#define EXA_ACCESS_HISTORY	    64
+#define EXA_ACCESS_MIN_HISTORY	    4
+
+/* Interval between reports of the migration statistics, in ms */
+#define EXA_STATS_REPORT_INTERVAL   60000
+
 #define ExaGetPixmapPriv(p) ((ExaPixmapPrivPtr)dixGetPrivateAddr(&(p)->devPrivates, &ExaGetScreenPriv((p)->drawable.pScreen)->pixmapPrivateKeyRec))
 #define ExaPixmapPriv(p)	ExaPixmapPrivPtr pExaPixmap = ExaGetPixmapPriv(p)
 
@@ -290,6 +316,15 @@ extern DevPrivateKeyRec exaScreenPrivateKeyRec;
 typedef struct {
     ExaOffscreenArea *area;
     int score;                  /**< score for the move-in vs move-out heuristic */
+
+    /**
+     * Recent accesses by the CPU (software fallbacks) and by the accelerator,
+     * and the running average of bytes moved per migration of the pixmap,
+     * used by the adaptive migration heuristic.
+     */
+    unsigned short cpu_accesses;
+    unsigned short gpu_accesses;
+    uint64_t transfer_size;
     Bool use_gpu_copy;
 
     CARD8 *sys_ptr;             /**< pointer to pixmap data in system memory */
@@ -584,6 +619,12 @@ void
 Bool
  exaPixmapIsPinned(PixmapPtr pPix);
 
+void
+ exaPixmapNoteAccess(PixmapPtr pPix, Bool gpu);
+
+Bool
+ exaPixmapWantsGpuCopy(PixmapPtr pPix);
+
 extern const GCFuncs exaGCFuncs;
 
 /* exa_classic.c */
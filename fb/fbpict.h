@@ -52,6 +52,14 @@ extern _X_EXPORT void
 fbAddTriangles(PicturePtr pPicture,
                INT16 xOff, INT16 yOff, int ntri, xTriangle * tris);
 
+extern _X_EXPORT void
+fbCompositeSpanTrapezoids(pixman_op_t op,
+                          pixman_image_t * src,
+                          pixman_image_t * dst,
+                          pixman_format_code_t mask_format,
+                          int x_src, int y_src, int x_dst, int y_dst,
+                          BoxPtr clip, int ntrap, const xTrapezoid * traps);
+
 extern _X_EXPORT void
 fbTrapezoids(CARD8 op,
              PicturePtr pSrc,
@@ -66,6 +74,9 @@ fbTriangles(CARD8 op,
             PictFormatPtr maskFormat,
             INT16 xSrc, INT16 ySrc, int ntris, xTriangle * tris);
 
+extern _X_EXPORT void
+fbTriangleToTrapezoids(const xTriangle * tri, xTrapezoid * traps);
+
 extern _X_EXPORT void
 fbGlyphs(CARD8 op,
 	 PicturePtr pSrc,
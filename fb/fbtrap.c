@@ -24,6 +24,9 @@
 #include <dix-config.h>
 #endif
 
+#include <stdint.h>
+#include <string.h>
+
 #include "fb.h"
 
 #include "picturestr.h"
@@ -80,6 +83,387 @@ fbAddTriangles(PicturePtr pPicture,
     free_pixman_pict(pPicture, image);
 }
 
+/*
+ * Span based trapezoid compositing.
+ *
+ * pixman_composite_trapezoids rasterizes all the trapezoids into a mask
+ * covering their bounds and composites the whole of it, even where it is
+ * empty.  Cairo sends antialiased paths as many thin trapezoids, which can
+ * be spread over a large area.
+ *
+ * Here the trapezoids are sorted by their top, and rasterized a band of
+ * rows at a time into a buffer for that band only, which is composited
+ * straight away, over the columns the band's trapezoids cover and within
+ * the clip.  The coverage of each pixel is what pixman_rasterize_trapezoid
+ * gives for the whole mask, so the results are the same.  This only works
+ * for operators where a zero mask leaves the destination alone, as the
+ * rest of the mask is never composited.
+ *
+ * For large masks, the bands are split between worker threads, each of
+ * which rasterizes its own part of the mask, and the parts are composited
+ * once all of them are done.
+ */
+
+#define FB_SPAN_BAND            16      /* rows rasterized at once */
+#define FB_SPAN_MAX_TASKS       8
+
+/* Below this many mask pixels, threads cost more than they save */
+#define FB_SPAN_MIN_PARALLEL    (512 * 512)
+
+typedef struct {
+    const xTrapezoid *trap;
+    BoxRec box;
+} FbSpanTrapRec, *FbSpanTrapPtr;
+
+typedef struct {
+    FbSpanTrapPtr traps;        /* sorted by the top of their bounds */
+    int ntrap;
+    int *active;
+    pixman_format_code_t format;
+    BoxRec extents;             /* of the whole mask */
+    int y1, y2;                 /* rows of this task */
+    uint8_t *bits;              /* of a single band when streaming */
+    int stride;
+    Bool stream;
+    BoxPtr bands;               /* covered part of each band */
+
+    pixman_op_t op;
+    pixman_image_t *src;
+    pixman_image_t *dst;
+    int x_src, y_src;
+    int x_dst, y_dst;
+} FbSpanTaskRec, *FbSpanTaskPtr;
+
+static WorkerPoolPtr fbSpanPool;
+
+static int
+fbSpanTrapCompare(const void *a, const void *b)
+{
+    return ((const FbSpanTrapRec *) a)->box.y1 -
+        ((const FbSpanTrapRec *) b)->box.y1;
+}
+
+static void
+fbSpanComposite(FbSpanTaskPtr task, pixman_image_t *mask, int mask_y,
+                BoxPtr band)
+{
+    pixman_image_composite32(task->op, task->src, mask, task->dst,
+                             task->x_src + band->x1, task->y_src + band->y1,
+                             band->x1 - task->extents.x1, mask_y,
+                             task->x_dst + band->x1, task->y_dst + band->y1,
+                             band->x2 - band->x1, band->y2 - band->y1);
+}
+
+static void
+fbSpanRasterize(void *data)
+{
+    FbSpanTaskPtr task = data;
+    int bpp = PIXMAN_FORMAT_BPP(task->format);
+    int width = task->extents.x2 - task->extents.x1;
+    int first = 0, nactive = 0;
+    BoxPtr band = task->bands;
+    int y, i, j;
+
+    for (y = task->y1; y < task->y2; y += FB_SPAN_BAND, band++) {
+        int height = min(FB_SPAN_BAND, task->y2 - y);
+        pixman_image_t *image;
+        uint8_t *bits;
+        int b1, b2;
+
+        while (first < task->ntrap && task->traps[first].box.y1 < y + height)
+            task->active[nactive++] = first++;
+
+        /* Drop the trapezoids above the band, and find the columns the
+         * others cover */
+        band->x1 = task->extents.x2;
+        band->x2 = task->extents.x1;
+        band->y1 = y;
+        band->y2 = y + height;
+        for (i = j = 0; i < nactive; i++) {
+            BoxPtr box = &task->traps[task->active[i]].box;
+
+            if (box->y2 <= y)
+                continue;
+            task->active[j++] = task->active[i];
+            band->x1 = min(band->x1, box->x1);
+            band->x2 = max(band->x2, box->x2);
+        }
+        nactive = j;
+
+        band->x1 = max(band->x1, task->extents.x1);
+        band->x2 = min(band->x2, task->extents.x2);
+        if (band->x1 >= band->x2)
+            continue;
+
+        bits = task->bits;
+        if (!task->stream)
+            bits += (y - task->y1) * task->stride;
+
+        b1 = ((band->x1 - task->extents.x1) * bpp) >> 3;
+        b2 = ((band->x2 - task->extents.x1) * bpp + 7) >> 3;
+        for (i = 0; i < height; i++)
+            memset(bits + i * task->stride + b1, 0, b2 - b1);
+
+        image = pixman_image_create_bits(task->format, width, height,
+                                         (uint32_t *) bits, task->stride);
+        if (!image) {
+            band->x2 = band->x1;
+            continue;
+        }
+
+        for (i = 0; i < nactive; i++)
+            pixman_rasterize_trapezoid(image, (const pixman_trapezoid_t *)
+                                       task->traps[task->active[i]].trap,
+                                       -task->extents.x1, -y);
+
+        if (task->stream)
+            fbSpanComposite(task, image, 0, band);
+
+        pixman_image_unref(image);
+    }
+}
+
+/**
+ * Composite @traps through a mask of @mask_format, like
+ * pixman_composite_trapezoids, limited to @clip, in the coordinates of the
+ * trapezoids.  @op must leave the destination alone where the mask is
+ * zero.
+ */
+void
+fbCompositeSpanTrapezoids(pixman_op_t op,
+                          pixman_image_t * src,
+                          pixman_image_t * dst,
+                          pixman_format_code_t mask_format,
+                          int x_src, int y_src, int x_dst, int y_dst,
+                          BoxPtr clip, int ntrap, const xTrapezoid * traps)
+{
+    FbSpanTaskRec tasks[FB_SPAN_MAX_TASKS];
+    FbSpanTrapPtr spans;
+    BoxRec extents;
+    int nspan, ntask, nband, width, height, stride;
+    Bool ok;
+    int i;
+
+    spans = xallocarray(ntrap, sizeof(FbSpanTrapRec));
+    if (!spans)
+        goto fallback;
+
+    extents.x1 = extents.y1 = MAXSHORT;
+    extents.x2 = extents.y2 = MINSHORT;
+    for (i = nspan = 0; i < ntrap; i++) {
+        FbSpanTrapPtr span = &spans[nspan];
+
+        if (!xTrapezoidValid(&traps[i]))
+            continue;
+        miTrapezoidBounds(1, (xTrapezoid *) &traps[i], &span->box);
+        if (span->box.x1 >= span->box.x2 || span->box.y1 >= span->box.y2)
+            continue;
+        span->trap = &traps[i];
+        extents.x1 = min(extents.x1, span->box.x1);
+        extents.y1 = min(extents.y1, span->box.y1);
+        extents.x2 = max(extents.x2, span->box.x2);
+        extents.y2 = max(extents.y2, span->box.y2);
+        nspan++;
+    }
+
+    extents.x1 = max(extents.x1, clip->x1);
+    extents.y1 = max(extents.y1, clip->y1);
+    extents.x2 = min(extents.x2, clip->x2);
+    extents.y2 = min(extents.y2, clip->y2);
+    if (extents.x1 >= extents.x2 || extents.y1 >= extents.y2) {
+        free(spans);
+        return;
+    }
+
+    qsort(spans, nspan, sizeof(FbSpanTrapRec), fbSpanTrapCompare);
+
+    width = extents.x2 - extents.x1;
+    height = extents.y2 - extents.y1;
+    stride = ((width * PIXMAN_FORMAT_BPP(mask_format) + 31) >> 5) *
+        sizeof(uint32_t);
+    nband = (height + FB_SPAN_BAND - 1) / FB_SPAN_BAND;
+
+    ntask = 1;
+    if (width * height >= FB_SPAN_MIN_PARALLEL) {
+        if (!fbSpanPool)
+            fbSpanPool =
+                WorkerPoolCreate("fbtrap",
+                                 WorkerPoolDefaultThreads(FB_SPAN_MAX_TASKS - 1));
+        if (fbSpanPool) {
+            ntask = min(WorkerPoolThreads(fbSpanPool) + 1, FB_SPAN_MAX_TASKS);
+            ntask = min(ntask, nband);
+        }
+    }
+
+    /* Each task gets whole bands, and a buffer for all of them unless it
+     * can composite them as it goes
+     */
+    memset(tasks, 0, sizeof(tasks));
+    for (i = 0; i < ntask; i++) {
+        FbSpanTaskPtr task = &tasks[i];
+        int b1 = i * nband / ntask, b2 = (i + 1) * nband / ntask;
+
+        task->traps = spans;
+        task->ntrap = nspan;
+        task->format = mask_format;
+        task->extents = extents;
+        task->y1 = extents.y1 + b1 * FB_SPAN_BAND;
+        task->y2 = min(extents.y1 + b2 * FB_SPAN_BAND, extents.y2);
+        task->stride = stride;
+        task->stream = ntask == 1;
+        task->op = op;
+        task->src = src;
+        task->dst = dst;
+        task->x_src = x_src;
+        task->y_src = y_src;
+        task->x_dst = x_dst;
+        task->y_dst = y_dst;
+
+        task->active = xallocarray(nspan, sizeof(int));
+        task->bands = xallocarray(b2 - b1, sizeof(BoxRec));
+        task->bits = malloc((task->stream ? FB_SPAN_BAND :
+                             task->y2 - task->y1) * stride);
+        if (!task->active || !task->bands || !task->bits)
+            break;
+    }
+    ok = i == ntask;
+
+    if (ok) {
+        for (i = 1; i < ntask; i++) {
+            if (!WorkerPoolQueue(fbSpanPool, fbSpanRasterize, NULL, &tasks[i]))
+                fbSpanRasterize(&tasks[i]);
+        }
+        fbSpanRasterize(&tasks[0]);
+
+        if (ntask > 1)
+            WorkerPoolDrain(fbSpanPool);
+    }
+
+    for (i = 0; i < ntask; i++) {
+        FbSpanTaskPtr task = &tasks[i];
+        pixman_image_t *image;
+        int b;
+
+        if (ok && !task->stream) {
+            image = pixman_image_create_bits(mask_format, width,
+                                             task->y2 - task->y1,
+                                             (uint32_t *) task->bits, stride);
+            for (b = 0; image && task->y1 + b * FB_SPAN_BAND < task->y2; b++) {
+                BoxPtr band = &task->bands[b];
+
+                if (band->x1 < band->x2)
+                    fbSpanComposite(task, image, band->y1 - task->y1, band);
+            }
+            if (image)
+                pixman_image_unref(image);
+        }
+
+        free(task->active);
+        free(task->bands);
+        free(task->bits);
+    }
+    free(spans);
+    if (ok)
+        return;
+
+ fallback:
+    pixman_composite_trapezoids(op, src, dst, mask_format,
+                                x_src, y_src, x_dst, y_dst,
+                                ntrap, (const pixman_trapezoid_t *) traps);
+}
+
+/* Whether a zero mask leaves the destination alone */
+static Bool
+fbSpanOperator(CARD8 op)
+{
+    switch (op) {
+    case PictOpDst:
+    case PictOpOver:
+    case PictOpOverReverse:
+    case PictOpOutReverse:
+    case PictOpAtop:
+    case PictOpXor:
+    case PictOpAdd:
+    case PictOpSaturate:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * Split a triangle in two trapezoids, the same way as
+ * pixman_composite_triangles does.
+ */
+static Bool
+fbGreaterY(const xPointFixed * a, const xPointFixed * b)
+{
+    if (a->y == b->y)
+        return a->x > b->x;
+    return a->y > b->y;
+}
+
+static Bool
+fbClockwise(const xPointFixed * ref, const xPointFixed * a,
+            const xPointFixed * b)
+{
+    xPointFixed ad, bd;
+
+    ad.x = a->x - ref->x;
+    ad.y = a->y - ref->y;
+    bd.x = b->x - ref->x;
+    bd.y = b->y - ref->y;
+
+    return ((xFixed_32_32) bd.y * ad.x - (xFixed_32_32) ad.y * bd.x) < 0;
+}
+
+void
+fbTriangleToTrapezoids(const xTriangle * tri, xTrapezoid * traps)
+{
+    const xPointFixed *top, *left, *right, *tmp;
+
+    top = &tri->p1;
+    left = &tri->p2;
+    right = &tri->p3;
+
+    if (fbGreaterY(top, left)) {
+        tmp = left;
+        left = top;
+        top = tmp;
+    }
+    if (fbGreaterY(top, right)) {
+        tmp = right;
+        right = top;
+        top = tmp;
+    }
+    if (fbClockwise(top, right, left)) {
+        tmp = right;
+        right = left;
+        left = tmp;
+    }
+
+    traps[0].top = top->y;
+    traps[0].left.p1 = *top;
+    traps[0].left.p2 = *left;
+    traps[0].right.p1 = *top;
+    traps[0].right.p2 = *right;
+    traps[0].bottom = min(right->y, left->y);
+
+    traps[1] = traps[0];
+    if (right->y < left->y) {
+        traps[1].top = right->y;
+        traps[1].bottom = left->y;
+        traps[1].right.p1 = *right;
+        traps[1].right.p2 = *left;
+    }
+    else {
+        traps[1].top = left->y;
+        traps[1].bottom = right->y;
+        traps[1].left.p1 = *left;
+        traps[1].left.p2 = *right;
+    }
+}
+
 typedef void (*CompositeShapesFunc) (pixman_op_t op,
                                      pixman_image_t * src,
                                      pixman_image_t * dst,
@@ -88,8 +472,13 @@ typedef void (*CompositeShapesFunc) (pixman_op_t op,
                                      int x_dst, int y_dst,
                                      int n_shapes, const uint8_t * shapes);
 
+/*
+ * With @spans, the shapes are trapezoids, which are drawn with
+ * fbCompositeSpanTrapezoids when possible.
+ */
 static void
 fbShapes(CompositeShapesFunc composite,
+         Bool spans,
          pixman_op_t op,
          PicturePtr pSrc,
          PicturePtr pDst,
@@ -142,9 +531,28 @@ fbShapes(CompositeShapesFunc composite,
                 break;
             }
 
-            composite(op, src, dst, format,
-                      xSrc + src_xoff,
-                      ySrc + src_yoff, dst_xoff, dst_yoff, nshapes, shapes);
+            /* Adding to a mask of the same format is done in place by
+             * pixman already */
+            if (spans && fbSpanOperator(op) &&
+                !(op == PictOpAdd && pDst->format == maskFormat->format)) {
+                BoxRec clip = *RegionExtents(pDst->pCompositeClip);
+
+                clip.x1 -= pDst->pDrawable->x;
+                clip.y1 -= pDst->pDrawable->y;
+                clip.x2 -= pDst->pDrawable->x;
+                clip.y2 -= pDst->pDrawable->y;
+                fbCompositeSpanTrapezoids(op, src, dst, format,
+                                          xSrc + src_xoff, ySrc + src_yoff,
+                                          dst_xoff, dst_yoff, &clip,
+                                          nshapes,
+                                          (const xTrapezoid *) shapes);
+            }
+            else {
+                composite(op, src, dst, format,
+                          xSrc + src_xoff,
+                          ySrc + src_yoff, dst_xoff, dst_yoff,
+                          nshapes, shapes);
+            }
         }
 
         DamageRegionProcessPending(pDst->pDrawable);
@@ -164,7 +572,7 @@ fbTrapezoids(CARD8 op,
     xSrc -= (traps[0].left.p1.x >> 16);
     ySrc -= (traps[0].left.p1.y >> 16);
 
-    fbShapes((CompositeShapesFunc) pixman_composite_trapezoids,
+    fbShapes((CompositeShapesFunc) pixman_composite_trapezoids, TRUE,
              op, pSrc, pDst, maskFormat,
              xSrc, ySrc, ntrap, sizeof(xTrapezoid), (const uint8_t *) traps);
 }
@@ -176,10 +584,26 @@ fbTriangles(CARD8 op,
             PictFormatPtr maskFormat,
             INT16 xSrc, INT16 ySrc, int ntris, xTriangle * tris)
 {
+    xTrapezoid *traps;
+    int i;
+
     xSrc -= (tris[0].p1.x >> 16);
     ySrc -= (tris[0].p1.y >> 16);
 
-    fbShapes((CompositeShapesFunc) pixman_composite_triangles,
+    if (maskFormat && fbSpanOperator(op) &&
+        (traps = xallocarray(ntris, 2 * sizeof(xTrapezoid)))) {
+        for (i = 0; i < ntris; i++)
+            fbTriangleToTrapezoids(&tris[i], &traps[2 * i]);
+
+        fbShapes((CompositeShapesFunc) pixman_composite_trapezoids, TRUE,
+                 op, pSrc, pDst, maskFormat,
+                 xSrc, ySrc, 2 * ntris, sizeof(xTrapezoid),
+                 (const uint8_t *) traps);
+        free(traps);
+        return;
+    }
+
+    fbShapes((CompositeShapesFunc) pixman_composite_triangles, FALSE,
              op, pSrc, pDst, maskFormat,
              xSrc, ySrc, ntris, sizeof(xTriangle), (const uint8_t *) tris);
 }
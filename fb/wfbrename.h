@@ -23,6 +23,7 @@
 #define fbClearVisualTypes wfbClearVisualTypes
 #define fbCloseScreen wfbCloseScreen
 #define fbComposite wfbComposite
+#define fbCompositeSpanTrapezoids wfbCompositeSpanTrapezoids
 #define fbCopy1toN wfbCopy1toN
 #define fbCopyArea wfbCopyArea
 #define fbCopyNto1 wfbCopyNto1
@@ -118,6 +119,7 @@
 #define fbSolidBoxClipped wfbSolidBoxClipped
 #define fbTrapezoids wfbTrapezoids
 #define fbTriangles wfbTriangles
+#define fbTriangleToTrapezoids wfbTriangleToTrapezoids
 #define fbUninstallColormap wfbUninstallColormap
 #define fbUnrealizeWindow wfbUnrealizeWindow
 #define fbUnrealizeFont wfbUnrealizeFont
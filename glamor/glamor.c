@@ -256,6 +256,7 @@ glamor_block_handler(ScreenPtr screen)
     glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
 
     glamor_make_current(glamor_priv);
+    glamor_fbo_cache_expire(glamor_priv);
     glFlush();
 }
 
@@ -265,6 +266,7 @@ _glamor_block_handler(ScreenPtr screen, void *timeout)
     glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
 
     glamor_make_current(glamor_priv);
+    glamor_fbo_cache_expire(glamor_priv);
     glFlush();
 
     screen->BlockHandler = glamor_priv->saved_procs.block_handler;
@@ -665,6 +667,8 @@ glamor_init(ScreenPtr screen, unsigned int flags)
     }
 
     glamor_set_debug_level(&glamor_debug_level);
+    glamor_init_fbo_cache(glamor_priv);
+    glamor_init_program_cache(screen);
 
     glamor_priv->saved_procs.create_screen_resources =
         screen->CreateScreenResources;
@@ -729,6 +733,9 @@ glamor_init(ScreenPtr screen, unsigned int flags)
     glamor_pixmap_init(screen);
     glamor_sync_init(screen);
 
+    if (glamor_priv->program_cache_dir)
+        glamor_prewarm_composite_shaders(screen);
+
     glamor_priv->screen = screen;
 
     return TRUE;
@@ -765,6 +772,7 @@ glamor_close_screen(ScreenPtr screen)
     PictureScreenPtr ps = GetPictureScreenIfSet(screen);
 
     glamor_priv = glamor_get_screen_private(screen);
+    glamor_fini_batch(screen);
     glamor_sync_close(screen);
     glamor_composite_glyphs_fini(screen);
     screen->CloseScreen = glamor_priv->saved_procs.close_screen;
@@ -789,6 +797,8 @@ glamor_close_screen(ScreenPtr screen)
 
     screen_pixmap = screen->GetScreenPixmap(screen);
     glamor_pixmap_destroy_fbo(screen_pixmap);
+    glamor_fini_fbo_cache(glamor_priv);
+    glamor_fini_program_cache(screen);
 
     glamor_release_screen_priv(screen);
 
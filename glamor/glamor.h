@@ -150,6 +150,13 @@ extern _X_EXPORT int glamor_egl_dri3_fd_name_from_tex(ScreenPtr, PixmapPtr,
 
 extern _X_EXPORT struct gbm_device *glamor_egl_get_gbm_device(ScreenPtr screen);
 
+/* @glamor_egl_fence_fd: Flush and return a sync file for the rendering
+ * queued so far, or -1 if the driver can't export one.
+ *
+ * @screen: Current screen pointer.
+ */
+extern _X_EXPORT int glamor_egl_fence_fd(ScreenPtr screen);
+
 /* @glamor_supports_pixmap_import_export: Returns whether
  * glamor_fd_from_pixmap(), glamor_name_from_pixmap(), and
  * glamor_pixmap_from_fd() are supported.
@@ -144,6 +144,22 @@ static const glamor_facet glamor_facet_copyplane = {
     .use = use_copyplane,
 };
 
+/* Only the destination boxes need to go back to the GPU */
+static void
+glamor_copy_damage(DrawablePtr dst, BoxPtr box, int nbox)
+{
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+
+    while (nbox--) {
+        x1 = min(x1, box->x1);
+        y1 = min(y1, box->y1);
+        x2 = max(x2, box->x2);
+        y2 = max(y2, box->y2);
+        box++;
+    }
+    glamor_access_damage(dst, NULL, x1, y1, x2, y2);
+}
+
 /*
  * When all else fails, pull the bits out of the GPU and do the
  * operation with fb
@@ -175,6 +191,7 @@ glamor_copy_bail(DrawablePtr src,
                        reverse, upsidedown, bitplane, closure);
         }
     }
+    glamor_copy_damage(dst, box, nbox);
     glamor_finish_access(dst);
     glamor_finish_access(src);
 }
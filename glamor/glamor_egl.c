@@ -57,6 +57,7 @@ struct glamor_egl_screen_private {
     CloseScreenProcPtr CloseScreen;
     int fd;
     struct gbm_device *gbm;
+    Bool has_native_fence;
 
     CloseScreenProcPtr saved_close_screen;
     DestroyPixmapProcPtr saved_destroy_pixmap;
@@ -132,6 +133,37 @@ glamor_egl_get_gbm_device(ScreenPtr screen)
     return glamor_egl->gbm;
 }
 
+/**
+ * Flush the rendering queued so far, and return a sync file which becomes
+ * readable once the GPU is done with it, or -1 if the driver can't export
+ * one.  The caller owns the file descriptor.
+ */
+int
+glamor_egl_fence_fd(ScreenPtr screen)
+{
+    struct glamor_egl_screen_private *glamor_egl =
+        glamor_egl_get_screen_private(xf86ScreenToScrn(screen));
+    EGLSyncKHR sync;
+    int fd;
+
+    if (!glamor_egl->has_native_fence)
+        return -1;
+
+    glamor_make_current(glamor_get_screen_private(screen));
+
+    sync = eglCreateSyncKHR(glamor_egl->display,
+                            EGL_SYNC_NATIVE_FENCE_ANDROID, NULL);
+    if (sync == EGL_NO_SYNC_KHR)
+        return -1;
+
+    /* The fence only gets a file descriptor once it has been flushed */
+    glFlush();
+    fd = eglDupNativeFenceFDANDROID(glamor_egl->display, sync);
+    eglDestroySyncKHR(glamor_egl->display, sync);
+
+    return fd == EGL_NO_NATIVE_FENCE_FD_ANDROID ? -1 : fd;
+}
+
 Bool
 glamor_egl_create_textured_screen(ScreenPtr screen, int handle, int stride)
 {
@@ -734,6 +766,11 @@ glamor_egl_init(ScrnInfoPtr scrn, int fd)
         goto error;
     }
 
+    glamor_egl->has_native_fence =
+        epoxy_has_egl_extension(glamor_egl->display, "EGL_KHR_fence_sync") &&
+        epoxy_has_egl_extension(glamor_egl->display,
+                                "EGL_ANDROID_native_fence_sync");
+
     xf86DrvMsg(scrn->scrnIndex, X_INFO, "glamor X acceleration enabled on %s\n",
                glGetString(GL_RENDERER));
 
@@ -27,12 +27,41 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "glamor_priv.h"
 
-void
-glamor_destroy_fbo(glamor_screen_private *glamor_priv,
-                   glamor_pixmap_fbo *fbo)
+/*
+ * FBO cache.
+ *
+ * Short-lived pixmaps are common, so instead of deleting the texture and
+ * framebuffer of a destroyed pixmap, glamor_destroy_fbo keeps them in a
+ * cache where glamor_create_fbo can pick them up again for a pixmap of
+ * the same size and format.  Cached FBOs are freed after
+ * GLAMOR_FBO_CACHE_EXPIRE milliseconds, or oldest first once the cache
+ * holds more than fbo_cache_size bytes.
+ */
+
+#define GLAMOR_FBO_CACHE_EXPIRE 1000
+#define GLAMOR_FBO_CACHE_DEFAULT_SIZE (32 * 1024 * 1024)
+
+static inline int
+glamor_fbo_cache_bucket(int w, int h, GLenum format)
+{
+    return (w * 31 + h * 17 + format) % GLAMOR_FBO_CACHE_BUCKETS;
+}
+
+static inline size_t
+glamor_fbo_size(glamor_pixmap_fbo *fbo)
+{
+    int cpp = (fbo->format == GL_RED || fbo->format == GL_ALPHA) ? 1 : 4;
+
+    return (size_t) fbo->width * fbo->height * cpp;
+}
+
+static void
+glamor_purge_fbo(glamor_screen_private *glamor_priv,
+                 glamor_pixmap_fbo *fbo)
 {
     glamor_make_current(glamor_priv);
 
@@ -44,6 +73,128 @@ glamor_destroy_fbo(glamor_screen_private *glamor_priv,
     free(fbo);
 }
 
+static void
+glamor_fbo_cache_remove(glamor_screen_private *glamor_priv,
+                        glamor_pixmap_fbo *fbo)
+{
+    xorg_list_del(&fbo->bucket);
+    xorg_list_del(&fbo->lru);
+    glamor_priv->fbo_cache_bytes -= glamor_fbo_size(fbo);
+}
+
+/* Free the oldest cached FBOs until at most size bytes are left */
+static void
+glamor_fbo_cache_trim(glamor_screen_private *glamor_priv, size_t size)
+{
+    glamor_pixmap_fbo *fbo, *tmp;
+
+    xorg_list_for_each_entry_safe(fbo, tmp, &glamor_priv->fbo_cache_lru, lru) {
+        if (glamor_priv->fbo_cache_bytes <= size)
+            break;
+        glamor_fbo_cache_remove(glamor_priv, fbo);
+        glamor_purge_fbo(glamor_priv, fbo);
+    }
+}
+
+static glamor_pixmap_fbo *
+glamor_fbo_cache_get(glamor_screen_private *glamor_priv,
+                     int w, int h, GLenum format)
+{
+    struct xorg_list *bucket;
+    glamor_pixmap_fbo *fbo;
+
+    if (!glamor_priv->fbo_cache_size)
+        return NULL;
+
+    bucket = &glamor_priv->fbo_cache[glamor_fbo_cache_bucket(w, h, format)];
+    xorg_list_for_each_entry(fbo, bucket, bucket) {
+        if (fbo->width == w && fbo->height == h && fbo->format == format) {
+            glamor_fbo_cache_remove(glamor_priv, fbo);
+            glamor_priv->fbo_cache_hits++;
+            return fbo;
+        }
+    }
+
+    glamor_priv->fbo_cache_misses++;
+    return NULL;
+}
+
+void
+glamor_destroy_fbo(glamor_screen_private *glamor_priv,
+                   glamor_pixmap_fbo *fbo)
+{
+    size_t size = glamor_fbo_size(fbo);
+
+    if (!fbo->cacheable || !fbo->tex || !glamor_priv->fbo_cache_size ||
+        size > glamor_priv->fbo_cache_size / 4) {
+        glamor_purge_fbo(glamor_priv, fbo);
+        return;
+    }
+
+    fbo->expire = GetTimeInMillis() + GLAMOR_FBO_CACHE_EXPIRE;
+    xorg_list_add(&fbo->bucket,
+                  &glamor_priv->fbo_cache[glamor_fbo_cache_bucket(fbo->width,
+                                                                  fbo->height,
+                                                                  fbo->format)]);
+    xorg_list_append(&fbo->lru, &glamor_priv->fbo_cache_lru);
+    glamor_priv->fbo_cache_bytes += size;
+
+    glamor_fbo_cache_trim(glamor_priv, glamor_priv->fbo_cache_size);
+}
+
+/**
+ * Free cached FBOs that have not been reused in time.  Called from the
+ * block handler.
+ */
+void
+glamor_fbo_cache_expire(glamor_screen_private *glamor_priv)
+{
+    glamor_pixmap_fbo *fbo, *tmp;
+    CARD32 now;
+
+    if (xorg_list_is_empty(&glamor_priv->fbo_cache_lru))
+        return;
+
+    now = GetTimeInMillis();
+    xorg_list_for_each_entry_safe(fbo, tmp, &glamor_priv->fbo_cache_lru, lru) {
+        if ((INT32) (fbo->expire - now) > 0)
+            break;
+        glamor_fbo_cache_remove(glamor_priv, fbo);
+        glamor_purge_fbo(glamor_priv, fbo);
+    }
+}
+
+void
+glamor_init_fbo_cache(glamor_screen_private *glamor_priv)
+{
+    char *size_string;
+    int i, size;
+
+    for (i = 0; i < GLAMOR_FBO_CACHE_BUCKETS; i++)
+        xorg_list_init(&glamor_priv->fbo_cache[i]);
+    xorg_list_init(&glamor_priv->fbo_cache_lru);
+
+    /* GLAMOR_FBO_CACHE_SIZE is in kilobytes, 0 disables the cache */
+    glamor_priv->fbo_cache_size = GLAMOR_FBO_CACHE_DEFAULT_SIZE;
+    size_string = getenv("GLAMOR_FBO_CACHE_SIZE");
+    if (size_string && sscanf(size_string, "%d", &size) == 1 && size >= 0)
+        glamor_priv->fbo_cache_size = (size_t) size * 1024;
+}
+
+void
+glamor_fini_fbo_cache(glamor_screen_private *glamor_priv)
+{
+    if (glamor_priv->fbo_cache_hits || glamor_priv->fbo_cache_misses)
+        LogMessageVerb(X_INFO, 4,
+                       "glamor: FBO cache: %lu hits, %lu misses, "
+                       "%zu bytes held\n",
+                       glamor_priv->fbo_cache_hits,
+                       glamor_priv->fbo_cache_misses,
+                       glamor_priv->fbo_cache_bytes);
+
+    glamor_fbo_cache_trim(glamor_priv, 0);
+}
+
 static int
 glamor_pixmap_ensure_fb(glamor_screen_private *glamor_priv,
                         glamor_pixmap_fbo *fbo)
@@ -155,12 +306,39 @@ glamor_pixmap_fbo *
 glamor_create_fbo(glamor_screen_private *glamor_priv,
                   int w, int h, GLenum format, int flag)
 {
-    GLint tex = _glamor_create_tex(glamor_priv, w, h, format);
+    glamor_pixmap_fbo *fbo;
+    GLint tex;
+
+    fbo = glamor_fbo_cache_get(glamor_priv, w, h, format);
+    if (fbo) {
+        /* Sampling state may have been changed by the previous owner */
+        glamor_make_current(glamor_priv);
+        glBindTexture(GL_TEXTURE_2D, fbo->tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        if (flag != GLAMOR_CREATE_FBO_NO_FBO && fbo->fb == 0 &&
+            glamor_pixmap_ensure_fb(glamor_priv, fbo) != 0) {
+            glamor_purge_fbo(glamor_priv, fbo);
+            return NULL;
+        }
+        return fbo;
+    }
+
+    tex = _glamor_create_tex(glamor_priv, w, h, format);
+    if (!tex && glamor_priv->fbo_cache_bytes) {
+        /* Give the cached textures back and try again */
+        glamor_fbo_cache_trim(glamor_priv, 0);
+        tex = _glamor_create_tex(glamor_priv, w, h, format);
+    }
 
     if (!tex) /* Texture creation failed due to GL_OUT_OF_MEMORY */
         return NULL;
 
-    return glamor_create_fbo_from_tex(glamor_priv, w, h, format, tex, flag);
+    fbo = glamor_create_fbo_from_tex(glamor_priv, w, h, format, tex, flag);
+    if (fbo)
+        fbo->cacheable = TRUE;
+    return fbo;
 }
 
 /**
@@ -283,6 +461,14 @@ glamor_pixmap_destroy_fbo(PixmapPtr pixmap)
     glamor_pixmap_private *priv = glamor_get_pixmap_private(pixmap);
     glamor_pixmap_fbo *fbo;
 
+    /* Whatever was queued for the old contents can go */
+    if (glamor_priv->batch.pixmap == pixmap) {
+        glamor_priv->batch.nrect = 0;
+        glamor_priv->batch.pixmap = NULL;
+    }
+
+    glamor_invalidate_shadow(priv);
+
     if (glamor_pixmap_priv_is_large(priv)) {
         int i;
 
@@ -336,9 +522,17 @@ glamor_pixmap_exchange_fbos(PixmapPtr front, PixmapPtr back)
 {
     glamor_pixmap_private *front_priv, *back_priv;
     glamor_pixmap_fbo *temp_fbo;
+    glamor_screen_private *glamor_priv =
+        glamor_get_screen_private(front->drawable.pScreen);
+
+    if (glamor_priv->batch.pixmap == front ||
+        glamor_priv->batch.pixmap == back)
+        glamor_flush_batch(glamor_priv);
 
     front_priv = glamor_get_pixmap_private(front);
     back_priv = glamor_get_pixmap_private(back);
+    glamor_invalidate_shadow(front_priv);
+    glamor_invalidate_shadow(back_priv);
     temp_fbo = front_priv->fbo;
     front_priv->fbo = back_priv->fbo;
     back_priv->fbo = temp_fbo;
@@ -90,6 +90,9 @@ glamor_put_image_bail(DrawablePtr drawable, GCPtr gc, int depth, int x, int y,
 {
     if (glamor_prepare_access_box(drawable, GLAMOR_ACCESS_RW, x, y, w, h))
         fbPutImage(drawable, gc, depth, x, y, w, h, leftPad, format, bits);
+    glamor_access_damage(drawable, gc,
+                         drawable->x + x, drawable->y + y,
+                         drawable->x + x + w, drawable->y + y + h);
     glamor_finish_access(drawable);
 }
 
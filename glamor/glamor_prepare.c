@@ -24,6 +24,37 @@
 #include "glamor_prepare.h"
 #include "glamor_transfer.h"
 
+/*
+ * Pixmaps which go through this many fallbacks in a row without being
+ * drawn to with GL keep their CPU copy around between fallbacks, as
+ * long as it is no larger than GLAMOR_SHADOW_MAX_SIZE.
+ */
+#define GLAMOR_SHADOW_FALLBACKS 2
+#define GLAMOR_SHADOW_MAX_SIZE  (16 * 1024 * 1024)
+
+static Bool
+glamor_want_shadow(PixmapPtr pixmap, glamor_pixmap_private *priv)
+{
+    return priv->type == GLAMOR_TEXTURE_ONLY &&
+        priv->fallback_count > GLAMOR_SHADOW_FALLBACKS &&
+        (size_t) pixmap->devKind * pixmap->drawable.height <=
+        GLAMOR_SHADOW_MAX_SIZE;
+}
+
+void
+glamor_free_shadow(glamor_pixmap_private *priv)
+{
+    /* Still in use by the current fallback, just forget its contents */
+    if (priv->prepared) {
+        RegionEmpty(&priv->shadow_region);
+        return;
+    }
+
+    free(priv->shadow);
+    priv->shadow = NULL;
+    RegionUninit(&priv->shadow_region);
+}
+
 /*
  * Make a pixmap ready to draw with fb by
  * creating a PBO large enough for the whole object
@@ -68,12 +99,19 @@ glamor_prep_pixmap_box(PixmapPtr pixmap, glamor_access_t access, BoxPtr box)
          * need to add more boxes to the set of data we've downloaded, as we go.
          */
         RegionSubtract(&region, &region, &priv->prepare_region);
-        if (!RegionNotEmpty(&region))
+        if (!RegionNotEmpty(&region)) {
+            if (access == GLAMOR_ACCESS_RW)
+                priv->unreported_writes++;
             return TRUE;
+        }
 
         if (access == GLAMOR_ACCESS_RW)
             FatalError("attempt to remap buffer as writable");
 
+        RegionUnion(&priv->prepare_region, &priv->prepare_region, &region);
+        if (priv->shadow)
+            RegionSubtract(&region, &region, &priv->shadow_region);
+
         if (priv->pbo) {
             glBindBuffer(GL_PIXEL_PACK_BUFFER, priv->pbo);
             glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
@@ -81,8 +119,22 @@ glamor_prep_pixmap_box(PixmapPtr pixmap, glamor_access_t access, BoxPtr box)
         }
     } else {
         RegionInit(&priv->prepare_region, box, 1);
+        RegionNull(&priv->dirty_region);
+        priv->unreported_writes = 0;
+        priv->fallback_count++;
+
+        if (!priv->shadow && glamor_want_shadow(pixmap, priv)) {
+            priv->shadow = xallocarray(pixmap->devKind,
+                                       pixmap->drawable.height);
+            if (priv->shadow)
+                RegionNull(&priv->shadow_region);
+        }
 
-        if (glamor_priv->has_rw_pbo) {
+        if (priv->shadow) {
+            /* Only fetch what the shadow doesn't hold already */
+            pixmap->devPrivate.ptr = priv->shadow;
+            RegionSubtract(&region, &region, &priv->shadow_region);
+        } else if (glamor_priv->has_rw_pbo) {
             if (priv->pbo == 0)
                 glGenBuffers(1, &priv->pbo);
 
@@ -101,12 +153,15 @@ glamor_prep_pixmap_box(PixmapPtr pixmap, glamor_access_t access, BoxPtr box)
         priv->map_access = access;
     }
 
-    glamor_download_boxes(pixmap, RegionRects(&region), RegionNumRects(&region),
-                          0, 0, 0, 0, pixmap->devPrivate.ptr, pixmap->devKind);
+    if (RegionNotEmpty(&region))
+        glamor_download_boxes(pixmap, RegionRects(&region),
+                              RegionNumRects(&region),
+                              0, 0, 0, 0, pixmap->devPrivate.ptr,
+                              pixmap->devKind);
 
     RegionUninit(&region);
 
-    if (glamor_priv->has_rw_pbo) {
+    if (priv->pbo) {
         if (priv->map_access == GLAMOR_ACCESS_RW)
             gl_access = GL_READ_WRITE;
         else
@@ -116,21 +171,25 @@ glamor_prep_pixmap_box(PixmapPtr pixmap, glamor_access_t access, BoxPtr box)
         glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
     }
 
+    if (access == GLAMOR_ACCESS_RW)
+        priv->unreported_writes++;
     priv->prepared = TRUE;
     return TRUE;
 }
 
 /*
  * When we're done with the drawable, unmap the PBO, reupload
- * if we were writing to it and then unbind it to release the memory
+ * if we were writing to it and then unbind it to release the memory.
+ *
+ * If every writer reported what it touched with glamor_access_damage,
+ * only that area is uploaded; otherwise the whole prepared region is.
  */
 
 static void
 glamor_fini_pixmap(PixmapPtr pixmap)
 {
-    ScreenPtr                   screen = pixmap->drawable.pScreen;
-    glamor_screen_private       *glamor_priv = glamor_get_screen_private(screen);
     glamor_pixmap_private       *priv = glamor_get_pixmap_private(pixmap);
+    RegionPtr                   upload;
 
     if (!GLAMOR_PIXMAP_PRIV_HAS_FBO(priv))
         return;
@@ -138,22 +197,33 @@ glamor_fini_pixmap(PixmapPtr pixmap)
     if (!priv->prepared)
         return;
 
-    if (glamor_priv->has_rw_pbo) {
+    if (priv->pbo) {
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, priv->pbo);
         glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
         pixmap->devPrivate.ptr = NULL;
     }
 
     if (priv->map_access == GLAMOR_ACCESS_RW) {
-        glamor_upload_boxes(pixmap,
-                            RegionRects(&priv->prepare_region),
-                            RegionNumRects(&priv->prepare_region),
-                            0, 0, 0, 0, pixmap->devPrivate.ptr, pixmap->devKind);
-    }
+        upload = &priv->prepare_region;
+        if (priv->unreported_writes == 0) {
+            RegionIntersect(&priv->dirty_region, &priv->dirty_region,
+                            &priv->prepare_region);
+            upload = &priv->dirty_region;
+        }
 
-    RegionUninit(&priv->prepare_region);
+        if (RegionNotEmpty(upload))
+            glamor_upload_boxes(pixmap,
+                                RegionRects(upload), RegionNumRects(upload),
+                                0, 0, 0, 0, pixmap->devPrivate.ptr,
+                                pixmap->devKind);
+    }
 
-    if (glamor_priv->has_rw_pbo) {
+    if (priv->shadow) {
+        /* The GPU copy of everything prepared now matches the shadow */
+        RegionUnion(&priv->shadow_region, &priv->shadow_region,
+                    &priv->prepare_region);
+        pixmap->devPrivate.ptr = NULL;
+    } else if (priv->pbo) {
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
         glDeleteBuffers(1, &priv->pbo);
         priv->pbo = 0;
@@ -162,9 +232,57 @@ glamor_fini_pixmap(PixmapPtr pixmap)
         pixmap->devPrivate.ptr = NULL;
     }
 
+    RegionUninit(&priv->prepare_region);
+    RegionUninit(&priv->dirty_region);
+
     priv->prepared = FALSE;
 }
 
+/**
+ * Record that the fallback drawing to @drawable, prepared with
+ * GLAMOR_ACCESS_RW, only wrote within (x1, y1) - (x2, y2), in the screen
+ * coordinates used by the GC composite clip. A GC, if given, further
+ * limits the box to its composite clip. Must be called before the
+ * matching glamor_finish_access.
+ */
+void
+glamor_access_damage(DrawablePtr drawable, GCPtr gc,
+                     int x1, int y1, int x2, int y2)
+{
+    PixmapPtr pixmap = glamor_get_drawable_pixmap(drawable);
+    glamor_pixmap_private *priv = glamor_get_pixmap_private(pixmap);
+    RegionRec region;
+    BoxRec box;
+    int off_x, off_y;
+
+    if (!priv->prepared || priv->unreported_writes == 0)
+        return;
+
+    priv->unreported_writes--;
+
+    if (gc) {
+        BoxPtr clip = RegionExtents(gc->pCompositeClip);
+
+        x1 = max(x1, clip->x1);
+        y1 = max(y1, clip->y1);
+        x2 = min(x2, clip->x2);
+        y2 = min(y2, clip->y2);
+    }
+
+    glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
+    box.x1 = max(x1 + off_x, 0);
+    box.y1 = max(y1 + off_y, 0);
+    box.x2 = min(x2 + off_x, pixmap->drawable.width);
+    box.y2 = min(y2 + off_y, pixmap->drawable.height);
+
+    if (box.x1 >= box.x2 || box.y1 >= box.y2)
+        return;
+
+    RegionInit(&region, &box, 1);
+    RegionUnion(&priv->dirty_region, &priv->dirty_region, &region);
+    RegionUninit(&region);
+}
+
 Bool
 glamor_prepare_access(DrawablePtr drawable, glamor_access_t access)
 {
@@ -49,4 +49,23 @@ glamor_prepare_access_gc(GCPtr gc);
 void
 glamor_finish_access_gc(GCPtr gc);
 
+void
+glamor_access_damage(DrawablePtr drawable, GCPtr gc,
+                     int x1, int y1, int x2, int y2);
+
+void
+glamor_free_shadow(glamor_pixmap_private *priv);
+
+/*
+ * Called whenever the GPU copy of the pixmap is written to, as the CPU
+ * shadow no longer matches it.
+ */
+static inline void
+glamor_invalidate_shadow(glamor_pixmap_private *priv)
+{
+    priv->fallback_count = 0;
+    if (priv->shadow)
+        glamor_free_shadow(priv);
+}
+
 #endif /* _GLAMOR_PREPARE_H_ */
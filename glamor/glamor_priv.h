@@ -184,6 +184,21 @@ struct glamor_saved_procs {
     ScreenBlockHandlerProcPtr block_handler;
 };
 
+#define GLAMOR_FBO_CACHE_BUCKETS 64
+
+/*
+ * Solid rectangles queued up by glamor_poly_fill_rect, to be drawn in
+ * one go; see glamor_rects.c
+ */
+typedef struct glamor_batch {
+    PixmapPtr pixmap;
+    Pixel fg;
+    xRectangle *rects;
+    int nrect;
+    unsigned long requests;
+    unsigned long draws;
+} glamor_batch;
+
 typedef struct glamor_screen_private {
     enum glamor_gl_flavor gl_flavor;
     int glsl_version;
@@ -292,6 +307,22 @@ typedef struct glamor_screen_private {
     Bool suppress_gl_out_of_memory_logging;
     Bool logged_any_fbo_allocation_failure;
 
+    /* Released FBOs kept for reuse, see glamor_fbo.c */
+    struct xorg_list fbo_cache[GLAMOR_FBO_CACHE_BUCKETS];
+    struct xorg_list fbo_cache_lru;
+    size_t fbo_cache_bytes;
+    size_t fbo_cache_size;
+    unsigned long fbo_cache_hits;
+    unsigned long fbo_cache_misses;
+
+    /* Linked programs kept on disk, see glamor_program_cache.c */
+    char *program_cache_dir;
+    char *program_cache_driver;
+    unsigned long program_cache_hits;
+    unsigned long program_cache_misses;
+
+    glamor_batch batch;
+
     /* xv */
     glamor_program xv_prog;
 
@@ -320,6 +351,10 @@ typedef struct glamor_pixmap_fbo {
     int height; /**< height in pixels */
     GLenum format; /**< GL format used to create the texture. */
     GLenum type; /**< GL type used to create the texture. */
+    Bool cacheable; /**< texture owned by glamor, may be reused */
+    CARD32 expire; /**< when to free it while in the cache */
+    struct xorg_list bucket; /**< entry in glamor_priv->fbo_cache */
+    struct xorg_list lru; /**< entry in glamor_priv->fbo_cache_lru */
 } glamor_pixmap_fbo;
 
 typedef struct glamor_pixmap_clipped_regions {
@@ -342,6 +377,18 @@ typedef struct glamor_pixmap_private {
     GLuint pbo;
     RegionRec prepare_region;
     Bool prepared;
+    /** area written by fb while prepared, see glamor_access_damage */
+    RegionRec dirty_region;
+    /** RW preparations not yet matched by a glamor_access_damage call */
+    int unreported_writes;
+    /**
+     * CPU copy kept between fallbacks for pixmaps which keep hitting
+     * them; shadow_region is the part of it matching the GPU contents.
+     */
+    void *shadow;
+    RegionRec shadow_region;
+    /** fallbacks since the pixmap was last drawn with GL */
+    int fallback_count;
 #ifdef GLAMOR_HAS_GBM
     EGLImageKHR image;
 #endif
@@ -546,6 +593,9 @@ void glamor_destroy_fbo(glamor_screen_private *glamor_priv,
                         glamor_pixmap_fbo *fbo);
 void glamor_pixmap_destroy_fbo(PixmapPtr pixmap);
 Bool glamor_pixmap_fbo_fixup(ScreenPtr screen, PixmapPtr pixmap);
+void glamor_init_fbo_cache(glamor_screen_private *glamor_priv);
+void glamor_fini_fbo_cache(glamor_screen_private *glamor_priv);
+void glamor_fbo_cache_expire(glamor_screen_private *glamor_priv);
 
 /* Return whether 'picture' is alpha-only */
 static inline Bool glamor_picture_is_alpha(PicturePtr picture)
@@ -593,6 +643,14 @@ void glamor_link_glsl_prog(ScreenPtr screen, GLint prog,
 void glamor_get_color_4f_from_pixel(PixmapPtr pixmap,
                                     unsigned long fg_pixel, GLfloat *color);
 
+/* glamor_program_cache.c */
+void glamor_init_program_cache(ScreenPtr screen);
+void glamor_fini_program_cache(ScreenPtr screen);
+GLuint glamor_load_program_binary(ScreenPtr screen,
+                                  const char *vs, const char *fs);
+void glamor_save_program_binary(ScreenPtr screen, GLuint prog,
+                                const char *vs, const char *fs);
+
 int glamor_set_destination_pixmap(PixmapPtr pixmap);
 int glamor_set_destination_pixmap_priv(glamor_screen_private *glamor_priv, PixmapPtr pixmap, glamor_pixmap_private *pixmap_priv);
 void glamor_set_destination_pixmap_fbo(glamor_screen_private *glamor_priv, glamor_pixmap_fbo *, int, int, int, int);
@@ -610,6 +668,7 @@ void
 glamor_track_stipple(GCPtr gc);
 
 /* glamor_render.c */
+void glamor_prewarm_composite_shaders(ScreenPtr screen);
 Bool glamor_composite_clipped_region(CARD8 op,
                                      PicturePtr source,
                                      PicturePtr mask,
@@ -756,6 +815,12 @@ void
 glamor_poly_fill_rect(DrawablePtr drawable,
                       GCPtr gc, int nrect, xRectangle *prect);
 
+void
+glamor_flush_batch(glamor_screen_private *glamor_priv);
+
+void
+glamor_fini_batch(ScreenPtr screen);
+
 /* glamor_image.c */
 void
 glamor_put_image(DrawablePtr drawable, GCPtr gc, int depth, int x, int y,
@@ -0,0 +1,317 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * @file glamor_program_cache.c
+ *
+ * On-disk cache of linked GLSL programs, using GL_ARB_get_program_binary.
+ *
+ * Each program is stored in its own file, named after the SHA1 of the
+ * GL vendor, renderer and version strings together with the vertex and
+ * fragment shader sources, so a driver update or a change to a shader
+ * simply misses the cache.
+ *
+ * The binaries are handed straight to the GL driver, so the cache is only
+ * used when $GLAMOR_PROGRAM_CACHE_DIR names a directory for it, and only
+ * if that directory and the files in it belong to the server's user and
+ * can't be written by anyone else.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "glamor_priv.h"
+#include "xsha1.h"
+
+#define GLAMOR_PROGRAM_BINARY_MAGIC "glamorPB"
+
+typedef struct {
+    char magic[8];
+    CARD32 format;
+    CARD32 length;
+} glamor_program_binary_header;
+
+/* Whether a cache file or directory is only writable by us */
+static Bool
+glamor_program_cache_trusted(const struct stat *st)
+{
+    return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static Bool
+glamor_program_cache_mkdir(const char *dir)
+{
+    struct stat st;
+
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST)
+        return FALSE;
+
+    if (stat(dir, &st) < 0)
+        return FALSE;
+    if (!S_ISDIR(st.st_mode) || !glamor_program_cache_trusted(&st)) {
+        errno = EPERM;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static char *
+glamor_program_cache_path(glamor_screen_private *glamor_priv,
+                          const char *vs, const char *fs)
+{
+    unsigned char sha1[20];
+    char name[sizeof(sha1) * 2 + 1];
+    char *path;
+    void *ctx;
+    int i;
+
+    ctx = x_sha1_init();
+    if (!ctx)
+        return NULL;
+
+    /* Include the terminators so the three strings can't run together */
+    x_sha1_update(ctx, glamor_priv->program_cache_driver,
+                  strlen(glamor_priv->program_cache_driver) + 1);
+    x_sha1_update(ctx, (void *) vs, strlen(vs) + 1);
+    x_sha1_update(ctx, (void *) fs, strlen(fs) + 1);
+    if (!x_sha1_final(ctx, sha1))
+        return NULL;
+
+    for (i = 0; i < sizeof(sha1); i++)
+        snprintf(name + i * 2, 3, "%02x", sha1[i]);
+
+    if (asprintf(&path, "%s/%s", glamor_priv->program_cache_dir, name) < 0)
+        return NULL;
+    return path;
+}
+
+/**
+ * Set up the program cache for the screen.  Requires the context to be
+ * current, and does nothing if the driver can't hand out program binaries.
+ */
+void
+glamor_init_program_cache(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    const char *env;
+    GLint formats = 0;
+    char *dir;
+
+    if (glamor_priv->gl_flavor == GLAMOR_GL_DESKTOP) {
+        if (epoxy_gl_version() < 41 &&
+            !epoxy_has_gl_extension("GL_ARB_get_program_binary"))
+            return;
+    } else {
+        if (epoxy_gl_version() < 30)
+            return;
+    }
+
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return;
+
+    /* Don't trust the environment of a setuid server */
+    if (getuid() != geteuid())
+        return;
+
+    env = getenv("GLAMOR_PROGRAM_CACHE_DIR");
+    if (!env || !*env)
+        return;
+
+    dir = strdup(env);
+    if (!dir)
+        return;
+
+    if (!glamor_program_cache_mkdir(dir)) {
+        LogMessage(X_WARNING,
+                   "glamor%d: Cannot use program cache directory %s: %s\n",
+                   screen->myNum, dir, strerror(errno));
+        free(dir);
+        return;
+    }
+
+    if (asprintf(&glamor_priv->program_cache_driver, "%s\n%s\n%s",
+                 (const char *) glGetString(GL_VENDOR),
+                 (const char *) glGetString(GL_RENDERER),
+                 (const char *) glGetString(GL_VERSION)) < 0) {
+        glamor_priv->program_cache_driver = NULL;
+        free(dir);
+        return;
+    }
+
+    glamor_priv->program_cache_dir = dir;
+    LogMessage(X_INFO, "glamor%d: Using program cache in %s\n",
+               screen->myNum, dir);
+}
+
+void
+glamor_fini_program_cache(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+
+    if (!glamor_priv->program_cache_dir)
+        return;
+
+    LogMessageVerb(X_INFO, 4,
+                   "glamor%d: Program cache: %lu hits, %lu misses\n",
+                   screen->myNum, glamor_priv->program_cache_hits,
+                   glamor_priv->program_cache_misses);
+
+    free(glamor_priv->program_cache_dir);
+    free(glamor_priv->program_cache_driver);
+    glamor_priv->program_cache_dir = NULL;
+    glamor_priv->program_cache_driver = NULL;
+}
+
+/**
+ * Look up a program built from the given shader sources.  Returns a new,
+ * linked program, or 0 if it has to be compiled from source.
+ */
+GLuint
+glamor_load_program_binary(ScreenPtr screen, const char *vs, const char *fs)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    glamor_program_binary_header header;
+    struct stat st;
+    void *binary = NULL;
+    GLuint prog = 0;
+    GLint ok;
+    char *path;
+    int fd;
+
+    if (!glamor_priv->program_cache_dir)
+        return 0;
+
+    path = glamor_program_cache_path(glamor_priv, vs, fs);
+    if (!path)
+        return 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0)
+        goto out;
+
+    /* Only trust what we wrote ourselves */
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        !glamor_program_cache_trusted(&st))
+        goto out;
+
+    if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, GLAMOR_PROGRAM_BINARY_MAGIC,
+               sizeof(header.magic)) != 0 ||
+        st.st_size != sizeof(header) + header.length)
+        goto stale;
+
+    binary = malloc(header.length);
+    if (!binary)
+        goto out;
+    if (read(fd, binary, header.length) != header.length)
+        goto stale;
+
+    glamor_make_current(glamor_priv);
+    prog = glCreateProgram();
+    glProgramBinary(prog, header.format, binary, header.length);
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (ok)
+        goto out;
+
+    /* The driver refused it, most likely after a driver update which
+     * didn't change the version string
+     */
+    glDeleteProgram(prog);
+    prog = 0;
+
+stale:
+    unlink(path);
+out:
+    if (fd >= 0)
+        close(fd);
+    free(binary);
+    free(path);
+
+    if (prog)
+        glamor_priv->program_cache_hits++;
+    else
+        glamor_priv->program_cache_misses++;
+    return prog;
+}
+
+/**
+ * Store the freshly linked @prog, built from the given shader sources,
+ * in the cache.
+ */
+void
+glamor_save_program_binary(ScreenPtr screen, GLuint prog,
+                           const char *vs, const char *fs)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    glamor_program_binary_header header;
+    GLint length = 0;
+    GLenum format;
+    void *binary;
+    char *path, *tmp;
+    Bool written;
+    int fd;
+
+    if (!glamor_priv->program_cache_dir)
+        return;
+
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    binary = malloc(length);
+    if (!binary)
+        return;
+
+    glGetProgramBinary(prog, length, &length, &format, binary);
+
+    path = glamor_program_cache_path(glamor_priv, vs, fs);
+    if (!path || asprintf(&tmp, "%s.XXXXXX", path) < 0) {
+        free(path);
+        free(binary);
+        return;
+    }
+
+    memcpy(header.magic, GLAMOR_PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.format = format;
+    header.length = length;
+
+    /* Write to a temporary file first, so that other servers sharing the
+     * cache never see a partial entry
+     */
+    fd = mkstemp(tmp);
+    if (fd >= 0) {
+        written = write(fd, &header, sizeof(header)) == sizeof(header) &&
+            write(fd, binary, length) == length;
+        close(fd);
+        if (!written || rename(tmp, path) < 0)
+            unlink(tmp);
+    }
+
+    free(tmp);
+    free(path);
+    free(binary);
+}
@@ -145,6 +145,24 @@ bail:
     return ret;
 }
 
+static void
+glamor_poly_fill_rect_damage(DrawablePtr drawable, GCPtr gc,
+                             int nrect, xRectangle *prect)
+{
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+
+    while (nrect--) {
+        x1 = min(x1, prect->x);
+        y1 = min(y1, prect->y);
+        x2 = max(x2, prect->x + prect->width);
+        y2 = max(y2, prect->y + prect->height);
+        prect++;
+    }
+    glamor_access_damage(drawable, gc,
+                         x1 + drawable->x, y1 + drawable->y,
+                         x2 + drawable->x, y2 + drawable->y);
+}
+
 static void
 glamor_poly_fill_rect_bail(DrawablePtr drawable,
                            GCPtr gc, int nrect, xRectangle *prect)
@@ -155,14 +173,153 @@ glamor_poly_fill_rect_bail(DrawablePtr drawable,
         glamor_prepare_access_gc(gc)) {
         fbPolyFillRect(drawable, gc, nrect, prect);
     }
+    glamor_poly_fill_rect_damage(drawable, gc, nrect, prect);
     glamor_finish_access_gc(gc);
     glamor_finish_access(drawable);
 }
 
+/*
+ * Clients drawing lots of small solid rectangles, one request at a time,
+ * would otherwise cost a draw call each.  Instead, solid GXcopy fills are
+ * clipped on the CPU and queued up for as long as they go to the same
+ * pixmap with the same color.  The queue is drawn by glamor_flush_batch,
+ * which glamor_make_current calls before any other GL work, so nothing
+ * can observe the pixmap before the rectangles are there.
+ */
+
+#define GLAMOR_BATCH_RECTS      4096
+#define GLAMOR_BATCH_CLIP_BOXES 16
+
+static Bool
+glamor_poly_fill_rect_batch(DrawablePtr drawable,
+                            GCPtr gc, int nrect, xRectangle *prect)
+{
+    glamor_screen_private *glamor_priv =
+        glamor_get_screen_private(drawable->pScreen);
+    glamor_batch *batch = &glamor_priv->batch;
+    PixmapPtr pixmap = glamor_get_drawable_pixmap(drawable);
+    glamor_pixmap_private *pixmap_priv = glamor_get_pixmap_private(pixmap);
+    int nclip = RegionNumRects(gc->pCompositeClip);
+    BoxPtr clip = RegionRects(gc->pCompositeClip);
+    xRectangle *r;
+    int off_x, off_y;
+    int n, c;
+
+    if (gc->fillStyle != FillSolid || gc->alu != GXcopy ||
+        !glamor_pm_is_solid(gc->depth, gc->planemask))
+        return FALSE;
+
+    if (!GLAMOR_PIXMAP_PRIV_HAS_FBO(pixmap_priv) ||
+        glamor_pixmap_priv_is_large(pixmap_priv))
+        return FALSE;
+
+    if (nclip == 0 || nclip > GLAMOR_BATCH_CLIP_BOXES ||
+        nrect > GLAMOR_BATCH_RECTS / nclip)
+        return FALSE;
+
+    if (batch->nrect && (batch->pixmap != pixmap || batch->fg != gc->fgPixel ||
+                         batch->nrect + nrect * nclip > GLAMOR_BATCH_RECTS))
+        glamor_flush_batch(glamor_priv);
+
+    if (!batch->rects) {
+        batch->rects = xallocarray(GLAMOR_BATCH_RECTS, sizeof (xRectangle));
+        if (!batch->rects)
+            return FALSE;
+    }
+
+    glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
+
+    r = batch->rects + batch->nrect;
+    for (n = 0; n < nrect; n++, prect++) {
+        int x1 = drawable->x + prect->x;
+        int y1 = drawable->y + prect->y;
+        int x2 = x1 + prect->width;
+        int y2 = y1 + prect->height;
+
+        for (c = 0; c < nclip; c++) {
+            int cx1 = max(x1, clip[c].x1);
+            int cy1 = max(y1, clip[c].y1);
+            int cx2 = min(x2, clip[c].x2);
+            int cy2 = min(y2, clip[c].y2);
+
+            if (cx1 >= cx2 || cy1 >= cy2)
+                continue;
+
+            r->x = cx1 + off_x;
+            r->y = cy1 + off_y;
+            r->width = cx2 - cx1;
+            r->height = cy2 - cy1;
+            r++;
+        }
+    }
+
+    batch->nrect = r - batch->rects;
+    batch->pixmap = pixmap;
+    batch->fg = gc->fgPixel;
+    batch->requests++;
+
+    glamor_invalidate_shadow(pixmap_priv);
+    return TRUE;
+}
+
+/**
+ * Draw the queued rectangles
+ */
+void
+glamor_flush_batch(glamor_screen_private *glamor_priv)
+{
+    glamor_batch *batch = &glamor_priv->batch;
+    PixmapPtr pixmap = batch->pixmap;
+    int nrect = batch->nrect;
+    ChangeGCVal val;
+    GCPtr gc;
+
+    if (!nrect)
+        return;
+
+    /* Reset first, drawing goes through glamor_make_current again */
+    batch->nrect = 0;
+    batch->pixmap = NULL;
+
+    gc = GetScratchGC(pixmap->drawable.depth, pixmap->drawable.pScreen);
+    if (!gc)
+        return;
+
+    val.val = batch->fg;
+    ChangeGC(NullClient, gc, GCForeground, &val);
+    ValidateGC(&pixmap->drawable, gc);
+
+    if (!glamor_poly_fill_rect_gl(&pixmap->drawable, gc, nrect, batch->rects))
+        glamor_poly_fill_rect_bail(&pixmap->drawable, gc, nrect, batch->rects);
+
+    FreeScratchGC(gc);
+    batch->draws++;
+}
+
+void
+glamor_fini_batch(ScreenPtr screen)
+{
+    glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    glamor_batch *batch = &glamor_priv->batch;
+
+    glamor_flush_batch(glamor_priv);
+
+    if (batch->requests)
+        LogMessageVerb(X_INFO, 4,
+                       "glamor%d: %lu PolyFillRect requests drawn with "
+                       "%lu draw calls\n", screen->myNum,
+                       batch->requests, batch->draws);
+
+    free(batch->rects);
+    batch->rects = NULL;
+}
+
 void
 glamor_poly_fill_rect(DrawablePtr drawable,
                       GCPtr gc, int nrect, xRectangle *prect)
 {
+    if (glamor_poly_fill_rect_batch(drawable, gc, nrect, prect))
+        return;
     if (glamor_poly_fill_rect_gl(drawable, gc, nrect, prect))
         return;
     glamor_poly_fill_rect_bail(drawable, gc, nrect, prect);
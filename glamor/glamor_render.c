@@ -60,8 +60,8 @@ static struct blendinfo composite_op_info[] = {
 };
 
 #define RepeatFix			10
-static GLuint
-glamor_create_composite_fs(struct shader_key *key)
+static char *
+glamor_composite_fs_source(struct shader_key *key)
 {
     const char *repeat_define =
         "#define RepeatNone               	      0\n"
@@ -231,7 +231,6 @@ glamor_create_composite_fs(struct shader_key *key)
     const char *header;
     const char *header_norm = "";
     const char *dest_swizzle;
-    GLuint prog;
 
     switch (key->source) {
     case SHADER_SOURCE_SOLID:
@@ -304,14 +303,11 @@ glamor_create_composite_fs(struct shader_key *key)
                 "%s%s%s%s%s%s%s", header, repeat_define, relocate_texture,
                 rel_sampler, source_fetch, mask_fetch, dest_swizzle, in);
 
-    prog = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, source);
-    free(source);
-
-    return prog;
+    return source;
 }
 
-static GLuint
-glamor_create_composite_vs(struct shader_key *key)
+static char *
+glamor_composite_vs_source(struct shader_key *key)
 {
     const char *main_opening =
         "attribute vec4 v_position;\n"
@@ -328,7 +324,6 @@ glamor_create_composite_vs(struct shader_key *key)
     const char *source_coords_setup = "";
     const char *mask_coords_setup = "";
     char *source;
-    GLuint prog;
 
     if (key->source != SHADER_SOURCE_SOLID)
         source_coords_setup = source_coords;
@@ -341,10 +336,7 @@ glamor_create_composite_vs(struct shader_key *key)
                 main_opening,
                 source_coords_setup, mask_coords_setup, main_closing);
 
-    prog = glamor_compile_glsl_prog(GL_VERTEX_SHADER, source);
-    free(source);
-
-    return prog;
+    return source;
 }
 
 static void
@@ -354,28 +346,34 @@ glamor_create_composite_shader(ScreenPtr screen, struct shader_key *key,
     GLuint vs, fs, prog;
     GLint source_sampler_uniform_location, mask_sampler_uniform_location;
     glamor_screen_private *glamor_priv = glamor_get_screen_private(screen);
+    char *vs_source, *fs_source;
 
     glamor_make_current(glamor_priv);
-    vs = glamor_create_composite_vs(key);
-    if (vs == 0)
-        return;
-    fs = glamor_create_composite_fs(key);
-    if (fs == 0)
-        return;
+    vs_source = glamor_composite_vs_source(key);
+    fs_source = glamor_composite_fs_source(key);
+
+    prog = glamor_load_program_binary(screen, vs_source, fs_source);
+    if (!prog) {
+        vs = glamor_compile_glsl_prog(GL_VERTEX_SHADER, vs_source);
+        fs = glamor_compile_glsl_prog(GL_FRAGMENT_SHADER, fs_source);
 
-    prog = glCreateProgram();
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
+        prog = glCreateProgram();
+        glAttachShader(prog, vs);
+        glAttachShader(prog, fs);
 
-    glBindAttribLocation(prog, GLAMOR_VERTEX_POS, "v_position");
-    glBindAttribLocation(prog, GLAMOR_VERTEX_SOURCE, "v_texcoord0");
-    glBindAttribLocation(prog, GLAMOR_VERTEX_MASK, "v_texcoord1");
+        glBindAttribLocation(prog, GLAMOR_VERTEX_POS, "v_position");
+        glBindAttribLocation(prog, GLAMOR_VERTEX_SOURCE, "v_texcoord0");
+        glBindAttribLocation(prog, GLAMOR_VERTEX_MASK, "v_texcoord1");
 
-    if (key->in == glamor_program_alpha_dual_blend) {
-        glBindFragDataLocationIndexed(prog, 0, 0, "color0");
-        glBindFragDataLocationIndexed(prog, 0, 1, "color1");
+        if (key->in == glamor_program_alpha_dual_blend) {
+            glBindFragDataLocationIndexed(prog, 0, 0, "color0");
+            glBindFragDataLocationIndexed(prog, 0, 1, "color1");
+        }
+        glamor_link_glsl_prog(screen, prog, "composite");
+        glamor_save_program_binary(screen, prog, vs_source, fs_source);
     }
-    glamor_link_glsl_prog(screen, prog, "composite");
+    free(vs_source);
+    free(fs_source);
 
     shader->prog = prog;
 
@@ -423,6 +421,32 @@ glamor_lookup_composite_shader(ScreenPtr screen, struct
     return shader;
 }
 
+/**
+ * Create the composite shaders for the most common operations at
+ * startup, which is cheap when they come from the program cache.
+ */
+void
+glamor_prewarm_composite_shaders(ScreenPtr screen)
+{
+    static const struct shader_key keys[] = {
+        { SHADER_SOURCE_SOLID, SHADER_MASK_NONE },
+        { SHADER_SOURCE_TEXTURE, SHADER_MASK_NONE },
+        { SHADER_SOURCE_TEXTURE_ALPHA, SHADER_MASK_NONE },
+        { SHADER_SOURCE_SOLID, SHADER_MASK_TEXTURE_ALPHA },
+        { SHADER_SOURCE_TEXTURE, SHADER_MASK_TEXTURE_ALPHA },
+        { SHADER_SOURCE_TEXTURE, SHADER_MASK_TEXTURE },
+    };
+    struct shader_key key;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(keys); i++) {
+        key = keys[i];
+        key.in = glamor_program_alpha_normal;
+        key.dest_swizzle = SHADER_DEST_SWIZZLE_DEFAULT;
+        glamor_lookup_composite_shader(screen, &key);
+    }
+}
+
 static GLenum
 glamor_translate_blend_alpha_to_red(GLenum blend)
 {
@@ -141,6 +141,25 @@ glamor_poly_segment_gl(DrawablePtr drawable, GCPtr gc,
     }
 }
 
+/* Zero-width segments only, which stay within their end points */
+static void
+glamor_poly_segment_damage(DrawablePtr drawable, GCPtr gc,
+                           int nseg, xSegment *segs)
+{
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+
+    while (nseg--) {
+        x1 = min(x1, min(segs->x1, segs->x2));
+        y1 = min(y1, min(segs->y1, segs->y2));
+        x2 = max(x2, max(segs->x1, segs->x2) + 1);
+        y2 = max(y2, max(segs->y1, segs->y2) + 1);
+        segs++;
+    }
+    glamor_access_damage(drawable, gc,
+                         x1 + drawable->x, y1 + drawable->y,
+                         x2 + drawable->x, y2 + drawable->y);
+}
+
 static void
 glamor_poly_segment_bail(DrawablePtr drawable, GCPtr gc,
                          int nseg, xSegment *segs)
@@ -153,6 +172,7 @@ glamor_poly_segment_bail(DrawablePtr drawable, GCPtr gc,
             glamor_prepare_access_gc(gc)) {
             fbPolySegment(drawable, gc, nseg, segs);
         }
+        glamor_poly_segment_damage(drawable, gc, nseg, segs);
         glamor_finish_access_gc(gc);
         glamor_finish_access(drawable);
     } else
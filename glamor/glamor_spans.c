@@ -153,6 +153,27 @@ bail:
     return ret;
 }
 
+/*
+ * Tell glamor_finish_access which part of the drawable the fb fallback
+ * may have written, so only that needs to go back to the GPU
+ */
+static void
+glamor_spans_damage(DrawablePtr drawable, GCPtr gc,
+                    int n, DDXPointPtr points, int *widths)
+{
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+
+    while (n--) {
+        x1 = min(x1, points->x);
+        y1 = min(y1, points->y);
+        x2 = max(x2, points->x + *widths);
+        y2 = max(y2, points->y + 1);
+        points++;
+        widths++;
+    }
+    glamor_access_damage(drawable, gc, x1, y1, x2, y2);
+}
+
 static void
 glamor_fill_spans_bail(DrawablePtr drawable,
                        GCPtr gc,
@@ -162,6 +183,7 @@ glamor_fill_spans_bail(DrawablePtr drawable,
         glamor_prepare_access_gc(gc)) {
         fbFillSpans(drawable, gc, n, points, widths, sorted);
     }
+    glamor_spans_damage(drawable, gc, n, points, widths);
     glamor_finish_access_gc(gc);
     glamor_finish_access(drawable);
 }
@@ -290,6 +312,7 @@ glamor_set_spans_gl(DrawablePtr drawable, GCPtr gc, char *src,
     glamor_format_for_pixmap(pixmap, &format, &type);
 
     glamor_make_current(glamor_priv);
+    glamor_invalidate_shadow(pixmap_priv);
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
@@ -367,6 +390,7 @@ glamor_set_spans_bail(DrawablePtr drawable, GCPtr gc, char *src,
 {
     if (glamor_prepare_access(drawable, GLAMOR_ACCESS_RW) && glamor_prepare_access_gc(gc))
         fbSetSpans(drawable, gc, src, points, widths, numPoints, sorted);
+    glamor_spans_damage(drawable, gc, numPoints, points, widths);
     glamor_finish_access_gc(gc);
     glamor_finish_access(drawable);
 }
@@ -72,6 +72,10 @@ glamor_upload_boxes(PixmapPtr pixmap, BoxPtr in_boxes, int in_nbox,
 
     glamor_make_current(glamor_priv);
 
+    /* glamor_fini_pixmap uploads from the shadow itself */
+    if (!priv->prepared)
+        glamor_invalidate_shadow(priv);
+
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
     if (glamor_priv->has_unpack_subimage)
@@ -59,6 +59,8 @@ glamor_set_destination_drawable(DrawablePtr     drawable,
     if (!pixmap_fbo)
         return FALSE;
 
+    glamor_invalidate_shadow(pixmap_priv);
+
     glamor_get_drawable_deltas(drawable, pixmap, &off_x, &off_y);
 
     off_x -= box->x1;
@@ -50,6 +50,10 @@ glamor_solid_boxes(PixmapPtr pixmap,
         ValidateGC(drawable, gc);
         gc->ops->PolyFillRect(drawable, gc, nbox, rect);
         FreeScratchGC(gc);
+        /* Callers go on to set up their own GL state, which a later
+         * flush of the batched rectangles would clobber
+         */
+        glamor_flush_batch(glamor_get_screen_private(drawable->pScreen));
     }
     free(rect);
 }
@@ -75,5 +79,6 @@ glamor_solid(PixmapPtr pixmap, int x, int y, int width, int height,
     rect.height = height;
     gc->ops->PolyFillRect(drawable, gc, 1, &rect);
     FreeScratchGC(gc);
+    glamor_flush_batch(glamor_get_screen_private(drawable->pScreen));
 }
 
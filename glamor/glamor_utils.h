@@ -727,6 +727,10 @@ glamor_make_current(glamor_screen_private *glamor_priv)
         lastGLContext = &glamor_priv->ctx;
         glamor_priv->ctx.make_current(&glamor_priv->ctx);
     }
+
+    /* Anything else done with GL has to come after the queued rectangles */
+    if (glamor_priv->batch.nrect)
+        glamor_flush_batch(glamor_priv);
 }
 
 /**
@@ -297,7 +297,7 @@ ephyrShadowUpdate(ScreenPtr pScreen, shadowBufPtr pBuf)
      * much faster efficiently updating via tranforming
      * pBuf->pDamage  regions
      */
-    shadowUpdateRotatePacked(pScreen, pBuf);
+    shadowUpdateTiled(pScreen, pBuf);
     hostx_paint_rect(screen, 0, 0, 0, 0, screen->width, screen->height);
 }
 
@@ -534,6 +534,7 @@ ephyrRandRSetConfig(ScreenPtr pScreen,
         if (!KdShadowSet(screen->pScreen,
                          scrpriv->randr, ephyrShadowUpdate, ephyrWindowLinear))
             goto bail4;
+        shadowSetThreads(screen->pScreen, 0);
     }
     else {
 #ifdef GLAMOR
@@ -719,10 +720,14 @@ ephyrCreateResources(ScreenPtr pScreen)
     EPHYR_LOG("mark pScreen=%p mynum=%d shadow=%d",
               pScreen, pScreen->myNum, scrpriv->shadow);
 
-    if (scrpriv->shadow)
-        return KdShadowSet(pScreen,
-                           scrpriv->randr,
-                           ephyrShadowUpdate, ephyrWindowLinear);
+    if (scrpriv->shadow) {
+        if (!KdShadowSet(pScreen,
+                         scrpriv->randr,
+                         ephyrShadowUpdate, ephyrWindowLinear))
+            return FALSE;
+        shadowSetThreads(pScreen, 0);
+        return TRUE;
+    }
     else {
 #ifdef GLAMOR
         if (ephyr_glamor) {
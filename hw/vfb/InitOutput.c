@@ -52,9 +52,16 @@ from The Open Group.
 #ifndef MAP_FILE
 #define MAP_FILE 0
 #endif
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
 #endif                          /* HAVE_MMAP */
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #ifndef WIN32
 #include <sys/param.h>
 #endif
@@ -67,6 +74,7 @@ from The Open Group.
 #include "miline.h"
 #include "glx_extinit.h"
 #include "randrstr.h"
+#include "vfbexport.h"
 
 #define VFB_DEFAULT_WIDTH      1280
 #define VFB_DEFAULT_HEIGHT     1024
@@ -81,9 +89,12 @@ typedef struct {
     int paddedBytesWidth;
     int paddedWidth;
     int height;
+    int maxWidth;
+    int maxHeight;
     int depth;
     int bitsPerPixel;
     int sizeInBytes;
+    int mapSize;
     int ncolors;
     char *pfbMemory;
     XWDColor *pXWDCmap;
@@ -101,6 +112,10 @@ typedef struct {
 #ifdef HAS_SHM
     int shmid;
 #endif
+
+#ifdef VFB_EXPORT
+    int memfd;
+#endif
 } vfbScreenInfo, *vfbScreenInfoPtr;
 
 static int vfbNumScreens;
@@ -120,7 +135,12 @@ static Bool vfbPixmapDepths[33];
 #ifdef HAVE_MMAP
 static char *pfbdir = NULL;
 #endif
-typedef enum { NORMAL_MEMORY_FB, SHARED_MEMORY_FB, MMAPPED_FILE_FB } fbMemType;
+#ifdef VFB_EXPORT
+static char *pfbexport = NULL;
+static Bool fbexportWritable = FALSE;
+#endif
+typedef enum { NORMAL_MEMORY_FB, SHARED_MEMORY_FB, MMAPPED_FILE_FB,
+    MEMFD_FB } fbMemType;
 static fbMemType fbmemtype = NORMAL_MEMORY_FB;
 static char needswap = 0;
 static Bool Render = TRUE;
@@ -193,9 +213,23 @@ ddxGiveUp(enum ExitCode error)
         break;
 #endif                          /* HAS_SHM */
 
+#ifdef VFB_EXPORT
+    case MEMFD_FB:
+        vfbExportFini();
+        break;
+#else                           /* VFB_EXPORT */
+    case MEMFD_FB:
+        break;
+#endif                          /* VFB_EXPORT */
+
     case NORMAL_MEMORY_FB:
         for (i = 0; i < vfbNumScreens; i++) {
+#ifdef HAVE_MMAP
+            if (vfbScreens[i].pXWDHeader)
+                munmap(vfbScreens[i].pXWDHeader, vfbScreens[i].mapSize);
+#else
             free(vfbScreens[i].pXWDHeader);
+#endif
         }
         break;
     }
@@ -236,6 +270,7 @@ void
 ddxUseMsg(void)
 {
     ErrorF("-screen scrn WxHxD     set screen's width, height, depth\n");
+    ErrorF("-maxsize WxH           set screen's maximum size for RandR\n");
     ErrorF("-pixdepths list-of-int support given pixmap depths\n");
     ErrorF("+/-render		   turn on/off RENDER extension support"
            "(default on)\n");
@@ -251,6 +286,13 @@ ddxUseMsg(void)
 #ifdef HAS_SHM
     ErrorF("-shmem                 put framebuffers in shared memory\n");
 #endif
+
+#ifdef VFB_EXPORT
+    ErrorF("-fbexport socket       export framebuffers and damage to "
+           "consumers of socket\n");
+    ErrorF("-fbexportrw            let export consumers write to the "
+           "framebuffers\n");
+#endif
 }
 
 int
@@ -314,6 +356,22 @@ ddxProcessArgument(int argc, char *argv[], int i)
         return 3;
     }
 
+    if (strcmp(argv[i], "-maxsize") == 0) {     /* -maxsize WxH */
+        CHECK_FOR_REQUIRED_ARGUMENTS(1);
+        if (2 != sscanf(argv[i + 1], "%dx%d",
+                        &currentScreen->maxWidth,
+                        &currentScreen->maxHeight) ||
+            currentScreen->maxWidth <= 0 || currentScreen->maxHeight <= 0 ||
+            currentScreen->maxWidth > 32767 ||
+            currentScreen->maxHeight > 32767) {
+            ErrorF("Invalid maximum screen size %s\n", argv[i + 1]);
+            UseMsg();
+            FatalError("Invalid maximum screen size %s passed to -maxsize\n",
+                       argv[i + 1]);
+        }
+        return 2;
+    }
+
     if (strcmp(argv[i], "-pixdepths") == 0) {   /* -pixdepths list-of-depth */
         int depth, ret = 1;
 
@@ -378,6 +436,20 @@ ddxProcessArgument(int argc, char *argv[], int i)
     }
 #endif
 
+#ifdef VFB_EXPORT
+    if (strcmp(argv[i], "-fbexport") == 0) {    /* -fbexport socket */
+        CHECK_FOR_REQUIRED_ARGUMENTS(1);
+        pfbexport = argv[++i];
+        fbmemtype = MEMFD_FB;
+        return 2;
+    }
+
+    if (strcmp(argv[i], "-fbexportrw") == 0) {  /* -fbexportrw */
+        fbexportWritable = TRUE;
+        return 1;
+    }
+#endif
+
     return 0;
 }
 
@@ -528,7 +600,10 @@ vfbAllocateMmappedFramebuffer(vfbScreenInfoPtr pvfb)
 
     /* try to mmap the file */
 
-    pvfb->pXWDHeader = (XWDFileHeader *) mmap((caddr_t) NULL, pvfb->sizeInBytes,
+    /* Map enough for the largest size the screen can be resized to; the
+     * file only grows as far as needed
+     */
+    pvfb->pXWDHeader = (XWDFileHeader *) mmap((caddr_t) NULL, pvfb->mapSize,
                                               PROT_READ | PROT_WRITE,
                                               MAP_FILE | MAP_SHARED,
                                               pvfb->mmap_fd, 0);
@@ -550,12 +625,13 @@ vfbAllocateMmappedFramebuffer(vfbScreenInfoPtr pvfb)
 static void
 vfbAllocateSharedMemoryFramebuffer(vfbScreenInfoPtr pvfb)
 {
-    /* create the shared memory segment */
+    /* create the shared memory segment, at the largest size the screen
+     * can be resized to; its pages are only allocated once touched */
 
-    pvfb->shmid = shmget(IPC_PRIVATE, pvfb->sizeInBytes, IPC_CREAT | 0777);
+    pvfb->shmid = shmget(IPC_PRIVATE, pvfb->mapSize, IPC_CREAT | 0777);
     if (pvfb->shmid < 0) {
         perror("shmget");
-        ErrorF("shmget %d bytes failed, %s", pvfb->sizeInBytes,
+        ErrorF("shmget %d bytes failed, %s", pvfb->mapSize,
                strerror(errno));
         return;
     }
@@ -574,6 +650,40 @@ vfbAllocateSharedMemoryFramebuffer(vfbScreenInfoPtr pvfb)
 }
 #endif                          /* HAS_SHM */
 
+#ifdef VFB_EXPORT
+static void
+vfbAllocateMemfdFramebuffer(vfbScreenInfoPtr pvfb)
+{
+    pvfb->memfd = memfd_create("Xvfb", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (pvfb->memfd < 0) {
+        perror("memfd_create");
+        ErrorF("memfd_create failed, %s", strerror(errno));
+        return;
+    }
+
+    /* The memfd always has its maximum size, so that consumers never
+     * need to map it again; the pages past the screen are holes
+     */
+    if (-1 == ftruncate(pvfb->memfd, pvfb->mapSize)) {
+        perror("ftruncate");
+        ErrorF("ftruncate %d bytes failed, %s", pvfb->mapSize,
+               strerror(errno));
+        close(pvfb->memfd);
+        return;
+    }
+
+    pvfb->pXWDHeader = (XWDFileHeader *) mmap(NULL, pvfb->mapSize,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_SHARED, pvfb->memfd, 0);
+    if (MAP_FAILED == (void *) pvfb->pXWDHeader) {
+        perror("mmap");
+        ErrorF("mmap memfd failed, %s", strerror(errno));
+        pvfb->pXWDHeader = NULL;
+        close(pvfb->memfd);
+    }
+}
+#endif                          /* VFB_EXPORT */
+
 static char *
 vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
 {
@@ -581,6 +691,7 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
         return pvfb->pfbMemory; /* already done */
 
     pvfb->sizeInBytes = pvfb->paddedBytesWidth * pvfb->height;
+    pvfb->mapSize = pvfb->paddedBytesWidth * pvfb->maxHeight;
 
     /* Calculate how many entries in colormap.  This is rather bogus, because
      * the visuals haven't even been set up yet, but we need to know because we
@@ -603,6 +714,8 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
 
     pvfb->sizeInBytes += SIZEOF(XWDheader) + XWD_WINDOW_NAME_LEN +
         pvfb->ncolors * SIZEOF(XWDColor);
+    pvfb->mapSize += SIZEOF(XWDheader) + XWD_WINDOW_NAME_LEN +
+        pvfb->ncolors * SIZEOF(XWDColor);
 
     pvfb->pXWDHeader = NULL;
     switch (fbmemtype) {
@@ -624,8 +737,27 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
         break;
 #endif
 
+#ifdef VFB_EXPORT
+    case MEMFD_FB:
+        vfbAllocateMemfdFramebuffer(pvfb);
+        break;
+#else
+    case MEMFD_FB:
+        break;
+#endif
+
     case NORMAL_MEMORY_FB:
-        pvfb->pXWDHeader = (XWDFileHeader *) malloc(pvfb->sizeInBytes);
+#ifdef HAVE_MMAP
+        /* Reserve the maximum size, memory is only used once touched */
+        pvfb->pXWDHeader = (XWDFileHeader *) mmap(NULL, pvfb->mapSize,
+                                                  PROT_READ | PROT_WRITE,
+                                                  MAP_PRIVATE | MAP_ANONYMOUS |
+                                                  MAP_NORESERVE, -1, 0);
+        if (MAP_FAILED == (void *) pvfb->pXWDHeader)
+            pvfb->pXWDHeader = NULL;
+#else
+        pvfb->pXWDHeader = (XWDFileHeader *) malloc(pvfb->mapSize);
+#endif
         break;
     }
 
@@ -641,6 +773,80 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
         return NULL;
 }
 
+/*
+ * Make room in the frame buffer of @pvfb for @height rows, and give back
+ * the memory of the rows past them where possible.  The frame buffer is
+ * always mapped, and laid out, for the maximum size of the screen, so
+ * nothing ever moves.
+ */
+static Bool
+vfbResizeFramebufferMemory(vfbScreenInfoPtr pvfb, int height)
+{
+    int size = pvfb->mapSize - pvfb->paddedBytesWidth * (pvfb->maxHeight -
+                                                         height);
+#ifdef HAVE_MMAP
+    long pagesize = sysconf(_SC_PAGESIZE);
+    int start = (size + pagesize - 1) & ~(pagesize - 1);
+    int end = (pvfb->sizeInBytes + pagesize - 1) & ~(pagesize - 1);
+#endif
+
+    switch (fbmemtype) {
+#ifdef HAVE_MMAP
+    case MMAPPED_FILE_FB:
+        /* Keep the file a complete xwd image of the screen */
+        if (-1 == ftruncate(pvfb->mmap_fd, size)) {
+            ErrorF("ftruncate %s failed, %s", pvfb->mmap_file,
+                   strerror(errno));
+            return FALSE;
+        }
+        break;
+    case NORMAL_MEMORY_FB:
+        if (end > start)
+            madvise((char *) pvfb->pXWDHeader + start, end - start,
+                    MADV_DONTNEED);
+        break;
+#else
+    case MMAPPED_FILE_FB:
+    case NORMAL_MEMORY_FB:
+        break;
+#endif
+
+#ifdef VFB_EXPORT
+    case MEMFD_FB:
+        /* Punch a hole rather than truncate, consumers may still be
+         * reading past the new end
+         */
+        if (end > start)
+            fallocate(pvfb->memfd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      start, end - start);
+        break;
+#else
+    case MEMFD_FB:
+        break;
+#endif
+
+    case SHARED_MEMORY_FB:
+        /* The segment can't change size, nor be handed back in part */
+        break;
+    }
+
+    pvfb->sizeInBytes = size;
+    return TRUE;
+}
+
+static void
+vfbWriteXWDFileHeaderSize(vfbScreenInfoPtr pvfb, int width, int height)
+{
+    XWDFileHeader *pXWDHeader = pvfb->pXWDHeader;
+
+    swapcopy32(pXWDHeader->pixmap_height, height);
+    swapcopy32(pXWDHeader->window_height, height);
+#ifndef INTERNAL_VS_EXTERNAL_PADDING
+    swapcopy32(pXWDHeader->pixmap_width, width);
+    swapcopy32(pXWDHeader->window_width, width);
+#endif
+}
+
 static void
 vfbWriteXWDFileHeader(ScreenPtr pScreen)
 {
@@ -729,6 +935,11 @@ vfbCloseScreen(ScreenPtr pScreen)
 
     pScreen->CloseScreen = pvfb->closeScreen;
 
+#ifdef VFB_EXPORT
+    if (fbmemtype == MEMFD_FB)
+        vfbExportCloseScreen(pScreen);
+#endif
+
     /*
      * fb overwrites miCloseScreen, so do this here
      */
@@ -762,9 +973,23 @@ vfbRRScreenSetSize(ScreenPtr  pScreen,
                    CARD32     mmWidth,
                    CARD32     mmHeight)
 {
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    PixmapPtr pPixmap = pScreen->GetScreenPixmap(pScreen);
+
+    if (width > pvfb->maxWidth || height > pvfb->maxHeight)
+        return FALSE;
+
     // Prevent screen updates while we change things around
     SetRootClip(pScreen, ROOT_CLIP_NONE);
 
+    // The stride stays that of the maximum width, so no pixel moves
+    if (!vfbResizeFramebufferMemory(pvfb, height)) {
+        SetRootClip(pScreen, ROOT_CLIP_FULL);
+        return FALSE;
+    }
+    vfbWriteXWDFileHeaderSize(pvfb, width, height);
+    pScreen->ModifyPixmapHeader(pPixmap, width, height, -1, -1, -1, NULL);
+
     pScreen->width = width;
     pScreen->height = height;
     pScreen->mmWidth = mmWidth;
@@ -773,6 +998,11 @@ vfbRRScreenSetSize(ScreenPtr  pScreen,
     // Restore the ability to update screen, now with new dimensions
     SetRootClip(pScreen, ROOT_CLIP_FULL);
 
+#ifdef VFB_EXPORT
+    if (fbmemtype == MEMFD_FB)
+        vfbExportScreenResize(pScreen);
+#endif
+
     RRScreenSizeNotify (pScreen);
     RRTellChanged(pScreen);
 
@@ -826,7 +1056,8 @@ vfbRandRInit(ScreenPtr pScreen)
 
     RRScreenSetSizeRange (pScreen,
                          1, 1,
-                         pScreen->width, pScreen->height);
+                         vfbScreens[pScreen->myNum].maxWidth,
+                         vfbScreens[pScreen->myNum].maxHeight);
 
     sprintf (name, "%dx%d", pScreen->width, pScreen->height);
     memset (&modeInfo, '\0', sizeof (modeInfo));
@@ -872,7 +1103,18 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (dpiy == 0)
         dpiy = 100;
 
-    pvfb->paddedBytesWidth = PixmapBytePad(pvfb->width, pvfb->depth);
+    /* Lay the frame buffer out for the maximum size right away, so that
+     * resizing never has to move its contents
+     */
+    pvfb->maxWidth = max(pvfb->maxWidth, pvfb->width);
+    pvfb->maxHeight = max(pvfb->maxHeight, pvfb->height);
+
+    pvfb->paddedBytesWidth = PixmapBytePad(pvfb->maxWidth, pvfb->depth);
+    if (pvfb->maxHeight > (INT_MAX / 2) / pvfb->paddedBytesWidth) {
+        ErrorF("Maximum screen size %dx%d is too large\n",
+               pvfb->maxWidth, pvfb->maxHeight);
+        return FALSE;
+    }
     pvfb->bitsPerPixel = vfbBitsPerPixel(pvfb->depth);
     if (pvfb->bitsPerPixel >= 8)
         pvfb->paddedWidth = pvfb->paddedBytesWidth / (pvfb->bitsPerPixel / 8);
@@ -882,6 +1124,10 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (!pbits)
         return FALSE;
 
+    /* A previous server generation may have left it at another size */
+    if (!vfbResizeFramebufferMemory(pvfb, pvfb->height))
+        return FALSE;
+
     switch (pvfb->depth) {
     case 8:
         miSetVisualTypesAndMasks(8,
@@ -934,6 +1180,13 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (!vfbRandRInit(pScreen))
        return FALSE;
 
+#ifdef VFB_EXPORT
+    if (fbmemtype == MEMFD_FB &&
+        !vfbExportScreenInit(pScreen, pvfb->memfd, pvfb->pXWDHeader,
+                             pvfb->mapSize))
+        return FALSE;
+#endif
+
     pScreen->InstallColormap = vfbInstallColormap;
 
     pScreen->SaveScreen = vfbSaveScreen;
@@ -978,6 +1231,12 @@ InitOutput(ScreenInfo * screen_info, int argc, char **argv)
     if (serverGeneration == 1)
         vfbExtensionInit();
 
+#ifdef VFB_EXPORT
+    if (serverGeneration == 1 && fbmemtype == MEMFD_FB &&
+        !vfbExportInit(pfbexport, fbexportWritable))
+        FatalError("Couldn't export the frame buffers on %s\n", pfbexport);
+#endif
+
     /* initialize pixmap formats */
 
     /* must have a pixmap depth to match every screen depth */
@@ -0,0 +1,585 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Export of the Xvfb frame buffers to other processes.
+ *
+ * Each screen lives in a memfd, which is handed to the consumers connecting
+ * to the export socket, together with the damage of the screen pixmap.  A
+ * consumer thus only ever reads the pixels which changed, without talking
+ * X.  See vfbexport.h for the protocol.
+ *
+ * As this bypasses X authorization, the socket is only accessible to the
+ * server's user, consumers running as anyone else are turned away, and
+ * they get a read-only descriptor unless writing was asked for.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include "vfbexport.h"
+
+#ifdef VFB_EXPORT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "os.h"
+#include "dix.h"
+#include "list.h"
+#include "pixmapstr.h"
+#include "damage.h"
+
+typedef struct {
+    int fd;                     /* handed to consumers */
+    Bool own_fd;                /* a read-only descriptor of our own */
+    char *base;
+    CARD32 size;
+    DamagePtr pDamage;
+    CreateScreenResourcesProcPtr CreateScreenResources;
+} vfbExportScreenRec, *vfbExportScreenPtr;
+
+typedef struct {
+    struct xorg_list link;
+    int fd;
+    Bool blocked;               /* waiting for the socket to drain */
+    CARD32 changed;             /* screens to send again */
+    RegionRec pending[MAXSCREENS];
+} vfbExportClientRec, *vfbExportClientPtr;
+
+static int vfbExportListenFd = -1;
+static char *vfbExportPath;
+static Bool vfbExportWritable;
+static unsigned long vfbExportGeneration;
+static vfbExportScreenRec vfbExportScreens[MAXSCREENS];
+static struct xorg_list vfbExportClients;
+
+static void vfbExportClientNotify(int fd, int ready, void *data);
+
+static void
+vfbExportClientDestroy(vfbExportClientPtr client)
+{
+    int i;
+
+    RemoveNotifyFd(client->fd);
+    close(client->fd);
+    xorg_list_del(&client->link);
+    for (i = 0; i < MAXSCREENS; i++)
+        RegionUninit(&client->pending[i]);
+    free(client);
+}
+
+/* Tell @client where to find @pScreen */
+static ssize_t
+vfbExportSendScreen(vfbExportClientPtr client, ScreenPtr pScreen)
+{
+    vfbExportScreenPtr pes = &vfbExportScreens[pScreen->myNum];
+    PixmapPtr pPixmap = pScreen->GetScreenPixmap(pScreen);
+    XvfbExportScreenRec msg;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov;
+    struct msghdr hdr;
+    struct cmsghdr *cmsg;
+
+    msg.type = XVFB_EXPORT_SCREEN;
+    msg.screen = pScreen->myNum;
+    msg.size = pes->size;
+    msg.offset = (char *) pPixmap->devPrivate.ptr - pes->base;
+    msg.width = pPixmap->drawable.width;
+    msg.height = pPixmap->drawable.height;
+    msg.stride = pPixmap->devKind;
+    msg.bitsPerPixel = pPixmap->drawable.bitsPerPixel;
+    msg.depth = pPixmap->drawable.depth;
+
+    iov.iov_base = &msg;
+    iov.iov_len = sizeof(msg);
+
+    memset(&hdr, 0, sizeof(hdr));
+    memset(control, 0, sizeof(control));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &pes->fd, sizeof(int));
+
+    return sendmsg(client->fd, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/* Start collecting damage for @client until its socket drains */
+static void
+vfbExportBlock(vfbExportClientPtr client)
+{
+    if (!client->blocked) {
+        client->blocked = TRUE;
+        SetNotifyFd(client->fd, vfbExportClientNotify,
+                    X_NOTIFY_READ | X_NOTIFY_WRITE, client);
+    }
+}
+
+#define vfbExportWouldBlock() \
+    (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+
+/* Send the screens which changed and the damage of each screen to
+ * @client, as far as the socket takes it.  Returns FALSE if the consumer
+ * is gone.
+ */
+static Bool
+vfbExportFlush(vfbExportClientPtr client)
+{
+    struct {
+        XvfbExportDamageRec header;
+        XvfbExportBoxRec boxes[XVFB_EXPORT_MAX_BOXES];
+    } msg;
+    int i, j;
+
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        RegionPtr pending = &client->pending[i];
+        BoxPtr boxes;
+        int nbox;
+
+        if (client->changed & (1 << i)) {
+            if (vfbExportSendScreen(client, screenInfo.screens[i]) < 0) {
+                if (!vfbExportWouldBlock())
+                    return FALSE;
+                vfbExportBlock(client);
+                return TRUE;
+            }
+            client->changed &= ~(1 << i);
+        }
+
+        if (!RegionNotEmpty(pending))
+            continue;
+
+        nbox = RegionNumRects(pending);
+        boxes = RegionRects(pending);
+        if (nbox > XVFB_EXPORT_MAX_BOXES) {
+            nbox = 1;
+            boxes = RegionExtents(pending);
+        }
+
+        msg.header.type = XVFB_EXPORT_DAMAGE;
+        msg.header.screen = i;
+        msg.header.nbox = nbox;
+        for (j = 0; j < nbox; j++) {
+            msg.boxes[j].x1 = boxes[j].x1;
+            msg.boxes[j].y1 = boxes[j].y1;
+            msg.boxes[j].x2 = boxes[j].x2;
+            msg.boxes[j].y2 = boxes[j].y2;
+        }
+
+        if (send(client->fd, &msg,
+                 sizeof(msg.header) + nbox * sizeof(msg.boxes[0]),
+                 MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            if (!vfbExportWouldBlock())
+                return FALSE;
+            vfbExportBlock(client);
+            return TRUE;
+        }
+
+        RegionEmpty(pending);
+    }
+
+    if (client->blocked) {
+        client->blocked = FALSE;
+        SetNotifyFd(client->fd, vfbExportClientNotify, X_NOTIFY_READ, client);
+    }
+    return TRUE;
+}
+
+static void
+vfbExportClientNotify(int fd, int ready, void *data)
+{
+    vfbExportClientPtr client = data;
+    char buf[64];
+    ssize_t n;
+
+    if (ready & X_NOTIFY_ERROR) {
+        vfbExportClientDestroy(client);
+        return;
+    }
+
+    /* Consumers have nothing to say, so this is them hanging up */
+    if (ready & X_NOTIFY_READ) {
+        n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            vfbExportClientDestroy(client);
+            return;
+        }
+    }
+
+    if ((ready & X_NOTIFY_WRITE) && !vfbExportFlush(client))
+        vfbExportClientDestroy(client);
+}
+
+/* Only consumers running as the server's user get the frame buffer */
+static Bool
+vfbExportPeerAllowed(int fd)
+{
+#ifdef HAVE_GETPEEREID
+    uid_t uid;
+    gid_t gid;
+
+    if (getpeereid(fd, &uid, &gid) < 0)
+        return FALSE;
+    return uid == geteuid();
+#elif defined(SO_PEERCRED)
+    struct ucred peercred;
+    socklen_t so_len = sizeof(peercred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peercred, &so_len) < 0)
+        return FALSE;
+    return peercred.uid == geteuid();
+#else
+    return FALSE;
+#endif
+}
+
+static void
+vfbExportAccept(int fd, int ready, void *data)
+{
+    vfbExportClientPtr client;
+    BoxRec box;
+    int i;
+
+    fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0)
+        return;
+
+    if (!vfbExportPeerAllowed(fd)) {
+        LogMessage(X_WARNING,
+                   "Xvfb: frame buffer export consumer of another user "
+                   "refused\n");
+        close(fd);
+        return;
+    }
+
+    client = calloc(1, sizeof(vfbExportClientRec));
+    if (!client) {
+        close(fd);
+        return;
+    }
+    client->fd = fd;
+    for (i = 0; i < MAXSCREENS; i++)
+        RegionNull(&client->pending[i]);
+    xorg_list_add(&client->link, &vfbExportClients);
+
+    if (!SetNotifyFd(fd, vfbExportClientNotify, X_NOTIFY_READ, client)) {
+        close(fd);
+        xorg_list_del(&client->link);
+        free(client);
+        return;
+    }
+
+    /* The first damage covers everything */
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        box.x1 = 0;
+        box.y1 = 0;
+        box.x2 = screenInfo.screens[i]->width;
+        box.y2 = screenInfo.screens[i]->height;
+        RegionReset(&client->pending[i], &box);
+        client->changed |= 1 << i;
+    }
+
+    LogMessageVerb(X_INFO, 3, "Xvfb: frame buffer export consumer connected\n");
+}
+
+/* Hand the damage collected while processing requests to the consumers */
+static void
+vfbExportBlockHandler(void *blockData, void *timeout)
+{
+    vfbExportClientPtr client, tmp;
+    int i;
+
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        vfbExportScreenPtr pes = &vfbExportScreens[i];
+        RegionPtr damage;
+
+        if (!pes->pDamage)
+            continue;
+
+        damage = DamageRegion(pes->pDamage);
+        if (!RegionNotEmpty(damage))
+            continue;
+
+        xorg_list_for_each_entry(client, &vfbExportClients, link)
+            RegionUnion(&client->pending[i], &client->pending[i], damage);
+        DamageEmpty(pes->pDamage);
+    }
+
+    xorg_list_for_each_entry_safe(client, tmp, &vfbExportClients, link) {
+        if (!client->blocked && !vfbExportFlush(client))
+            vfbExportClientDestroy(client);
+    }
+}
+
+static void
+vfbExportWakeupHandler(void *blockData, int result)
+{
+}
+
+static Bool
+vfbExportCreateScreenResources(ScreenPtr pScreen)
+{
+    vfbExportScreenPtr pes = &vfbExportScreens[pScreen->myNum];
+
+    pScreen->CreateScreenResources = pes->CreateScreenResources;
+    if (!(*pScreen->CreateScreenResources) (pScreen))
+        return FALSE;
+
+    pes->pDamage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+                                pScreen, pScreen);
+    if (!pes->pDamage)
+        return FALSE;
+
+    DamageRegister(&pScreen->GetScreenPixmap(pScreen)->drawable,
+                   pes->pDamage);
+    return TRUE;
+}
+
+/*
+ * Remove what an earlier server left at @path.  Anything but a socket
+ * nobody listens on any more stays, and fails the export.
+ */
+static Bool
+vfbExportRemoveStale(const char *path, struct sockaddr_un *addr)
+{
+    struct stat st;
+    Bool stale;
+    int fd;
+
+    if (lstat(path, &st) < 0)
+        return errno == ENOENT;
+    if (!S_ISSOCK(st.st_mode)) {
+        ErrorF("%s exists and is not a socket\n", path);
+        return FALSE;
+    }
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return FALSE;
+    stale = connect(fd, (struct sockaddr *) addr, sizeof(*addr)) < 0 &&
+        errno == ECONNREFUSED;
+    close(fd);
+
+    if (!stale) {
+        ErrorF("%s is in use\n", path);
+        return FALSE;
+    }
+    return unlink(path) == 0;
+}
+
+/**
+ * Listen for consumers on the Unix domain socket @path.  Consumers get
+ * writable descriptors of the frame buffers only if @writable is set.
+ */
+Bool
+vfbExportInit(const char *path, Bool writable)
+{
+    struct sockaddr_un addr;
+    mode_t mask;
+    int fd, ret;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        ErrorF("Frame buffer export socket path %s is too long\n", path);
+        return FALSE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        ErrorF("socket failed, %s\n", strerror(errno));
+        return FALSE;
+    }
+
+    if (!vfbExportRemoveStale(path, &addr)) {
+        close(fd);
+        return FALSE;
+    }
+
+    /* Only the server's user may connect */
+    mask = umask(0177);
+    ret = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+    umask(mask);
+    if (ret < 0) {
+        ErrorF("Cannot bind to %s, %s\n", path, strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+    if (chmod(path, 0600) < 0 || listen(fd, 8) < 0) {
+        ErrorF("Cannot listen on %s, %s\n", path, strerror(errno));
+        unlink(path);
+        close(fd);
+        return FALSE;
+    }
+
+    vfbExportPath = strdup(path);
+    if (!vfbExportPath ||
+        !SetNotifyFd(fd, vfbExportAccept, X_NOTIFY_READ, NULL)) {
+        unlink(path);
+        close(fd);
+        free(vfbExportPath);
+        vfbExportPath = NULL;
+        return FALSE;
+    }
+
+    vfbExportListenFd = fd;
+    vfbExportWritable = writable;
+    xorg_list_init(&vfbExportClients);
+    return TRUE;
+}
+
+void
+vfbExportFini(void)
+{
+    vfbExportClientPtr client, tmp;
+
+    if (vfbExportListenFd < 0)
+        return;
+
+    xorg_list_for_each_entry_safe(client, tmp, &vfbExportClients, link)
+        vfbExportClientDestroy(client);
+
+    RemoveNotifyFd(vfbExportListenFd);
+    close(vfbExportListenFd);
+    vfbExportListenFd = -1;
+
+    unlink(vfbExportPath);
+    free(vfbExportPath);
+    vfbExportPath = NULL;
+}
+
+/**
+ * A read-only descriptor of the memfd @fd, or -1.  Reopening it through
+ * /proc would give write access back, so the memfd is sealed against new
+ * writers first; existing writable mappings, like the server's, stay.
+ */
+int
+vfbExportReadOnlyFd(int fd)
+{
+    char path[32];
+
+#ifdef F_SEAL_FUTURE_WRITE
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_FUTURE_WRITE) < 0)
+        return -1;
+#endif
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * Export @pScreen, whose frame buffer is mapped at @base from the @size
+ * bytes of the memfd @fd.
+ */
+Bool
+vfbExportScreenInit(ScreenPtr pScreen, int fd, void *base, CARD32 size)
+{
+    vfbExportScreenPtr pes = &vfbExportScreens[pScreen->myNum];
+
+    if (vfbExportGeneration != serverGeneration) {
+        if (!RegisterBlockAndWakeupHandlers(vfbExportBlockHandler,
+                                            vfbExportWakeupHandler, NULL))
+            return FALSE;
+        vfbExportGeneration = serverGeneration;
+    }
+
+    if (!DamageSetup(pScreen))
+        return FALSE;
+
+    /* Consumers may not change the size of the memfd under the server */
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0) {
+        ErrorF("Cannot seal the frame buffer, %s\n", strerror(errno));
+        return FALSE;
+    }
+
+    pes->own_fd = !vfbExportWritable;
+    if (pes->own_fd) {
+        fd = vfbExportReadOnlyFd(fd);
+        if (fd < 0) {
+            ErrorF("Cannot make a read-only frame buffer descriptor, %s\n",
+                   strerror(errno));
+            return FALSE;
+        }
+    }
+
+    pes->fd = fd;
+    pes->base = base;
+    pes->size = size;
+    pes->pDamage = NULL;
+
+    pes->CreateScreenResources = pScreen->CreateScreenResources;
+    pScreen->CreateScreenResources = vfbExportCreateScreenResources;
+    return TRUE;
+}
+
+/**
+ * Tell the consumers about the new size of @pScreen, and have them read
+ * all of it again.
+ */
+void
+vfbExportScreenResize(ScreenPtr pScreen)
+{
+    vfbExportClientPtr client;
+    BoxRec box = { 0, 0, pScreen->width, pScreen->height };
+
+    xorg_list_for_each_entry(client, &vfbExportClients, link) {
+        RegionReset(&client->pending[pScreen->myNum], &box);
+        client->changed |= 1 << pScreen->myNum;
+    }
+}
+
+/**
+ * Stop tracking damage of @pScreen; must be called before the screen pixmap
+ * is destroyed.
+ */
+void
+vfbExportCloseScreen(ScreenPtr pScreen)
+{
+    vfbExportScreenPtr pes = &vfbExportScreens[pScreen->myNum];
+
+    if (pes->pDamage) {
+        DamageDestroy(pes->pDamage);
+        pes->pDamage = NULL;
+    }
+
+    if (pes->own_fd) {
+        close(pes->fd);
+        pes->own_fd = FALSE;
+    }
+    pes->fd = -1;
+}
+
+#endif                          /* VFB_EXPORT */
@@ -0,0 +1,90 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VFBEXPORT_H
+#define VFBEXPORT_H
+
+#include "scrnintstr.h"
+
+#if defined(HAVE_MMAP) && defined(HAVE_MEMFD_CREATE)
+#define VFB_EXPORT 1
+#endif
+
+/*
+ * Protocol of the frame buffer export socket (-fbexport).
+ *
+ * The socket is a SOCK_SEQPACKET Unix domain socket.  Once a consumer has
+ * connected, the server sends an XvfbExportScreen message for each screen,
+ * with the memfd holding the screen, in xwd format, attached as SCM_RIGHTS.
+ * From then on, XvfbExportDamage messages list the parts of the screens
+ * which have been drawn to since the previous message for the same screen;
+ * the first one covers the whole screen.  When a screen is resized, its
+ * XvfbExportScreen message is sent again, with another descriptor for the
+ * same memfd, and followed by damage covering all of it; the size of the
+ * memfd and the stride never change, so existing mappings remain valid.
+ * Consumers never need to send anything; messages for a consumer which
+ * doesn't keep up are merged.
+ * Everything is in the byte order of the server.
+ *
+ * Only processes running as the server's user may connect, and the memfd
+ * descriptors they get are read-only unless the server was started with
+ * -fbexportrw.
+ */
+
+#define XVFB_EXPORT_SCREEN      1
+#define XVFB_EXPORT_DAMAGE      2
+
+typedef struct {
+    CARD32 type;                /* XVFB_EXPORT_SCREEN */
+    CARD32 screen;
+    CARD32 size;                /* of the memfd */
+    CARD32 offset;              /* of the pixels in the memfd */
+    CARD32 width;
+    CARD32 height;
+    CARD32 stride;              /* in bytes */
+    CARD32 bitsPerPixel;
+    CARD32 depth;
+} XvfbExportScreenRec;
+
+typedef struct {
+    INT16 x1, y1, x2, y2;
+} XvfbExportBoxRec;
+
+typedef struct {
+    CARD32 type;                /* XVFB_EXPORT_DAMAGE */
+    CARD32 screen;
+    CARD32 nbox;                /* followed by nbox XvfbExportBoxRec */
+} XvfbExportDamageRec;
+
+/* Damage with more boxes than this is sent as its extents */
+#define XVFB_EXPORT_MAX_BOXES   256
+
+#ifdef VFB_EXPORT
+extern Bool vfbExportInit(const char *path, Bool writable);
+extern void vfbExportFini(void);
+extern Bool vfbExportScreenInit(ScreenPtr pScreen, int fd, void *base,
+                                CARD32 size);
+extern void vfbExportScreenResize(ScreenPtr pScreen);
+extern void vfbExportCloseScreen(ScreenPtr pScreen);
+extern int vfbExportReadOnlyFd(int fd);
+#endif
+
+#endif                          /* VFBEXPORT_H */
@@ -74,9 +74,9 @@
  * mask is 0xFFFF0000.
  */
 #define ABI_ANSIC_VERSION	SET_ABI_VERSION(0, 4)
-#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(24, 0)
-#define ABI_XINPUT_VERSION	SET_ABI_VERSION(24, 1)
-#define ABI_EXTENSION_VERSION	SET_ABI_VERSION(10, 0)
+#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(26, 0)
+#define ABI_XINPUT_VERSION	SET_ABI_VERSION(25, 0)
+#define ABI_EXTENSION_VERSION	SET_ABI_VERSION(11, 0)
 
 #define MODINFOSTRING1	0xef23fdc5
 #define MODINFOSTRING2	0x10dc023a
@@ -323,6 +323,22 @@ ApplyTransformationMatrix(DeviceIntPtr dev)
                            PropModeReplace, 9, matrix, FALSE);
 }
 
+static void
+ApplyMotionHistorySize(DeviceIntPtr dev)
+{
+    InputInfoPtr pInfo = (InputInfoPtr) dev->public.devicePrivate;
+    int size;
+
+    if (!dev->valuator)
+        return;
+
+    size = xf86SetIntOption(pInfo->options, "MotionHistorySize", -1);
+    if (size < 0 || size == dev->valuator->numMotionEvents)
+        return;
+
+    SetMotionHistorySize(dev, size);
+}
+
 /***********************************************************************
  *
  * xf86ProcessCommonOptions --
@@ -821,6 +837,7 @@ xf86InputDevicePostInit(DeviceIntPtr dev)
 {
     ApplyAccelerationSettings(dev);
     ApplyTransformationMatrix(dev);
+    ApplyMotionHistorySize(dev);
     return Success;
 }
 
@@ -0,0 +1,78 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/** @file double_shadow.c
+ *
+ * Double-buffered shadow updates.
+ *
+ * On devices where the front buffer is uncached or lives across a slow
+ * bus, a second copy of the shadow holds what was last written to the
+ * front buffer, and the rows of damaged tiles which didn't actually
+ * change are left out of the update.  The comparison itself lives in the
+ * shadow layer, see shadowDiffDamage.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include "dix-config.h"
+#endif
+
+#include "xf86.h"
+#include "shadow.h"
+
+#include "driver.h"
+
+/**
+ * Drop what didn't change since the last update from the damage of
+ * @pBuf, and bring the second copy of the shadow up to date.
+ */
+void
+ms_double_shadow_update(ScreenPtr pScreen, shadowBufPtr pBuf)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    modesettingPtr ms = modesettingPTR(pScrn);
+
+    shadowDiffDamage(pScreen, pBuf, ms->drmmode.shadow_fb2);
+}
+
+void
+ms_double_shadow_free(ScrnInfoPtr scrn)
+{
+    modesettingPtr ms = modesettingPTR(scrn);
+
+    free(ms->drmmode.shadow_fb2);
+    ms->drmmode.shadow_fb2 = NULL;
+}
+
+/**
+ * (Re)allocate the second copy of the shadow for the current frame buffer
+ * size.  It starts out cleared, like the shadow itself.
+ */
+Bool
+ms_double_shadow_alloc(ScrnInfoPtr scrn)
+{
+    modesettingPtr ms = modesettingPTR(scrn);
+    int cpp = (scrn->bitsPerPixel + 7) >> 3;
+
+    ms_double_shadow_free(scrn);
+
+    ms->drmmode.shadow_fb2 = calloc(1, scrn->displayWidth * scrn->virtualY * cpp);
+    return ms->drmmode.shadow_fb2 != NULL;
+}
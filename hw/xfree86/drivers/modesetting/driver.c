@@ -582,14 +582,163 @@ dispatch_slave_dirty(ScreenPtr pScreen)
     }
 }
 
+/* How often to log the update latency of each PRIME sink, in microseconds */
+#define MS_DIRTY_REPORT_INTERVAL 10000000
+
+/**
+ * A copy into a shared pixmap which the GPU may not have finished yet;
+ * the sink is told about it once the fence signals.
+ */
+struct ms_dirty_fence {
+    struct xorg_list link;
+    ScreenPtr screen;
+    PixmapPtr slave_dst;
+    int fd;
+    CARD64 since;
+};
+
 static void
-redisplay_dirty(ScreenPtr screen, PixmapDirtyUpdatePtr dirty, int *timeout)
+ms_dirty_account(ScreenPtr screen, msPixmapPrivPtr ppriv, PixmapPtr slave_dst,
+                 CARD64 since)
+{
+    ScrnInfoPtr scrn = xf86ScreenToScrn(screen);
+    CARD64 now = GetTimeInMicros();
+
+    ppriv->dirty_updates++;
+    ppriv->dirty_latency += now - since;
+    ppriv->dirty_latency_max = max(ppriv->dirty_latency_max, now - since);
+
+    if (!ppriv->dirty_report_time)
+        ppriv->dirty_report_time = now;
+    if (now - ppriv->dirty_report_time < MS_DIRTY_REPORT_INTERVAL)
+        return;
+
+    xf86DrvMsgVerb(scrn->scrnIndex, X_INFO, MS_LOGLEVEL_DEBUG,
+                   "PRIME sink %dx%d: %u updates, %u coalesced, "
+                   "latency %llu us average, %llu us max\n",
+                   slave_dst->drawable.width, slave_dst->drawable.height,
+                   (unsigned) ppriv->dirty_updates,
+                   (unsigned) ppriv->dirty_coalesced,
+                   (unsigned long long) (ppriv->dirty_latency /
+                                         ppriv->dirty_updates),
+                   (unsigned long long) ppriv->dirty_latency_max);
+
+    ppriv->dirty_updates = 0;
+    ppriv->dirty_coalesced = 0;
+    ppriv->dirty_latency = 0;
+    ppriv->dirty_latency_max = 0;
+    ppriv->dirty_report_time = now;
+}
+
+/* Let the sink know its shared pixmap has been updated */
+static void
+ms_dirty_notify(PixmapPtr slave_dst)
 {
-    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(screen));
     RegionRec pixregion;
 
-    PixmapRegionInit(&pixregion, dirty->slave_dst);
-    DamageRegionAppend(&dirty->slave_dst->drawable, &pixregion);
+    PixmapRegionInit(&pixregion, slave_dst);
+    DamageRegionAppend(&slave_dst->drawable, &pixregion);
+    DamageRegionProcessPending(&slave_dst->drawable);
+    RegionUninit(&pixregion);
+}
+
+static void
+ms_dirty_fence_free(struct ms_dirty_fence *fence)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(fence->screen));
+    msPixmapPrivPtr ppriv = msGetPixmapPriv(&ms->drmmode, fence->slave_dst);
+    PixmapPtr slave_dst = fence->slave_dst;
+
+    RemoveNotifyFd(fence->fd);
+    close(fence->fd);
+    xorg_list_del(&fence->link);
+    ppriv->dirty_fence = NULL;
+    free(fence);
+
+    slave_dst->drawable.pScreen->DestroyPixmap(slave_dst);
+}
+
+#ifdef GLAMOR_HAS_GBM
+static void
+ms_dirty_fence_signaled(int fd, int ready, void *data)
+{
+    struct ms_dirty_fence *fence = data;
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(fence->screen));
+    msPixmapPrivPtr ppriv = msGetPixmapPriv(&ms->drmmode, fence->slave_dst);
+
+    ms_dirty_notify(fence->slave_dst);
+    ms_dirty_account(fence->screen, ppriv, fence->slave_dst, fence->since);
+    ms_dirty_fence_free(fence);
+}
+
+/*
+ * Rather than waiting for the GPU to finish the copy just queued to
+ * @slave_dst, tell the sink about it from the main loop once a fence
+ * signals.  Until then, further damage for this sink accumulates.
+ */
+static Bool
+ms_dirty_fence_queue(ScreenPtr screen, PixmapPtr slave_dst,
+                     msPixmapPrivPtr ppriv, CARD64 since)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(screen));
+    struct ms_dirty_fence *fence;
+    int fd;
+
+    fd = glamor_egl_fence_fd(screen);
+    if (fd < 0)
+        return FALSE;
+
+    fence = calloc(1, sizeof(*fence));
+    if (!fence) {
+        close(fd);
+        return FALSE;
+    }
+
+    if (!SetNotifyFd(fd, ms_dirty_fence_signaled, X_NOTIFY_READ, fence)) {
+        close(fd);
+        free(fence);
+        return FALSE;
+    }
+
+    fence->screen = screen;
+    fence->slave_dst = slave_dst;
+    fence->fd = fd;
+    fence->since = since;
+    slave_dst->refcnt++;
+    xorg_list_add(&fence->link, &ms->dirty_fences);
+    ppriv->dirty_fence = fence;
+
+    return TRUE;
+}
+#endif
+
+static void
+ms_dirty_fences_fini(ScreenPtr screen)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(screen));
+    struct ms_dirty_fence *fence, *tmp;
+
+    xorg_list_for_each_entry_safe(fence, tmp, &ms->dirty_fences, link)
+        ms_dirty_fence_free(fence);
+}
+
+/*
+ * Copy the damage of @dirty to its shared pixmap.  With @ppriv, the
+ * private of the sink, the sink may be told about it only later, when
+ * the GPU is done.
+ */
+static void
+redisplay_dirty(ScreenPtr screen, PixmapDirtyUpdatePtr dirty, int *timeout,
+                msPixmapPrivPtr ppriv)
+{
+    modesettingPtr ms = modesettingPTR(xf86ScreenToScrn(screen));
+    CARD64 since = 0;
+
+    if (ppriv) {
+        since = ppriv->dirty_since;
+        ppriv->dirty_since = 0;
+    }
+
     PixmapSyncDirtyHelper(dirty);
 
     if (!screen->isGPU) {
@@ -600,16 +749,21 @@ redisplay_dirty(ScreenPtr screen, PixmapDirtyUpdatePtr dirty, int *timeout)
          * copy to its own framebuffer (some slaves scanout directly from
          * the shared pixmap, but not all).
          */
-        if (ms->drmmode.glamor)
+        if (ms->drmmode.glamor) {
+            if (ppriv && dirty->slave_dst->master_pixmap &&
+                ms_dirty_fence_queue(screen, dirty->slave_dst, ppriv, since))
+                return;
             glamor_finish(screen);
+        }
 #endif
         /* Ensure the slave processes the damage immediately */
         if (timeout)
             *timeout = 0;
     }
 
-    DamageRegionProcessPending(&dirty->slave_dst->drawable);
-    RegionUninit(&pixregion);
+    ms_dirty_notify(dirty->slave_dst);
+    if (ppriv)
+        ms_dirty_account(screen, ppriv, dirty->slave_dst, since);
 }
 
 static void
@@ -640,7 +794,18 @@ ms_dirty_update(ScreenPtr screen, int *timeout)
             if (ppriv->defer_dirty_update)
                 continue;
 
-            redisplay_dirty(screen, ent, timeout);
+            if (!ppriv->dirty_since)
+                ppriv->dirty_since = GetTimeInMicros();
+
+            /* The sink hasn't got the previous copy yet, let the damage
+             * pile up until it has
+             */
+            if (ppriv->dirty_fence) {
+                ppriv->dirty_coalesced++;
+                continue;
+            }
+
+            redisplay_dirty(screen, ent, timeout, ppriv);
             DamageEmpty(ent->damage);
         }
     }
@@ -1081,41 +1246,6 @@ msShadowWindow(ScreenPtr screen, CARD32 row, CARD32 offset, int mode,
     return ((uint8_t *) ms->drmmode.front_bo.dumb->ptr + row * stride + offset);
 }
 
-/* somewhat arbitrary tile size, in pixels */
-#define TILE 16
-
-static int
-msUpdateIntersect(modesettingPtr ms, shadowBufPtr pBuf, BoxPtr box,
-                  xRectangle *prect)
-{
-    int i, dirty = 0, stride = pBuf->pPixmap->devKind, cpp = ms->drmmode.cpp;
-    int width = (box->x2 - box->x1) * cpp;
-    unsigned char *old, *new;
-
-    old = ms->drmmode.shadow_fb2;
-    old += (box->y1 * stride) + (box->x1 * cpp);
-    new = ms->drmmode.shadow_fb;
-    new += (box->y1 * stride) + (box->x1 * cpp);
-
-    for (i = box->y2 - box->y1 - 1; i >= 0; i--) {
-        unsigned char *o = old + i * stride,
-                      *n = new + i * stride;
-        if (memcmp(o, n, width) != 0) {
-            dirty = 1;
-            memcpy(o, n, width);
-        }
-    }
-
-    if (dirty) {
-        prect->x = box->x1;
-        prect->y = box->y1;
-        prect->width = box->x2 - box->x1;
-        prect->height = box->y2 - box->y1;
-    }
-
-    return dirty;
-}
-
 static void
 msUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
 {
@@ -1123,45 +1253,8 @@ msUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
     modesettingPtr ms = modesettingPTR(pScrn);
     Bool use_3224 = ms->drmmode.force_24_32 && pScrn->bitsPerPixel == 32;
 
-    if (ms->drmmode.shadow_enable2 && ms->drmmode.shadow_fb2) do {
-        RegionPtr damage = DamageRegion(pBuf->pDamage), tiles;
-        BoxPtr extents = RegionExtents(damage);
-        xRectangle *prect;
-        int nrects;
-        int i, j, tx1, tx2, ty1, ty2;
-
-        tx1 = extents->x1 / TILE;
-        tx2 = (extents->x2 + TILE - 1) / TILE;
-        ty1 = extents->y1 / TILE;
-        ty2 = (extents->y2 + TILE - 1) / TILE;
-
-        nrects = (tx2 - tx1) * (ty2 - ty1);
-        if (!(prect = calloc(nrects, sizeof(xRectangle))))
-            break;
-
-        nrects = 0;
-        for (j = ty2 - 1; j >= ty1; j--) {
-            for (i = tx2 - 1; i >= tx1; i--) {
-                BoxRec box;
-
-                box.x1 = max(i * TILE, extents->x1);
-                box.y1 = max(j * TILE, extents->y1);
-                box.x2 = min((i+1) * TILE, extents->x2);
-                box.y2 = min((j+1) * TILE, extents->y2);
-
-                if (RegionContainsRect(damage, &box) != rgnOUT) {
-                    if (msUpdateIntersect(ms, pBuf, &box, prect + nrects)) {
-                        nrects++;
-                    }
-                }
-            }
-        }
-
-        tiles = RegionFromRects(nrects, prect, CT_NONE);
-        RegionIntersect(damage, damage, tiles);
-        RegionDestroy(tiles);
-        free(prect);
-    } while (0);
+    if (ms->drmmode.shadow_enable2 && ms->drmmode.shadow_fb2)
+        ms_double_shadow_update(pScreen, pBuf);
 
     if (use_3224)
         shadowUpdate32to24(pScreen, pBuf);
@@ -1264,7 +1357,8 @@ msPresentSharedPixmap(PixmapPtr slave_dst)
     RegionPtr region = DamageRegion(ppriv->dirty->damage);
 
     if (RegionNotEmpty(region)) {
-        redisplay_dirty(ppriv->slave_src->drawable.pScreen, ppriv->dirty, NULL);
+        redisplay_dirty(ppriv->slave_src->drawable.pScreen, ppriv->dirty, NULL,
+                        NULL);
         DamageEmpty(ppriv->dirty->damage);
 
         return TRUE;
@@ -1340,8 +1434,7 @@ CreateScreenResources(ScreenPtr pScreen)
         pixels = ms->drmmode.shadow_fb;
 
     if (ms->drmmode.shadow_enable2) {
-        ms->drmmode.shadow_fb2 = calloc(1, pScrn->displayWidth * pScrn->virtualY * ((pScrn->bitsPerPixel + 7) >> 3));
-        if (!ms->drmmode.shadow_fb2)
+        if (!ms_double_shadow_alloc(pScrn))
             ms->drmmode.shadow_enable2 = FALSE;
     }
 
@@ -1352,6 +1445,10 @@ CreateScreenResources(ScreenPtr pScreen)
         if (!shadowAdd(pScreen, rootPixmap, msUpdatePacked, msShadowWindow,
                        0, 0))
             return FALSE;
+
+        /* Spread the comparisons of large updates over a few threads */
+        if (ms->drmmode.shadow_enable2)
+            shadowSetThreads(pScreen, 0);
     }
 
     err = drmModeDirtyFB(ms->fd, ms->drmmode.fb_id, NULL, 0);
@@ -1538,6 +1635,8 @@ ScreenInit(ScreenPtr pScreen, int argc, char **argv)
     if (!SetMaster(pScrn))
         return FALSE;
 
+    xorg_list_init(&ms->dirty_fences);
+
 #ifdef GLAMOR_HAS_GBM
     if (ms->drmmode.glamor)
         ms->drmmode.gbm = glamor_egl_get_gbm_device(pScreen);
@@ -1796,6 +1895,7 @@ CloseScreen(ScreenPtr pScreen)
 #endif
 
     ms_vblank_close_screen(pScreen);
+    ms_dirty_fences_fini(pScreen);
 
     if (ms->damage) {
         DamageUnregister(ms->damage);
@@ -1807,8 +1907,7 @@ CloseScreen(ScreenPtr pScreen)
         shadowRemove(pScreen, pScreen->GetScreenPixmap(pScreen));
         free(ms->drmmode.shadow_fb);
         ms->drmmode.shadow_fb = NULL;
-        free(ms->drmmode.shadow_fb2);
-        ms->drmmode.shadow_fb2 = NULL;
+        ms_double_shadow_free(pScrn);
     }
     drmmode_uevent_fini(pScrn, &ms->drmmode);
 
@@ -32,6 +32,7 @@
 #include <xf86drm.h>
 #include <xf86Crtc.h>
 #include <damage.h>
+#include "shadow.h"
 
 #ifdef GLAMOR_HAS_GBM
 #define GLAMOR_FOR_XORG 1
@@ -110,6 +111,9 @@ typedef struct _modesettingRec {
     DamagePtr damage;
     Bool dirty_enabled;
 
+    /** Copies into shared pixmaps waiting for the GPU */
+    struct xorg_list dirty_fences;
+
     uint32_t cursor_width, cursor_height;
 } modesettingRec, *modesettingPtr;
 
@@ -142,6 +146,10 @@ void ms_dri2_close_screen(ScreenPtr screen);
 Bool ms_vblank_screen_init(ScreenPtr screen);
 void ms_vblank_close_screen(ScreenPtr screen);
 
+Bool ms_double_shadow_alloc(ScrnInfoPtr scrn);
+void ms_double_shadow_free(ScrnInfoPtr scrn);
+void ms_double_shadow_update(ScreenPtr screen, shadowBufPtr pBuf);
+
 Bool ms_present_screen_init(ScreenPtr screen);
 
 #ifdef GLAMOR_HAS_GBM
@@ -1980,12 +1980,8 @@ drmmode_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height)
         drmmode->shadow_fb = new_pixels;
     }
 
-    if (drmmode->shadow_enable2) {
-        uint32_t size = scrn->displayWidth * scrn->virtualY * cpp;
-        void *fb2 = calloc(1, size);
-        free(drmmode->shadow_fb2);
-        drmmode->shadow_fb2 = fb2;
-    }
+    if (drmmode->shadow_enable2)
+        ms_double_shadow_alloc(scrn);
 
     screen->ModifyPixmapHeader(ppix, width, height, -1, -1,
                                scrn->displayWidth * cpp, new_pixels);
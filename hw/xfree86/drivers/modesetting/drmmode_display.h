@@ -155,6 +155,13 @@ typedef struct _msPixmapPriv {
     PixmapDirtyUpdatePtr dirty; /* cached dirty ent to avoid searching list */
     PixmapPtr slave_src; /* if we exported shared pixmap, dirty tracking src */
     Bool notify_on_damage; /* if sink has requested damage notification */
+
+    /** Source fields for asynchronous updates of shared pixmaps */
+    struct ms_dirty_fence *dirty_fence; /* copy the GPU is still busy with */
+    CARD64 dirty_since; /* when the damage not copied yet first showed up */
+    CARD32 dirty_updates, dirty_coalesced; /* since the last report */
+    CARD64 dirty_latency, dirty_latency_max; /* in microseconds */
+    CARD64 dirty_report_time;
 } msPixmapPrivRec, *msPixmapPrivPtr;
 
 extern DevPrivateKeyRec msPixmapPrivateKeyRec;
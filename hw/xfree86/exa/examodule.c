@@ -126,8 +126,9 @@ exaDDXDriverInit(ScreenPtr pScreen)
     xf86ProcessOptions(pScrn->scrnIndex, pScrn->options, pScreenPriv->options);
 
     if (pExaScr->info->flags & EXA_OFFSCREEN_PIXMAPS) {
-        if (!(pExaScr->info->flags & EXA_HANDLES_PIXMAPS) &&
-            pExaScr->info->offScreenBase < pExaScr->info->memorySize) {
+        if ((pExaScr->info->flags & EXA_MIXED_PIXMAPS) ||
+            (!(pExaScr->info->flags & EXA_HANDLES_PIXMAPS) &&
+             pExaScr->info->offScreenBase < pExaScr->info->memorySize)) {
             const char *heuristicName;
 
             heuristicName = xf86GetOptValString(pScreenPriv->options,
@@ -139,11 +140,20 @@ exaDDXDriverInit(ScreenPtr pScreen)
                     pExaScr->migration = ExaMigrationAlways;
                 else if (strcmp(heuristicName, "smart") == 0)
                     pExaScr->migration = ExaMigrationSmart;
+                else if (strcmp(heuristicName, "adaptive") == 0)
+                    pExaScr->migration = ExaMigrationAdaptive;
                 else {
                     xf86DrvMsg(pScreen->myNum, X_WARNING,
                                "EXA: unknown migration heuristic %s\n",
                                heuristicName);
                 }
+
+                if ((pExaScr->info->flags & EXA_MIXED_PIXMAPS) &&
+                    pExaScr->migration != ExaMigrationAdaptive) {
+                    xf86DrvMsg(pScreen->myNum, X_WARNING,
+                               "EXA: migration heuristic %s has no effect "
+                               "with mixed pixmaps\n", heuristicName);
+                }
             }
         }
 
@@ -53,11 +53,16 @@ typedef struct _OFclosure {
     char *fontname;
     int fnamelen;
     FontPtr non_cachable_font;
+    CARD64 start;               /* for the latency statistics */
+    Bool suspended;
 } OFclosureRec;
 
 /* ListFontsWithInfo */
 
 #define XLFDMAXFONTNAMELEN	256
+
+struct _FontListCache;
+
 typedef struct _LFWIstate {
     char pattern[XLFDMAXFONTNAMELEN];
     int patlen;
@@ -78,6 +83,7 @@ typedef struct _LFWIclosure {
     int savedNumFonts;
     Bool haveSaved;
     char *savedName;
+    struct _FontListCache *cache;       /* replies being recorded */
 } LFWIclosureRec;
 
 /* ListFonts */
@@ -92,6 +98,7 @@ typedef struct _LFclosure {
     Bool haveSaved;
     char *savedName;
     int savedNameLen;
+    struct _FontListCache *cache;       /* reply being recorded */
 } LFclosureRec;
 
 /* PolyText */
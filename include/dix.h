@@ -126,7 +126,7 @@ typedef struct _Client *ClientPtr;      /* also in misc.h */
 
 typedef struct _WorkQueue *WorkQueuePtr;
 
-extern _X_EXPORT ClientPtr clients[MAXCLIENTS];
+extern _X_EXPORT ClientPtr *clients;
 extern _X_EXPORT ClientPtr serverClient;
 extern _X_EXPORT int currentMaxClients;
 extern _X_EXPORT char dispatchExceptionAtReset;
@@ -167,6 +167,8 @@ extern _X_EXPORT void InitClient(ClientPtr client,
 
 extern _X_EXPORT ClientPtr NextAvailableClient(void *ospriv);
 
+extern void InitClientsTable(void);
+
 extern _X_EXPORT void SendErrorToClient(ClientPtr /*client */ ,
                                         unsigned int /*majorCode */ ,
                                         unsigned int /*minorCode */ ,
@@ -51,6 +51,9 @@ extern _X_EXPORT void QueryFont(FontPtr /*pFont */ ,
                                 xQueryFontReplyPtr /*pReply */ ,
                                 int /*nProtoCCIStructs */ );
 
+extern int SendQueryFontReply(ClientPtr /*client */ ,
+                              FontPtr /*pFont */ );
+
 extern _X_EXPORT int ListFonts(ClientPtr /*client */ ,
                                unsigned char * /*pattern */ ,
                                unsigned int /*length */ ,
@@ -95,6 +98,10 @@ extern _X_EXPORT void DeleteClientFontStuff(ClientPtr /*client */ );
 #endif
 extern _X_EXPORT void InitFonts(void);
 
+extern void ReleaseRetainedFonts(void);
+
+extern void PrefetchFonts(void);
+
 extern _X_EXPORT void FreeFonts(void);
 
 extern _X_EXPORT void GetGlyphs(FontPtr /*font */ ,
@@ -495,6 +495,8 @@ extern _X_EXPORT int GetMotionHistorySize(void);
 
 extern _X_EXPORT void AllocateMotionHistory(DeviceIntPtr pDev);
 
+extern _X_EXPORT void SetMotionHistorySize(DeviceIntPtr pDev, int nevents);
+
 extern _X_EXPORT int GetMotionHistory(DeviceIntPtr pDev,
                                       xTimecoord ** buff,
                                       unsigned long start,
@@ -284,8 +284,7 @@ typedef struct _ValuatorAccelerationRec {
 typedef struct _ValuatorClassRec {
     int sourceid;
     int numMotionEvents;
-    int first_motion;
-    int last_motion;
+    unsigned int motion_count;  /* motion history entries ever written */
     void *motion;               /* motion history buffer. Different layout
                                    for MDs and SDs! */
     WindowPtr motionHintWindow;
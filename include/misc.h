@@ -87,8 +87,8 @@ OF THIS SOFTWARE.
 #ifndef MAXGPUSCREENS
 #define MAXGPUSCREENS	16
 #endif
-#define MAXCLIENTS	2048
-#define LIMITCLIENTS	256     /* Must be a power of 2 and <= MAXCLIENTS */
+#define MAXCLIENTS	16384   /* Must be a power of 2 */
+#define LIMITCLIENTS	256     /* Must be <= MAXCLIENTS */
 #define MAXEXTENSIONS   128
 #define MAXFORMATS	8
 #define MAXDEVICES	40      /* input devices */
@@ -72,6 +72,7 @@ extern _X_EXPORT int limitNoFile;
 #endif
 extern _X_EXPORT Bool defeatAccessControl;
 extern _X_EXPORT long maxBigRequestSize;
+extern _X_EXPORT int motionHistorySize;
 extern _X_EXPORT Bool party_like_its_1989;
 extern _X_EXPORT Bool whiteRoot;
 extern _X_EXPORT Bool bgNoneRoot;
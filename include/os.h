@@ -163,6 +163,25 @@ static inline void RemoveNotifyFd(int fd)
     (void) SetNotifyFd(fd, NULL, X_NOTIFY_NONE, NULL);
 }
 
+typedef struct _WorkerPool *WorkerPoolPtr;
+
+typedef void (*WorkerTaskProcPtr)(void *data);
+
+extern _X_EXPORT WorkerPoolPtr WorkerPoolCreate(const char *name, int nthreads);
+
+extern _X_EXPORT void WorkerPoolDestroy(WorkerPoolPtr pool);
+
+extern _X_EXPORT Bool WorkerPoolQueue(WorkerPoolPtr pool,
+                                      WorkerTaskProcPtr task,
+                                      WorkerTaskProcPtr done,
+                                      void *data);
+
+extern _X_EXPORT void WorkerPoolDrain(WorkerPoolPtr pool);
+
+extern _X_EXPORT int WorkerPoolThreads(WorkerPoolPtr pool);
+
+extern _X_EXPORT int WorkerPoolDefaultThreads(int max);
+
 extern _X_EXPORT int OnlyListenToOneClient(ClientPtr /*client */ );
 
 extern _X_EXPORT void ListenToAllClients(void);
@@ -524,6 +543,9 @@ GenerateAuthorization(unsigned int /* name_length */ ,
                       char ** /* data_return */ );
 #endif
 
+extern _X_EXPORT void
+GenerateRandomData(int /* len */ , char * /* buf */ );
+
 extern _X_EXPORT int
 ddxProcessArgument(int /*argc */ , char * /*argv */ [], int /*i */ );
 
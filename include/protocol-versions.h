@@ -78,6 +78,8 @@
 /* Record */
 #define SERVER_RECORD_MAJOR_VERSION		1
 #define SERVER_RECORD_MINOR_VERSION		13
+/* With EnableContextRing, which needs memfd and fd passing */
+#define SERVER_RECORD_RING_MINOR_VERSION	14
 
 /* Render */
 #define SERVER_RENDER_MAJOR_VERSION		0
@@ -107,6 +109,10 @@
 #define SERVER_SHM_MINOR_VERSION		1
 #endif
 
+/* XORG-SHM-CAPTURE, server private */
+#define SERVER_SHM_CAPTURE_MAJOR_VERSION	1
+#define SERVER_SHM_CAPTURE_MINOR_VERSION	0
+
 /* Sync */
 #define SERVER_SYNC_MAJOR_VERSION		3
 #define SERVER_SYNC_MINOR_VERSION		1
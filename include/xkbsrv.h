@@ -197,6 +197,8 @@ typedef struct _XkbSrvInfo {
     XkbSrvCheckRepeatPtr checkRepeat;
 
     char overlay_perkey_state[256/8]; /* bitfield */
+
+    CARD32 keymapSerial;        /* same for identical keymaps, 0 if unknown */
 } XkbSrvInfoRec, *XkbSrvInfoPtr;
 
 #define	XkbSLI_IsDefault	(1L<<0)
@@ -839,6 +841,10 @@ extern Bool XkbCopyKeymap(XkbDescPtr /* dst */ ,
 extern _X_EXPORT Bool XkbCopyDeviceKeymap(DeviceIntPtr /* dst */,
 					  DeviceIntPtr /* src */);
 
+extern CARD32 XkbNextKeymapSerial(void);
+
+extern void XkbKeymapChanged(DeviceIntPtr /* kbd */ );
+
 extern _X_EXPORT Bool XkbDeviceApplyKeymap(DeviceIntPtr /* dst */ ,
                                            XkbDescPtr /* src */ );
 
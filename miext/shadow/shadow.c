@@ -105,6 +105,7 @@ shadowCloseScreen(ScreenPtr pScreen)
     unwrap(pBuf, pScreen, BlockHandler);
     shadowRemove(pScreen, pBuf->pPixmap);
     DamageDestroy(pBuf->pDamage);
+    WorkerPoolDestroy(pBuf->pool);
     if (pBuf->pPixmap)
         pScreen->DestroyPixmap(pBuf->pPixmap);
     free(pBuf);
@@ -141,6 +142,7 @@ shadowSetup(ScreenPtr pScreen)
     pBuf->pPixmap = 0;
     pBuf->closure = 0;
     pBuf->randr = 0;
+    pBuf->pool = NULL;
 
     dixSetPrivate(&pScreen->devPrivates, shadowScrPrivateKey, pBuf);
     return TRUE;
@@ -193,3 +195,23 @@ shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap)
         pBuf->pPixmap = 0;
     }
 }
+
+/*
+ * Start the worker threads used by shadowUpdateTiled for large updates;
+ * zero or less means one per CPU.  No more are started than an update
+ * can use.
+ */
+Bool
+shadowSetThreads(ScreenPtr pScreen, int nthreads)
+{
+    shadowBuf(pScreen);
+
+    if (nthreads <= 0)
+        nthreads = WorkerPoolDefaultThreads(SHADOW_TILE_MAX_TASKS - 1);
+    else
+        nthreads = min(nthreads, SHADOW_TILE_MAX_TASKS - 1);
+
+    if (!pBuf->pool)
+        pBuf->pool = WorkerPoolCreate("shadow", nthreads);
+    return pBuf->pool != NULL;
+}
@@ -55,6 +55,9 @@ typedef struct _shadowBuf {
     GetImageProcPtr GetImage;
     CloseScreenProcPtr CloseScreen;
     ScreenBlockHandlerProcPtr BlockHandler;
+
+    /* worker threads for shadowUpdateTiled */
+    WorkerPoolPtr pool;
 } shadowBufRec;
 
 /* Match defines from randr extension */
@@ -81,6 +84,9 @@ shadowAdd(ScreenPtr pScreen,
 extern _X_EXPORT void
  shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap);
 
+extern _X_EXPORT Bool
+ shadowSetThreads(ScreenPtr pScreen, int nthreads);
+
 extern _X_EXPORT void
  shadowUpdateAfb4(ScreenPtr pScreen, shadowBufPtr pBuf);
 
@@ -150,6 +156,26 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  shadowUpdate32to24(ScreenPtr pScreen, shadowBufPtr pBuf);
 
+/*
+ * Like shadowUpdateRotatePacked, but split across the threads started by
+ * shadowSetThreads for large updates.  Only for frame buffers mapped
+ * linearly by a window proc that may be called from any thread.
+ */
+extern _X_EXPORT void
+ shadowUpdateTiled(ScreenPtr pScreen, shadowBufPtr pBuf);
+
+/* Most pieces an update is split in, including the calling thread's */
+#define SHADOW_TILE_MAX_TASKS	16
+
+/*
+ * For double-buffered shadows: reduce the damage of @pBuf to what differs
+ * from @copy, which holds what was last sent and has the layout of the
+ * shadow pixmap, and update @copy.  Large updates are split across the
+ * threads started by shadowSetThreads.
+ */
+extern _X_EXPORT void
+ shadowDiffDamage(ScreenPtr pScreen, shadowBufPtr pBuf, void *copy);
+
 typedef void (*shadowUpdateProc) (ScreenPtr, shadowBufPtr);
 
 #endif                          /* _SHADOW_H_ */
@@ -0,0 +1,219 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Damage trimming for double-buffered shadows.
+ *
+ * On devices where the front buffer is uncached or lives across a slow
+ * bus, a second copy of the shadow can hold what was last written to the
+ * front buffer.  shadowDiffDamage compares the damaged 16x16 tiles of the
+ * shadow against that copy row by row, and reduces the damage to the rows
+ * of each tile which actually changed.
+ *
+ * Tile rows are handed out one at a time to the calling thread and, for
+ * large updates, to the worker threads started by shadowSetThreads, so
+ * that the caller keeps comparing instead of waiting for the others.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include    <X11/X.h>
+#include    "scrnintstr.h"
+#include    "pixmapstr.h"
+#include    "regionstr.h"
+#include    "shadow.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* somewhat arbitrary tile size, in pixels */
+#define SHADOW_DIFF_TILE	16
+
+/* Below this many damaged pixels, threads cost more than they save */
+#define SHADOW_DIFF_MIN_PIXELS	(256 * 256)
+
+typedef struct {
+    RegionPtr damage;
+    CARD8 *new;
+    CARD8 *old;
+    int stride;
+    int cpp;
+    int width, height;
+    int tx1, tx2, ty1, ty2;
+    int next;                   /* next tile row to compare */
+    xRectangle *rects;          /* room for a rectangle per tile */
+    int *nrects;                /* rectangles found in each tile row */
+} shadowDiffRec, *shadowDiffPtr;
+
+static inline Bool
+shadowDiffRowEqual(const CARD8 *a, const CARD8 *b, int len)
+{
+#ifdef __SSE2__
+    __m128i diff = _mm_setzero_si128();
+
+    for (; len >= 16; len -= 16, a += 16, b += 16)
+        diff = _mm_or_si128(diff,
+                            _mm_xor_si128(_mm_loadu_si128((const __m128i *) a),
+                                          _mm_loadu_si128((const __m128i *) b)));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff)
+        return FALSE;
+#endif
+    return memcmp(a, b, len) == 0;
+}
+
+/*
+ * Compare and copy the damaged tiles of tile row @ty, returning the number
+ * of rectangles covering the rows which changed
+ */
+static int
+shadowDiffTileRow(shadowDiffPtr diff, int ty)
+{
+    xRectangle *r = diff->rects + (ty - diff->ty1) * (diff->tx2 - diff->tx1);
+    int n = 0, tx, y;
+
+    for (tx = diff->tx1; tx < diff->tx2; tx++) {
+        int offset, width, first = -1, last = -1;
+        CARD8 *old, *new;
+        BoxRec box;
+
+        box.x1 = tx * SHADOW_DIFF_TILE;
+        box.y1 = ty * SHADOW_DIFF_TILE;
+        box.x2 = min(box.x1 + SHADOW_DIFF_TILE, diff->width);
+        box.y2 = min(box.y1 + SHADOW_DIFF_TILE, diff->height);
+
+        if (RegionContainsRect(diff->damage, &box) == rgnOUT)
+            continue;
+
+        offset = box.y1 * diff->stride + box.x1 * diff->cpp;
+        new = diff->new + offset;
+        old = diff->old + offset;
+        width = (box.x2 - box.x1) * diff->cpp;
+
+        for (y = 0; y < box.y2 - box.y1; y++) {
+            CARD8 *dst = old + y * diff->stride, *src = new + y * diff->stride;
+
+            if (!shadowDiffRowEqual(dst, src, width)) {
+                memcpy(dst, src, width);
+                if (first < 0)
+                    first = y;
+                last = y;
+            }
+        }
+
+        if (first >= 0) {
+            r[n].x = box.x1;
+            r[n].y = box.y1 + first;
+            r[n].width = box.x2 - box.x1;
+            r[n].height = last - first + 1;
+            n++;
+        }
+    }
+
+    return n;
+}
+
+static void
+shadowDiffRun(void *data)
+{
+    shadowDiffPtr diff = data;
+    int ty;
+
+    while ((ty = __atomic_fetch_add(&diff->next, 1, __ATOMIC_RELAXED)) <
+           diff->ty2)
+        diff->nrects[ty - diff->ty1] = shadowDiffTileRow(diff, ty);
+}
+
+/*
+ * Drop the parts of the damage of @pBuf which are identical in @copy,
+ * and bring @copy up to date.  @copy must have the layout of the shadow
+ * pixmap.  If memory runs out, the damage is left alone.
+ */
+void
+shadowDiffDamage(ScreenPtr pScreen, shadowBufPtr pBuf, void *copy)
+{
+    RegionPtr damage = DamageRegion(pBuf->pDamage), tiles;
+    PixmapPtr pShadow = pBuf->pPixmap;
+    BoxPtr extents = RegionExtents(damage);
+    shadowDiffRec diff;
+    xRectangle *prect;
+    int per_row, nrows, nrects, nthreads, i;
+
+    if (!RegionNotEmpty(damage) || pShadow->drawable.bitsPerPixel < 8)
+        return;
+
+    diff.damage = damage;
+    diff.new = pShadow->devPrivate.ptr;
+    diff.old = copy;
+    diff.stride = pShadow->devKind;
+    diff.cpp = pShadow->drawable.bitsPerPixel >> 3;
+    diff.width = pShadow->drawable.width;
+    diff.height = pShadow->drawable.height;
+    diff.tx1 = extents->x1 / SHADOW_DIFF_TILE;
+    diff.tx2 = (extents->x2 + SHADOW_DIFF_TILE - 1) / SHADOW_DIFF_TILE;
+    diff.ty1 = extents->y1 / SHADOW_DIFF_TILE;
+    diff.ty2 = (extents->y2 + SHADOW_DIFF_TILE - 1) / SHADOW_DIFF_TILE;
+    diff.next = diff.ty1;
+
+    per_row = diff.tx2 - diff.tx1;
+    nrows = diff.ty2 - diff.ty1;
+    diff.rects = prect = xallocarray(per_row * nrows, sizeof(xRectangle));
+    diff.nrects = xallocarray(nrows, sizeof(int));
+    if (!diff.rects || !diff.nrects) {
+        free(diff.rects);
+        free(diff.nrects);
+        return;
+    }
+
+    nthreads = 0;
+    if ((extents->x2 - extents->x1) * (extents->y2 - extents->y1) >=
+        SHADOW_DIFF_MIN_PIXELS)
+        nthreads = min(WorkerPoolThreads(pBuf->pool), nrows - 1);
+
+    for (i = 0; i < nthreads; i++) {
+        if (!WorkerPoolQueue(pBuf->pool, shadowDiffRun, NULL, &diff))
+            break;
+    }
+    shadowDiffRun(&diff);
+
+    /* Only the rows already taken by other threads are left */
+    if (nthreads)
+        WorkerPoolDrain(pBuf->pool);
+
+    nrects = 0;
+    for (i = 0; i < nrows; i++) {
+        memmove(prect + nrects, diff.rects + i * per_row,
+                diff.nrects[i] * sizeof(xRectangle));
+        nrects += diff.nrects[i];
+    }
+
+    tiles = RegionFromRects(nrects, prect, CT_NONE);
+    RegionIntersect(damage, damage, tiles);
+    RegionDestroy(tiles);
+    free(diff.nrects);
+    free(prect);
+}
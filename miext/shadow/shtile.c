@@ -0,0 +1,390 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Tiled shadow update for linear frame buffers.
+ *
+ * shadowUpdateTiled does the job of shadowUpdateRotatePacked for 16 and
+ * 32bpp frame buffers rotated by a multiple of 90 degrees.  The damaged
+ * region is cut into bands of SHADOW_TILE_ROWS shadow rows, which are
+ * spread over the worker threads started by shadowSetThreads when there
+ * is enough to do.  Rotated bands are copied in small square blocks, so
+ * that both the shadow reads and the frame buffer writes stay within a few
+ * cache lines, and the blocks are transposed with SSE2 where available.
+ *
+ * The window proc is called from the worker threads, and the rows it
+ * returns are expected to stay mapped: it must simply compute an address
+ * in a linearly mapped frame buffer.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include    <X11/X.h>
+#include    "scrnintstr.h"
+#include    "windowstr.h"
+#include    "regionstr.h"
+#include    "shadow.h"
+#include    "fb.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SHADOW_TILE_ROWS	64
+#define SHADOW_TILE_BLOCK	8
+
+/* Below this many damaged pixels, threads cost more than they save */
+#define SHADOW_TILE_MIN_PIXELS	(256 * 256)
+
+typedef struct {
+    ScreenPtr pScreen;
+    shadowBufPtr pBuf;
+    int rotate;
+    int shaBpp;
+    CARD8 *shaBase;
+    FbStride shaStride;         /* in bytes */
+    int shaWidth;
+    int shaHeight;
+    BoxPtr boxes;
+    int nbox;
+} shadowTileTaskRec, *shadowTileTaskPtr;
+
+static void *
+shadowTileRow(shadowTileTaskPtr task, int row, int col)
+{
+    CARD32 size;
+
+    return (*task->pBuf->window) (task->pScreen, row,
+                                  col * (task->shaBpp >> 3),
+                                  SHADOW_WINDOW_WRITE, &size,
+                                  task->pBuf->closure);
+}
+
+#ifdef __SSE2__
+
+/*
+ * Transpose a 4x4 block of 32bpp pixels, the rows of the result going to
+ * dst[0..3]; reversed, each of them is stored from right to left.
+ */
+static inline void
+shadowTileTranspose32(const CARD8 *src, FbStride stride, CARD32 **dst,
+                      int offset, Bool reverse)
+{
+    __m128i a0 = _mm_loadu_si128((const __m128i *) (src + 0 * stride));
+    __m128i a1 = _mm_loadu_si128((const __m128i *) (src + 1 * stride));
+    __m128i a2 = _mm_loadu_si128((const __m128i *) (src + 2 * stride));
+    __m128i a3 = _mm_loadu_si128((const __m128i *) (src + 3 * stride));
+    __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+    __m128i t1 = _mm_unpacklo_epi32(a2, a3);
+    __m128i t2 = _mm_unpackhi_epi32(a0, a1);
+    __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+    __m128i c[4];
+    int k;
+
+    c[0] = _mm_unpacklo_epi64(t0, t1);
+    c[1] = _mm_unpackhi_epi64(t0, t1);
+    c[2] = _mm_unpacklo_epi64(t2, t3);
+    c[3] = _mm_unpackhi_epi64(t2, t3);
+
+    for (k = 0; k < 4; k++) {
+        if (reverse)
+            c[k] = _mm_shuffle_epi32(c[k], _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i *) (dst[k] + offset), c[k]);
+    }
+}
+
+/*
+ * Same for an 8x8 block of 16bpp pixels
+ */
+static inline void
+shadowTileTranspose16(const CARD8 *src, FbStride stride, CARD16 **dst,
+                      int offset, Bool reverse)
+{
+    __m128i a[8], b[8], c[8], d[8];
+    int k;
+
+    for (k = 0; k < 8; k++)
+        a[k] = _mm_loadu_si128((const __m128i *) (src + k * stride));
+
+    b[0] = _mm_unpacklo_epi16(a[0], a[1]);
+    b[1] = _mm_unpackhi_epi16(a[0], a[1]);
+    b[2] = _mm_unpacklo_epi16(a[2], a[3]);
+    b[3] = _mm_unpackhi_epi16(a[2], a[3]);
+    b[4] = _mm_unpacklo_epi16(a[4], a[5]);
+    b[5] = _mm_unpackhi_epi16(a[4], a[5]);
+    b[6] = _mm_unpacklo_epi16(a[6], a[7]);
+    b[7] = _mm_unpackhi_epi16(a[6], a[7]);
+
+    c[0] = _mm_unpacklo_epi32(b[0], b[2]);
+    c[1] = _mm_unpackhi_epi32(b[0], b[2]);
+    c[2] = _mm_unpacklo_epi32(b[1], b[3]);
+    c[3] = _mm_unpackhi_epi32(b[1], b[3]);
+    c[4] = _mm_unpacklo_epi32(b[4], b[6]);
+    c[5] = _mm_unpackhi_epi32(b[4], b[6]);
+    c[6] = _mm_unpacklo_epi32(b[5], b[7]);
+    c[7] = _mm_unpackhi_epi32(b[5], b[7]);
+
+    d[0] = _mm_unpacklo_epi64(c[0], c[4]);
+    d[1] = _mm_unpackhi_epi64(c[0], c[4]);
+    d[2] = _mm_unpacklo_epi64(c[1], c[5]);
+    d[3] = _mm_unpackhi_epi64(c[1], c[5]);
+    d[4] = _mm_unpacklo_epi64(c[2], c[6]);
+    d[5] = _mm_unpackhi_epi64(c[2], c[6]);
+    d[6] = _mm_unpacklo_epi64(c[3], c[7]);
+    d[7] = _mm_unpackhi_epi64(c[3], c[7]);
+
+    for (k = 0; k < 8; k++) {
+        if (reverse) {
+            d[k] = _mm_shufflelo_epi16(d[k], _MM_SHUFFLE(0, 1, 2, 3));
+            d[k] = _mm_shufflehi_epi16(d[k], _MM_SHUFFLE(0, 1, 2, 3));
+            d[k] = _mm_shuffle_epi32(d[k], _MM_SHUFFLE(1, 0, 3, 2));
+        }
+        _mm_storeu_si128((__m128i *) (dst[k] + offset), d[k]);
+    }
+}
+
+#endif
+
+/*
+ * The unrotated and 180 degree cases, one frame buffer row per shadow row
+ */
+#define SHADOW_TILE_ROWS_FUNC(name, Data)				\
+static void								\
+name(shadowTileTaskPtr task, BoxPtr box)				\
+{									\
+    int w = box->x2 - box->x1;						\
+    int y, i;								\
+									\
+    for (y = box->y1; y < box->y2; y++) {				\
+        const Data *sha = (const Data *) (task->shaBase +		\
+                                          y * task->shaStride);		\
+        Data *win;							\
+									\
+        if (task->rotate == 0) {					\
+            win = shadowTileRow(task, y, box->x1);			\
+            if (!win)							\
+                return;							\
+            memcpy(win, sha + box->x1, w * sizeof(Data));		\
+        }								\
+        else {								\
+            win = shadowTileRow(task, task->shaHeight - 1 - y,		\
+                                task->shaWidth - box->x2);		\
+            if (!win)							\
+                return;							\
+            sha += box->x2 - 1;						\
+            for (i = 0; i < w; i++)					\
+                win[i] = sha[-i];					\
+        }								\
+    }									\
+}
+
+/*
+ * The 90 and 270 degree cases: each column of the shadow becomes a row of
+ * the frame buffer.  For 90 degrees, shadow column x goes to frame buffer
+ * row (width - 1 - x), left to right; for 270 degrees, to row x, right to
+ * left.
+ */
+#define SHADOW_TILE_COLUMNS_FUNC(name, Data, N, FAST, TRANSPOSE)	\
+static void								\
+name(shadowTileTaskPtr task, BoxPtr box)				\
+{									\
+    Bool reverse = task->rotate == 270;					\
+    Data *rows[SHADOW_TILE_BLOCK];					\
+    int x, y, k, j, n, m;						\
+									\
+    for (x = box->x1; x < box->x2; x += n) {				\
+        n = min(N, box->x2 - x);					\
+									\
+        /* Frame buffer pointers for the first shadow row of the box */ \
+        for (k = 0; k < n; k++) {					\
+            if (reverse)						\
+                rows[k] = shadowTileRow(task, x + k,			\
+                                        task->shaHeight - box->y2);	\
+            else							\
+                rows[k] = shadowTileRow(task,				\
+                                        task->shaWidth - 1 - (x + k),	\
+                                        box->y1);			\
+            if (!rows[k])						\
+                return;							\
+        }								\
+									\
+        for (y = box->y1; y < box->y2; y += m) {			\
+            const CARD8 *sha = task->shaBase + y * task->shaStride +	\
+                x * sizeof(Data);					\
+            int offset;							\
+									\
+            m = min(N, box->y2 - y);					\
+            offset = reverse ? box->y2 - y - m : y - box->y1;		\
+									\
+            if (FAST && n == N && m == N) {				\
+                TRANSPOSE;						\
+                continue;						\
+            }								\
+									\
+            for (k = 0; k < n; k++) {					\
+                for (j = 0; j < m; j++) {				\
+                    Data p = ((const Data *)				\
+                              (sha + j * task->shaStride))[k];		\
+									\
+                    if (reverse)					\
+                        rows[k][offset + m - 1 - j] = p;		\
+                    else						\
+                        rows[k][offset + j] = p;			\
+                }							\
+            }								\
+        }								\
+    }									\
+}
+
+SHADOW_TILE_ROWS_FUNC(shadowTileRows16, CARD16)
+SHADOW_TILE_ROWS_FUNC(shadowTileRows32, CARD32)
+
+#ifdef __SSE2__
+SHADOW_TILE_COLUMNS_FUNC(shadowTileColumns16, CARD16, 8, TRUE,
+                         shadowTileTranspose16(sha, task->shaStride, rows,
+                                               offset, reverse))
+SHADOW_TILE_COLUMNS_FUNC(shadowTileColumns32, CARD32, 4, TRUE,
+                         shadowTileTranspose32(sha, task->shaStride, rows,
+                                               offset, reverse))
+#else
+SHADOW_TILE_COLUMNS_FUNC(shadowTileColumns16, CARD16, SHADOW_TILE_BLOCK,
+                         FALSE, (void) 0)
+SHADOW_TILE_COLUMNS_FUNC(shadowTileColumns32, CARD32, SHADOW_TILE_BLOCK,
+                         FALSE, (void) 0)
+#endif
+
+static void
+shadowTileRun(void *data)
+{
+    shadowTileTaskPtr task = data;
+    void (*copy) (shadowTileTaskPtr task, BoxPtr box);
+    int i;
+
+    if (task->rotate == 0 || task->rotate == 180)
+        copy = task->shaBpp == 16 ? shadowTileRows16 : shadowTileRows32;
+    else
+        copy = task->shaBpp == 16 ? shadowTileColumns16 : shadowTileColumns32;
+
+    for (i = 0; i < task->nbox; i++)
+        copy(task, &task->boxes[i]);
+}
+
+void
+shadowUpdateTiled(ScreenPtr pScreen, shadowBufPtr pBuf)
+{
+    RegionPtr damage = DamageRegion(pBuf->pDamage);
+    PixmapPtr pShadow = pBuf->pPixmap;
+    int nbox = RegionNumRects(damage);
+    BoxPtr pbox = RegionRects(damage);
+    shadowTileTaskRec tasks[SHADOW_TILE_MAX_TASKS];
+    FbBits *shaBits;
+    FbStride shaStride;
+    int shaBpp;
+    _X_UNUSED int shaXoff, shaYoff;
+    unsigned long pixels = 0;
+    BoxPtr bands;
+    int nbands, ntasks, rotate;
+    int i, n, y;
+
+    switch (pBuf->randr) {
+    case SHADOW_ROTATE_0:
+        rotate = 0;
+        break;
+    case SHADOW_ROTATE_90:
+        rotate = 90;
+        break;
+    case SHADOW_ROTATE_180:
+        rotate = 180;
+        break;
+    case SHADOW_ROTATE_270:
+        rotate = 270;
+        break;
+    default:
+        shadowUpdateRotatePacked(pScreen, pBuf);
+        return;
+    }
+
+    fbGetDrawable(&pShadow->drawable, shaBits, shaStride, shaBpp, shaXoff,
+                  shaYoff);
+    if (shaBpp != 16 && shaBpp != 32) {
+        shadowUpdateRotatePacked(pScreen, pBuf);
+        return;
+    }
+
+    nbands = 0;
+    for (i = 0; i < nbox; i++) {
+        nbands += (pbox[i].y2 - pbox[i].y1 + SHADOW_TILE_ROWS - 1) /
+            SHADOW_TILE_ROWS;
+        pixels += (pbox[i].x2 - pbox[i].x1) * (pbox[i].y2 - pbox[i].y1);
+    }
+
+    bands = xallocarray(nbands, sizeof(BoxRec));
+    if (!bands) {
+        shadowUpdateRotatePacked(pScreen, pBuf);
+        return;
+    }
+
+    for (i = 0, n = 0; i < nbox; i++) {
+        for (y = pbox[i].y1; y < pbox[i].y2; y += SHADOW_TILE_ROWS) {
+            bands[n].x1 = pbox[i].x1;
+            bands[n].x2 = pbox[i].x2;
+            bands[n].y1 = y;
+            bands[n].y2 = min(y + SHADOW_TILE_ROWS, pbox[i].y2);
+            n++;
+        }
+    }
+
+    ntasks = 1;
+    if (pixels >= SHADOW_TILE_MIN_PIXELS) {
+        ntasks = min(WorkerPoolThreads(pBuf->pool) + 1, SHADOW_TILE_MAX_TASKS);
+        ntasks = min(ntasks, nbands);
+    }
+
+    /* Neighbouring bands go to the same thread */
+    for (i = 0; i < ntasks; i++) {
+        tasks[i].pScreen = pScreen;
+        tasks[i].pBuf = pBuf;
+        tasks[i].rotate = rotate;
+        tasks[i].shaBpp = shaBpp;
+        tasks[i].shaBase = (CARD8 *) shaBits;
+        tasks[i].shaStride = shaStride * sizeof(FbBits);
+        tasks[i].shaWidth = pShadow->drawable.width;
+        tasks[i].shaHeight = pShadow->drawable.height;
+        tasks[i].boxes = bands + i * nbands / ntasks;
+        tasks[i].nbox = (i + 1) * nbands / ntasks - i * nbands / ntasks;
+    }
+
+    for (i = 1; i < ntasks; i++) {
+        if (!WorkerPoolQueue(pBuf->pool, shadowTileRun, NULL, &tasks[i]))
+            shadowTileRun(&tasks[i]);
+    }
+    shadowTileRun(&tasks[0]);
+
+    if (ntasks > 1)
+        WorkerPoolDrain(pBuf->pool);
+
+    free(bands);
+}
@@ -1162,10 +1162,23 @@ ComputeLocalClient(ClientPtr client)
  */
 int
 GetLocalClientCreds(ClientPtr client, LocalClientCredRec ** lccp)
+{
+    if (client == NULL)
+        return -1;
+    return GetConnectionCreds(((OsCommPtr) client->osPrivate)->trans_conn,
+                              lccp);
+}
+
+/*
+ * Same as GetLocalClientCreds, for a connection which may not have a
+ * client yet.  Only looks at the connection, so it may be called from
+ * any thread.
+ */
+int
+GetConnectionCreds(XtransConnInfo ci, LocalClientCredRec ** lccp)
 {
 #if defined(HAVE_GETPEEREID) || defined(HAVE_GETPEERUCRED) || defined(SO_PEERCRED)
     int fd;
-    XtransConnInfo ci;
     LocalClientCredRec *lcc;
 
 #ifdef HAVE_GETPEEREID
@@ -1179,9 +1192,8 @@ GetLocalClientCreds(ClientPtr client, LocalClientCredRec ** lccp)
     socklen_t so_len = sizeof(peercred);
 #endif
 
-    if (client == NULL)
+    if (ci == NULL)
         return -1;
-    ci = ((OsCommPtr) client->osPrivate)->trans_conn;
 #if !(defined(__sun) && defined(HAVE_GETPEERUCRED))
     /* Most implementations can only determine peer credentials for Unix
      * domain sockets - Solaris getpeerucred can work with a bit more, so
@@ -302,6 +302,8 @@ GenerateAuthorization(unsigned name_length,
     return -1;
 }
 
+#endif                          /* XCSECURITY */
+
 void
 GenerateRandomData(int len, char *buf)
 {
@@ -315,5 +317,3 @@ GenerateRandomData(int len, char *buf)
     close(fd);
 #endif
 }
-
-#endif                          /* XCSECURITY */
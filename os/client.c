@@ -58,6 +58,7 @@
 #include "client.h"
 #include "os.h"
 #include "dixstruct.h"
+#include "osdep.h"
 
 #ifdef __sun
 #include <errno.h>
@@ -268,7 +269,56 @@ DetermineClientCmd(pid_t pid, const char **cmdname, const char **cmdargs)
 }
 
 /**
- * Called when a new client connects. Allocates client ID information.
+ * Look up the IDs of the process at the other end of a connection which
+ * has no client yet.  Only the connection and the process are looked at,
+ * so this may be called from any thread.
+ *
+ * @param[in] trans_conn Newly accepted connection.
+ *
+ * @return IDs to be handed over to the client through its OsCommRec, or
+ *         released with FreeClientIds.  NULL on allocation failure.
+ */
+ClientIdPtr
+DetermineConnectionIds(struct _XtransConnInfo *trans_conn)
+{
+    LocalClientCredRec *lcc;
+    ClientIdPtr ids;
+
+    ids = calloc(1, sizeof(ClientIdRec));
+    if (!ids)
+        return NULL;
+
+    ids->pid = -1;
+    if (GetConnectionCreds(trans_conn, &lcc) != -1) {
+        if (lcc->fieldsSet & LCC_PID_SET)
+            ids->pid = lcc->pid;
+        FreeLocalClientCreds(lcc);
+    }
+    if (ids->pid != -1)
+        DetermineClientCmd(ids->pid, &ids->cmdname, &ids->cmdargs);
+
+    return ids;
+}
+
+/**
+ * Release client ID information.
+ *
+ * @param[in] ids IDs of a client or connection, may be NULL.
+ */
+void
+FreeClientIds(ClientIdPtr ids)
+{
+    if (!ids)
+        return;
+
+    free((void *) ids->cmdname);        /* const char * */
+    free((void *) ids->cmdargs);        /* const char * */
+    free(ids);
+}
+
+/**
+ * Called when a new client connects. Allocates client ID information,
+ * unless it was already looked up when the connection was accepted.
  *
  * @param[in] client Recently connected client.
  */
@@ -276,10 +326,20 @@ void
 ReserveClientIds(struct _Client *client)
 {
 #ifdef CLIENTIDS
+    OsCommPtr oc;
+
     if (client == NullClient)
         return;
 
     assert(!client->clientIds);
+
+    oc = client->osPrivate;
+    if (client != serverClient && oc && oc->ids) {
+        client->clientIds = oc->ids;
+        oc->ids = NULL;
+        return;
+    }
+
     client->clientIds = calloc(1, sizeof(ClientIdRec));
     if (!client->clientIds)
         return;
@@ -321,9 +381,7 @@ ReleaseClientIds(struct _Client *client)
            client->clientIds->cmdname ? client->clientIds->cmdname : "NULL",
            client->clientIds->cmdargs ? client->clientIds->cmdargs : "NULL");
 
-    free((void *) client->clientIds->cmdname);  /* const char * */
-    free((void *) client->clientIds->cmdargs);  /* const char * */
-    free(client->clientIds);
+    FreeClientIds(client->clientIds);
     client->clientIds = NULL;
 #endif                          /* CLIENTIDS */
 }
@@ -106,6 +106,7 @@ SOFTWARE.
 #include "opaque.h"
 #include "dixstruct.h"
 #include "xace.h"
+#include "xserver_poll.h"
 
 #define Pid_t pid_t
 
@@ -133,6 +134,37 @@ static Pid_t ParentProcess;
 
 int GrabInProgress = 0;
 
+/* Connections accepted per listening socket and wakeup, so that a burst
+ * of new clients doesn't hold up the ones already connected */
+#define ACCEPT_BATCH 64
+
+/* How often accept statistics are logged, in microseconds */
+#define ACCEPT_REPORT_INTERVAL 10000000
+
+/* A connection on its way from accept() to a client */
+typedef struct {
+    XtransConnInfo trans_conn;
+    int fd;
+    CARD32 conn_time;
+    CARD64 ready;               /* when the listening socket became readable */
+    ClientIdPtr ids;
+} AcceptRec, *AcceptPtr;
+
+/* Looks up who is at the other end of new connections */
+static WorkerPoolPtr AcceptPool;
+
+static int AcceptQueued;        /* EstablishNewConnections work procs */
+static CARD64 AcceptReadyTime;  /* when the first of them was queued */
+
+static struct {
+    unsigned int accepted;
+    unsigned int batches;
+    unsigned int batch_max;
+    CARD64 latency;
+    CARD64 latency_max;
+    CARD64 report_time;
+} AcceptStats;
+
 static void
 QueueNewConnections(int curconn, int ready, void *data);
 
@@ -252,7 +284,8 @@ lookup_trans_conn(int fd)
     return NULL;
 }
 
-/* Set MaxClients and lastfdesc, and allocate ConnectionTranslation */
+/* Set MaxClients, and allocate ConnectionTranslation, which grows with
+ * the highest descriptor in use */
 
 void
 InitConnectionLimits(void)
@@ -265,8 +298,8 @@ InitConnectionLimits(void)
 
 #if !defined(WIN32)
     if (!ConnectionTranslation) {
-        ConnectionTranslation = xnfallocarray(MaxClients, sizeof(int));
-        ConnectionTranslationSize = MaxClients;
+        ConnectionTranslation = xnfcalloc(LIMITCLIENTS, sizeof(int));
+        ConnectionTranslationSize = LIMITCLIENTS;
     }
 #else
     InitConnectionTranslation();
@@ -716,15 +749,19 @@ ClientReady(int fd, int xevents, void *data)
     }
 }
 
+/* Takes ownership of @ids, which may be NULL */
 static ClientPtr
-AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
+AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time,
+                   ClientIdPtr ids)
 {
     OsCommPtr oc;
     ClientPtr client;
 
     oc = malloc(sizeof(OsCommRec));
-    if (!oc)
+    if (!oc) {
+        FreeClientIds(ids);
         return NullClient;
+    }
     oc->trans_conn = trans_conn;
     oc->fd = fd;
     oc->input = (ConnectionInputPtr) NULL;
@@ -732,15 +769,23 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
     oc->auth_id = None;
     oc->conn_time = conn_time;
     oc->flags = 0;
+    oc->ids = ids;
     if (!(client = NextAvailableClient((void *) oc))) {
+        FreeClientIds(oc->ids);
         free(oc);
         return NullClient;
     }
     client->local = ComputeLocalClient(client);
 #if !defined(WIN32)
     if (fd >= ConnectionTranslationSize) {
-        ConnectionTranslationSize *= 2;
-        ConnectionTranslation = xnfreallocarray(ConnectionTranslation, ConnectionTranslationSize, sizeof (int));
+        int size = ConnectionTranslationSize;
+
+        while (fd >= size)
+            size *= 2;
+        ConnectionTranslation = xnfreallocarray(ConnectionTranslation, size, sizeof (int));
+        memset(ConnectionTranslation + ConnectionTranslationSize, 0,
+               (size - ConnectionTranslationSize) * sizeof (int));
+        ConnectionTranslationSize = size;
     }
     ConnectionTranslation[fd] = client->index;
 #else
@@ -763,11 +808,107 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
     return client;
 }
 
+static void
+AcceptAccount(CARD64 ready)
+{
+    CARD64 now = GetTimeInMicros();
+
+    AcceptStats.accepted++;
+    AcceptStats.latency += now - ready;
+    AcceptStats.latency_max = max(AcceptStats.latency_max, now - ready);
+
+    if (!AcceptStats.report_time)
+        AcceptStats.report_time = now;
+    if (now - AcceptStats.report_time < ACCEPT_REPORT_INTERVAL)
+        return;
+
+    LogMessageVerb(X_INFO, 4,
+                   "Accepted %u connections in %u batches of up to %u, "
+                   "latency %llu us average, %llu us max\n",
+                   AcceptStats.accepted, AcceptStats.batches,
+                   AcceptStats.batch_max,
+                   (unsigned long long) (AcceptStats.latency /
+                                         AcceptStats.accepted),
+                   (unsigned long long) AcceptStats.latency_max);
+
+    memset(&AcceptStats, 0, sizeof(AcceptStats));
+    AcceptStats.report_time = now;
+}
+
+/* Runs on the accept thread, if there is one */
+static void
+AcceptLookup(void *data)
+{
+#ifdef CLIENTIDS
+    AcceptPtr conn = data;
+
+    conn->ids = DetermineConnectionIds(conn->trans_conn);
+#endif
+}
+
+static void
+AcceptFinish(void *data)
+{
+    AcceptPtr conn = data;
+
+    if (AllocNewConnection(conn->trans_conn, conn->fd,
+                           conn->conn_time, conn->ids))
+        AcceptAccount(conn->ready);
+    else
+        ErrorConnMax(conn->trans_conn);
+
+    free(conn);
+}
+
+/*
+ * Hand a newly accepted connection over to the accept thread, which finds
+ * out which process is at the other end: that means reading /proc, which
+ * is better kept off the main thread when lots of clients connect at
+ * once.  The client is created once that is done.  Address and
+ * authorization checks use lists changed by requests, and so stay on the
+ * main thread, in ClientAuthorized.
+ */
+static void
+AcceptNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time,
+                    CARD64 ready)
+{
+    AcceptPtr conn;
+
+    conn = calloc(1, sizeof(AcceptRec));
+    if (!conn) {
+        ErrorConnMax(trans_conn);
+        return;
+    }
+    conn->trans_conn = trans_conn;
+    conn->fd = fd;
+    conn->conn_time = conn_time;
+    conn->ready = ready;
+
+#ifdef CLIENTIDS
+    if (!AcceptPool)
+        AcceptPool = WorkerPoolCreate("accept", 1);
+    if (AcceptPool &&
+        WorkerPoolQueue(AcceptPool, AcceptLookup, AcceptFinish, conn))
+        return;
+#endif
+
+    AcceptLookup(conn);
+    AcceptFinish(conn);
+}
+
+/* Whether there is another connection to accept on @fd */
+static Bool
+ListenerPending(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    return xserver_poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
 /*****************
  * EstablishNewConnections
- *    If anyone is waiting on listened sockets, accept them.
- *    Returns a mask with indices of new clients.  Updates AllClients
- *    and AllSockets.
+ *    If anyone is waiting on listened sockets, accept them, up to
+ *    ACCEPT_BATCH at a time; the rest are taken on the next wakeup.
  *****************/
 
 static Bool
@@ -776,13 +917,18 @@ EstablishNewConnections(ClientPtr clientUnused, void *closure)
     int curconn = (int) (intptr_t) closure;
     int newconn;       /* fd of new client */
     CARD32 connect_time;
-    int i;
+    CARD64 ready;
+    int i, n;
     ClientPtr client;
     OsCommPtr oc;
     XtransConnInfo trans_conn, new_trans_conn;
     int status;
     int clientid;
 
+    ready = AcceptReadyTime;
+    if (--AcceptQueued == 0)
+        AcceptReadyTime = 0;
+
     connect_time = GetTimeInMillis();
     /* kill off stragglers */
     for (i = 1; i < currentMaxClients; i++) {
@@ -798,22 +944,33 @@ EstablishNewConnections(ClientPtr clientUnused, void *closure)
     if ((trans_conn = lookup_trans_conn(curconn)) == NULL)
         return TRUE;
 
-    if ((new_trans_conn = _XSERVTransAccept(trans_conn, &status)) == NULL)
-        return TRUE;
+    /* The listening sockets block, so only accept again once poll says
+     * there is something to accept */
+    for (n = 0; n < ACCEPT_BATCH; n++) {
+        if (n > 0 && !ListenerPending(curconn))
+            break;
 
-    newconn = _XSERVTransGetConnectionNumber(new_trans_conn);
+        if ((new_trans_conn = _XSERVTransAccept(trans_conn, &status)) == NULL)
+            break;
 
-    clientid = GetConnectionTranslation(newconn);
-    if (clientid && (client = clients[clientid]))
-        CloseDownClient(client);
+        newconn = _XSERVTransGetConnectionNumber(new_trans_conn);
+
+        clientid = GetConnectionTranslation(newconn);
+        if (clientid && (client = clients[clientid]))
+            CloseDownClient(client);
+
+        _XSERVTransSetOption(new_trans_conn, TRANS_NONBLOCKING, 1);
 
-    _XSERVTransSetOption(new_trans_conn, TRANS_NONBLOCKING, 1);
+        if (trans_conn->flags & TRANS_NOXAUTH)
+            new_trans_conn->flags = new_trans_conn->flags | TRANS_NOXAUTH;
 
-    if (trans_conn->flags & TRANS_NOXAUTH)
-        new_trans_conn->flags = new_trans_conn->flags | TRANS_NOXAUTH;
+        AcceptNewConnection(new_trans_conn, newconn, connect_time,
+                            ready ? ready : GetTimeInMicros());
+    }
 
-    if (!AllocNewConnection(new_trans_conn, newconn, connect_time)) {
-        ErrorConnMax(new_trans_conn);
+    if (n > 0) {
+        AcceptStats.batches++;
+        AcceptStats.batch_max = max(AcceptStats.batch_max, n);
     }
     return TRUE;
 }
@@ -821,7 +978,11 @@ EstablishNewConnections(ClientPtr clientUnused, void *closure)
 static void
 QueueNewConnections(int fd, int ready, void *data)
 {
-    QueueWorkProc(EstablishNewConnections, NULL, (void *) (intptr_t) fd);
+    if (!QueueWorkProc(EstablishNewConnections, NULL, (void *) (intptr_t) fd))
+        return;
+
+    if (AcceptQueued++ == 0)
+        AcceptReadyTime = GetTimeInMicros();
 }
 
 #define NOROOM "Maximum number of clients reached"
@@ -1176,7 +1337,7 @@ AddClientOnOpenFD(int fd)
 
     connect_time = GetTimeInMillis();
 
-    if (!AllocNewConnection(ciptr, fd, connect_time)) {
+    if (!AllocNewConnection(ciptr, fd, connect_time, NULL)) {
         ErrorConnMax(ciptr);
         return FALSE;
     }
@@ -86,10 +86,16 @@ OR PERFORMANCE OF THIS SOFTWARE.
 #include <stdarg.h>
 #include <stdlib.h>             /* for malloc() */
 #include <errno.h>
+#if INPUTTHREAD
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
 
 #include "input.h"
 #include "site.h"
 #include "opaque.h"
+#include "osdep.h"
 
 #ifdef WIN32
 #include <process.h>
@@ -120,6 +126,385 @@ static char *saveBuffer = NULL;
 static int bufferSize = 0, bufferUnused = 0, bufferPos = 0;
 static Bool needBuffer = TRUE;
 
+#if INPUTTHREAD
+
+/*
+ * Messages are handed to a writer thread through a ring, so that the
+ * threads logging them don't wait for the terminal or the log file.  Any
+ * thread or signal handler reserves room for its message by moving the
+ * head forward, copies the message in and marks it complete; the writer
+ * takes complete messages from the tail in order, and clears them before
+ * handing their space back, so that a header reserved but not yet
+ * written reads as incomplete.  Neither side takes a lock.
+ *
+ * When the ring is full, messages are counted and dropped, except those
+ * shown at any verbosity, which are written directly.
+ */
+#define LOG_RING_SIZE           (256 * 1024)    /* a power of two */
+
+#define LOG_RING_STDERR         0x1
+#define LOG_RING_FILE           0x2
+#define LOG_RING_COMPLETE       0x4
+
+typedef struct {
+    CARD32 len;                 /* of the message */
+    CARD16 stamp;               /* length of the time stamp before it */
+    CARD16 flags;
+} LogRecordRec, *LogRecordPtr;
+
+#define LogRecordSize(stamp, len) \
+    (sizeof(LogRecordRec) + (((stamp) + (len) + 7) & ~7))
+
+#define LogLoad(p)      __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define LogStore(p, v)  __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+static CARD64 logRingData[LOG_RING_SIZE / sizeof(CARD64)];
+#define logRing ((char *) logRingData)
+
+/* Byte counts, taken modulo the ring size */
+static unsigned long logRingHead;       /* reserved */
+static unsigned long logRingTail;       /* taken by the writer */
+static unsigned long logRingDone;       /* written out */
+
+static unsigned logDropped;
+static Bool logAsync;
+static Bool logWriterSleeping;
+static Bool logWriterQuit;
+static Bool logWriterStarted;
+static pthread_t logWriter;
+static int logWakeRead = -1, logWakeWrite = -1;
+
+static void
+LogRingCopyIn(unsigned long pos, const char *buf, size_t len)
+{
+    size_t off = pos % LOG_RING_SIZE;
+    size_t n = min(len, LOG_RING_SIZE - off);
+
+    memcpy(logRing + off, buf, n);
+    memcpy(logRing, buf + n, len - n);
+}
+
+static void
+LogRingCopyOut(unsigned long pos, char *buf, size_t len)
+{
+    size_t off = pos % LOG_RING_SIZE;
+    size_t n = min(len, LOG_RING_SIZE - off);
+
+    memcpy(buf, logRing + off, n);
+    memcpy(buf + n, logRing, len - n);
+}
+
+/* Clear a consumed record, so that no stale flags show up in a header */
+static void
+LogRingClear(unsigned long pos, size_t len)
+{
+    size_t off = pos % LOG_RING_SIZE;
+    size_t n = min(len, LOG_RING_SIZE - off);
+
+    memset(logRing + off, 0, n);
+    memset(logRing, 0, len - n);
+}
+
+static void
+LogWakeWriter(void)
+{
+    char byte = 0;
+    int ret;
+
+    ret = write(logWakeWrite, &byte, 1);
+    (void) ret;
+}
+
+/* Signal safe */
+static Bool
+LogRingPut(int flags, const char *stamp, int stamp_len,
+           const char *buf, size_t len)
+{
+    unsigned long head, size = LogRecordSize(stamp_len, len);
+    LogRecordPtr rec;
+
+    head = __atomic_load_n(&logRingHead, __ATOMIC_RELAXED);
+    do {
+        if (head + size - LogLoad(&logRingTail) > LOG_RING_SIZE)
+            return FALSE;
+    } while (!__atomic_compare_exchange_n(&logRingHead, &head, head + size,
+                                          TRUE, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+
+    rec = (LogRecordPtr) (logRing + head % LOG_RING_SIZE);
+    rec->len = len;
+    rec->stamp = stamp_len;
+    LogRingCopyIn(head + sizeof(LogRecordRec), stamp, stamp_len);
+    LogRingCopyIn(head + sizeof(LogRecordRec) + stamp_len, buf, len);
+
+    /* Pairs with the writer going to sleep */
+    __atomic_store_n(&rec->flags, flags | LOG_RING_COMPLETE, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&logWriterSleeping, FALSE, __ATOMIC_SEQ_CST))
+        LogWakeWriter();
+
+    return TRUE;
+}
+
+static void
+LogWriteAll(int fd, const char *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len > 0) {
+        ret = write(fd, buf, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return;
+        buf += ret;
+        len -= ret;
+    }
+}
+
+/*
+ * Add @len bytes of the ring at @pos to the staging buffer @buf, writing
+ * out what is staged first if they don't fit, and bypassing the buffer
+ * for a piece larger than it.
+ */
+static void
+LogRingStage(int fd, char *buf, size_t bufsize, size_t *buflen,
+             unsigned long pos, size_t len)
+{
+    size_t off, n;
+
+    if (*buflen + len > bufsize) {
+        LogWriteAll(fd, buf, *buflen);
+        *buflen = 0;
+    }
+
+    if (len <= bufsize) {
+        LogRingCopyOut(pos, buf + *buflen, len);
+        *buflen += len;
+        return;
+    }
+
+    off = pos % LOG_RING_SIZE;
+    n = min(len, LOG_RING_SIZE - off);
+    LogWriteAll(fd, logRing + off, n);
+    LogWriteAll(fd, logRing, len - n);
+}
+
+/* Whether the record at @tail stays within what was reserved */
+static Bool
+LogRecordValid(LogRecordPtr rec, unsigned long tail)
+{
+    return rec->len <= LOG_RING_SIZE &&
+        LogRecordSize(rec->stamp, rec->len) <= LogLoad(&logRingHead) - tail;
+}
+
+static Bool
+LogRingReady(unsigned long tail)
+{
+    LogRecordPtr rec = (LogRecordPtr) (logRing + tail % LOG_RING_SIZE);
+
+    return tail != LogLoad(&logRingHead) &&
+        (__atomic_load_n(&rec->flags, __ATOMIC_SEQ_CST) & LOG_RING_COMPLETE);
+}
+
+static void *
+LogWriterThread(void *arg)
+{
+    char errbuf[8192], filebuf[32768], msg[64];
+    size_t errlen, filelen, size;
+    unsigned long tail = logRingTail;
+    unsigned dropped;
+    LogRecordPtr rec;
+    Bool broken = FALSE;
+    sigset_t set;
+    int flags;
+
+    /* Don't handle any signals on this thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np (pthread_self(), "log");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np ("log");
+#endif
+
+    for (;;) {
+        errlen = filelen = 0;
+
+        while (LogRingReady(tail)) {
+            rec = (LogRecordPtr) (logRing + tail % LOG_RING_SIZE);
+
+            /* Can't happen as long as consumed records are cleared; if it
+             * does, there is no telling where the next record starts, so
+             * give up on the ring and have messages written directly.
+             */
+            if (!LogRecordValid(rec, tail)) {
+                LogStore(&logAsync, FALSE);
+                broken = TRUE;
+                break;
+            }
+
+            flags = rec->flags;
+            size = rec->stamp + rec->len;
+
+            if ((flags & LOG_RING_STDERR) && rec->len)
+                LogRingStage(2, errbuf, sizeof(errbuf), &errlen,
+                             tail + sizeof(LogRecordRec) + rec->stamp,
+                             rec->len);
+            if ((flags & LOG_RING_FILE) && logFileFd >= 0)
+                LogRingStage(logFileFd, filebuf, sizeof(filebuf), &filelen,
+                             tail + sizeof(LogRecordRec), size);
+
+            /* Producers may reuse the space once the tail moves past it */
+            size = LogRecordSize(rec->stamp, rec->len);
+            LogRingClear(tail, size);
+            tail += size;
+            LogStore(&logRingTail, tail);
+        }
+
+        LogWriteAll(2, errbuf, errlen);
+        if (logFileFd >= 0) {
+            LogWriteAll(logFileFd, filebuf, filelen);
+            dropped = __atomic_exchange_n(&logDropped, 0, __ATOMIC_RELAXED);
+            if (dropped) {
+                snprintf(msg, sizeof(msg),
+                         "(WW) %u log messages dropped\n", dropped);
+                LogWriteAll(logFileFd, msg, strlen(msg));
+            }
+            if (filelen && logFlush && logSync)
+                fsync(logFileFd);
+        }
+        LogStore(&logRingDone, tail);
+
+        if (broken || LogLoad(&logWriterQuit))
+            break;
+
+        /* Pairs with LogRingPut */
+        __atomic_store_n(&logWriterSleeping, TRUE, __ATOMIC_SEQ_CST);
+        if (LogRingReady(tail) || LogLoad(&logWriterQuit))
+            __atomic_store_n(&logWriterSleeping, FALSE, __ATOMIC_SEQ_CST);
+        else
+            while (read(logWakeRead, msg, sizeof(msg)) < 0 && errno == EINTR);
+    }
+
+    return NULL;
+}
+
+/*
+ * Stop queueing messages, and give the writer up to a second to write
+ * out what is already queued; a message interrupted by the caller, from a
+ * signal handler, will never be completed.  Signal safe.
+ */
+static void
+LogDrain(void)
+{
+    struct timespec delay = { 0, 1000000 };
+    unsigned long head;
+    int i;
+
+    if (!logAsync)
+        return;
+    LogStore(&logAsync, FALSE);
+
+    head = LogLoad(&logRingHead);
+    LogWakeWriter();
+    for (i = 0; i < 1000 && (long) (head - LogLoad(&logRingDone)) > 0; i++)
+        nanosleep(&delay, NULL);
+}
+
+static void
+LogThreadFini(void)
+{
+    if (!logWriterStarted)
+        return;
+
+    LogDrain();
+    LogStore(&logWriterQuit, TRUE);
+    LogWakeWriter();
+    pthread_join(logWriter, NULL);
+    logWriterStarted = FALSE;
+
+    close(logWakeRead);
+    close(logWakeWrite);
+    logWakeRead = logWakeWrite = -1;
+}
+
+/**
+ * Start the thread writing out log messages.  Until it runs, and once the
+ * log has been closed, messages are written by the threads logging them.
+ */
+void
+LogThreadInit(void)
+{
+    static Bool registered;
+    int fds[2];
+
+    if (logWriterStarted)
+        return;
+
+    if (pipe(fds) < 0)
+        return;
+    logWakeRead = fds[0];
+    logWakeWrite = fds[1];
+    fcntl(logWakeRead, F_SETFD, FD_CLOEXEC);
+    fcntl(logWakeWrite, F_SETFL, O_NONBLOCK);
+    fcntl(logWakeWrite, F_SETFD, FD_CLOEXEC);
+
+    logWriterQuit = FALSE;
+    logWriterSleeping = FALSE;
+    if (pthread_create(&logWriter, NULL, LogWriterThread, NULL) != 0) {
+        close(logWakeRead);
+        close(logWakeWrite);
+        logWakeRead = logWakeWrite = -1;
+        return;
+    }
+    logWriterStarted = TRUE;
+    LogStore(&logAsync, TRUE);
+
+    /* Don't lose what is queued when something calls exit() */
+    if (!registered)
+        registered = atexit(LogDrain) == 0;
+}
+
+/*
+ * Queue a message for the writer thread.  Returns FALSE if it has to be
+ * written directly.
+ */
+static Bool
+LogQueue(int verb, const char *buf, size_t len, Bool *newline, Bool end_line)
+{
+    char stamp[32];
+    int stamp_len = 0, flags = 0;
+
+    if (!LogLoad(&logAsync))
+        return FALSE;
+
+    if (verb < 0 || logVerbosity >= verb)
+        flags |= LOG_RING_STDERR;
+    if ((verb < 0 || logFileVerbosity >= verb) && logFileFd >= 0)
+        flags |= LOG_RING_FILE;
+    if (!flags)
+        return TRUE;
+
+    /* Like the direct path, only stamp lines outside of signal handlers */
+    if ((flags & LOG_RING_FILE) && !inSignalContext && *newline)
+        stamp_len = snprintf(stamp, sizeof(stamp), "[%10.3f] ",
+                             GetTimeInMillis() / 1000.0);
+
+    if (!LogRingPut(flags, stamp, stamp_len, buf, len)) {
+        if (verb <= 0)
+            return FALSE;
+        __atomic_add_fetch(&logDropped, 1, __ATOMIC_RELAXED);
+        return TRUE;
+    }
+
+    if ((flags & LOG_RING_FILE) && !inSignalContext)
+        *newline = end_line;
+    return TRUE;
+}
+
+#endif /* INPUTTHREAD */
+
 #ifdef __APPLE__
 #include <AvailabilityMacros.h>
 
@@ -245,6 +630,12 @@ const char *
 LogInit(const char *fname, const char *backup)
 {
     char *logFileName = NULL;
+#if INPUTTHREAD
+    Bool async = logAsync;
+
+    /* The writer must not see the file change under it */
+    LogDrain();
+#endif
 
     if (fname && *fname) {
         if (displayfd != -1) {
@@ -290,6 +681,11 @@ LogInit(const char *fname, const char *backup)
     }
     needBuffer = FALSE;
 
+#if INPUTTHREAD
+    if (async)
+        LogStore(&logAsync, TRUE);
+#endif
+
     return logFileName;
 }
 
@@ -332,6 +728,9 @@ LogClose(enum ExitCode error)
                 "Server terminated %s (%d). Closing log file.\n",
                 (error == EXIT_NO_ERROR) ? "successfully" : "with error",
                 error);
+#if INPUTTHREAD
+        LogThreadFini();
+#endif
         fclose(logFile);
         logFile = NULL;
         logFileFd = -1;
@@ -598,6 +997,11 @@ LogSWrite(int verb, const char *buf, size_t len, Bool end_line)
     static Bool newline = TRUE;
     int ret;
 
+#if INPUTTHREAD
+    if (LogQueue(verb, buf, len, &newline, end_line))
+        return;
+#endif
+
     if (verb < 0 || logVerbosity >= verb)
         ret = write(2, buf, len);
 
@@ -865,6 +1269,9 @@ AbortServer(void)
 void
 AbortServer(void)
 {
+#if INPUTTHREAD
+    LogDrain();
+#endif
 #ifdef XF86BIGFONT
     XF86BigfontCleanup();
 #endif
@@ -984,6 +1391,11 @@ FatalError(const char *f, ...)
     va_list args2;
     static Bool beenhere = FALSE;
 
+#if INPUTTHREAD
+    /* Get what led up to this out first, and write the rest directly */
+    LogDrain();
+#endif
+
     if (beenhere)
         ErrorFSigSafe("\nFatalError re-entered, aborting\n");
     else
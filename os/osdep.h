@@ -59,6 +59,8 @@ SOFTWARE.
 #include <stddef.h>
 #include <X11/Xos.h>
 
+#include "client.h"
+
 /* If EAGAIN and EWOULDBLOCK are distinct errno values, then we check errno
  * for both EAGAIN and EWOULDBLOCK, because some supposedly POSIX
  * systems are broken and return EWOULDBLOCK when they should return EAGAIN
@@ -119,6 +121,8 @@ typedef struct _osComm {
     CARD32 conn_time;           /* timestamp if not established, else 0  */
     struct _XtransConnInfo *trans_conn; /* transport connection object */
     int flags;
+    ClientIdPtr ids;            /* looked up on accept, until the client
+                                   takes them */
 } OsCommRec, *OsCommPtr;
 
 #define OS_COMM_GRAB_IMPERVIOUS 1
@@ -168,9 +172,17 @@ extern int mffs(fd_mask);
 
 /* in access.c */
 extern Bool ComputeLocalClient(ClientPtr client);
+extern int GetConnectionCreds(struct _XtransConnInfo *ci,
+                              LocalClientCredRec ** lccp);
+
+/* in client.c */
+extern ClientIdPtr DetermineConnectionIds(struct _XtransConnInfo *trans_conn);
+extern void FreeClientIds(ClientIdPtr ids);
 
-/* in auth.c */
-extern void GenerateRandomData(int len, char *buf);
+/* in log.c */
+#if INPUTTHREAD
+extern void LogThreadInit(void);
+#endif
 
 /* in mitauth.c */
 extern XID MitCheckCookie(AuthCheckArgs);
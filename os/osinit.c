@@ -319,6 +319,9 @@ OsInit(void)
      * log file name if logging to a file is desired.
      */
     LogInit(NULL, NULL);
+#if INPUTTHREAD
+    LogThreadInit();
+#endif
     SmartScheduleInit();
 }
 
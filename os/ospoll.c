@@ -32,6 +32,9 @@
 #include "ospoll.h"
 #include "list.h"
 
+/* Grown by doubling; clients beyond the default limit are rare */
+#define OSPOLL_INITIAL_SIZE     (LIMITCLIENTS * 2)
+
 #if !HAVE_OSPOLL && HAVE_EPOLL_CREATE1
 #include <sys/epoll.h>
 #define EPOLL           1
@@ -226,7 +229,7 @@ ospoll_add(struct ospoll *ospoll, int fd,
 
         if (ospoll->num >= ospoll->size) {
             struct ospollfd **new_fds;
-            int new_size = ospoll->size ? ospoll->size * 2 : MAXCLIENTS * 2;
+            int new_size = ospoll->size ? ospoll->size * 2 : OSPOLL_INITIAL_SIZE;
 
             new_fds = reallocarray(ospoll->fds, new_size, sizeof (ospoll->fds[0]));
             if (!new_fds) {
@@ -264,7 +267,7 @@ ospoll_add(struct ospoll *ospoll, int fd,
         if (ospoll->num == ospoll->size) {
             struct pollfd   *new_fds;
             struct ospollfd *new_osfds;
-            int             new_size = ospoll->size ? ospoll->size * 2 : MAXCLIENTS * 2;
+            int             new_size = ospoll->size ? ospoll->size * 2 : OSPOLL_INITIAL_SIZE;
 
             new_fds = reallocarray(ospoll->fds, new_size, sizeof (ospoll->fds[0]));
             if (!new_fds)
@@ -109,6 +109,12 @@ __stdcall unsigned long GetTickCount(void);
 #include "xkbsrv.h"
 
 #include "picture.h"
+#ifdef PRESENT
+#include "present.h"
+#endif
+#ifdef MITSHM
+#include "shmint.h"
+#endif
 
 Bool noTestExtensions;
 
@@ -176,6 +182,11 @@ Bool noDRI2Extension = FALSE;
 
 Bool noGEExtension = FALSE;
 
+#ifdef PRESENT
+Bool present_mailbox = FALSE;
+int present_max_queue_depth = 0;
+#endif
+
 #define X_INCLUDE_NETDB_H
 #include <X11/Xos_r.h>
 
@@ -545,12 +556,17 @@ UseMsg(void)
     ErrorF("-nolock                disable the locking mechanism\n");
 #endif
     ErrorF("-maxclients n          set maximum number of clients (power of two)\n");
+    ErrorF("-motionhistory n       motion events kept per input device\n");
     ErrorF("-nolisten string       don't listen on protocol\n");
     ErrorF("-listen string         listen on protocol\n");
     ErrorF("-noreset               don't reset after last client exists\n");
     ErrorF("-background [none]     create root window with no background\n");
     ErrorF("-reset                 reset after last client exists\n");
     ErrorF("-p #                   screen-saver pattern duration (minutes)\n");
+#ifdef PRESENT
+    ErrorF("-presentmailbox        replace pending Present frames for the same MSC\n");
+    ErrorF("-presentqueue int      maximum pending Present frames per window\n");
+#endif
     ErrorF("-pn                    accept failure to listen on all ports\n");
     ErrorF("-nopn                  reject failure to listen on all ports\n");
     ErrorF("-r                     turns off auto-repeat\n");
@@ -559,6 +575,9 @@ UseMsg(void)
     ErrorF("-retro                 start with classic stipple and cursor\n");
     ErrorF("-s #                   screen-saver timeout (minutes)\n");
     ErrorF("-seat string           seat to run on\n");
+#ifdef MITSHM
+    ErrorF("-shmasync bytes        copy large MIT-SHM images on a worker thread\n");
+#endif
     ErrorF("-t #                   default pointer threshold (pixels/t)\n");
     ErrorF("-terminate             terminate at server reset\n");
     ErrorF("-to #                  connection time out\n");
@@ -853,17 +872,19 @@ ProcessCommandLine(int argc, char *argv[])
 	{
 	    if (++i < argc) {
 		LimitClients = atoi(argv[i]);
-		if (LimitClients != 64 &&
-		    LimitClients != 128 &&
-		    LimitClients != 256 &&
-		    LimitClients != 512 &&
-                    LimitClients != 1024 &&
-                    LimitClients != 2048) {
-		    FatalError("maxclients must be one of 64, 128, 256, 512, 1024 or 2048\n");
+		if (LimitClients < 64 || LimitClients > MAXCLIENTS) {
+		    FatalError("maxclients must be between 64 and %d\n",
+			       MAXCLIENTS);
 		}
 	    } else
 		UseMsg();
 	}
+        else if (strcmp(argv[i], "-motionhistory") == 0) {
+            if (++i < argc && atoi(argv[i]) >= 0)
+                motionHistorySize = atoi(argv[i]);
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-nolisten") == 0) {
             if (++i < argc) {
                 if (_XSERVTransNoListen(argv[i]))
@@ -895,6 +916,20 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+#ifdef PRESENT
+        else if (strcmp(argv[i], "-presentmailbox") == 0) {
+            present_mailbox = TRUE;
+        }
+        else if (strcmp(argv[i], "-presentqueue") == 0) {
+            if (++i < argc) {
+                present_max_queue_depth = atoi(argv[i]);
+                if (present_max_queue_depth < 0)
+                    FatalError("presentqueue must not be negative\n");
+            }
+            else
+                UseMsg();
+        }
+#endif
         else if (strcmp(argv[i], "-pogo") == 0) {
             dispatchException = DE_TERMINATE;
         }
@@ -915,6 +950,14 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+#ifdef MITSHM
+        else if (strcmp(argv[i], "-shmasync") == 0) {
+            if (++i < argc)
+                ShmAsyncThreshold = strtoul(argv[i], NULL, 0);
+            else
+                UseMsg();
+        }
+#endif
         else if (strcmp(argv[i], "-seat") == 0) {
             if (++i < argc)
                 SeatId = argv[i];
@@ -2114,9 +2157,9 @@ os_move_fd(int fd)
     int newfd;
 
 #ifdef F_DUPFD_CLOEXEC
-    newfd = fcntl(fd, F_DUPFD_CLOEXEC, MAXCLIENTS);
+    newfd = fcntl(fd, F_DUPFD_CLOEXEC, LimitClients);
 #else
-    newfd = fcntl(fd, F_DUPFD, MAXCLIENTS);
+    newfd = fcntl(fd, F_DUPFD, LimitClients);
 #endif
     if (newfd < 0)
         return fd;
@@ -0,0 +1,373 @@
+/* workerthread.c -- Offload work from the main thread.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "os.h"
+#include "list.h"
+
+/**
+ * A pool of worker threads executing tasks queued by the main thread.
+ *
+ * Each task consists of a function run on one of the worker threads and
+ * an optional completion function run afterwards on the main thread,
+ * either from the notify fd handler or from WorkerPoolDrain. Tasks are
+ * started in the order they were queued; with a single thread they also
+ * complete in that order.
+ *
+ * Without thread support, tasks are run synchronously when queued.
+ */
+
+typedef struct _WorkerTask {
+    struct xorg_list entry;
+    WorkerTaskProcPtr task;
+    WorkerTaskProcPtr done;
+    void *data;
+} WorkerTaskRec, *WorkerTaskPtr;
+
+struct _WorkerPool {
+    char *name;
+    int nthreads;
+    int pending;                /* queued or running */
+    struct xorg_list queued;
+    struct xorg_list finished;
+#if INPUTTHREAD
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t idle_cond;
+    int readPipe;
+    int writePipe;
+    Bool running;
+#endif
+};
+
+static void
+WorkerPoolRunTask(WorkerTaskPtr task)
+{
+    (*task->task) (task->data);
+    if (task->done)
+        (*task->done) (task->data);
+    free(task);
+}
+
+#if INPUTTHREAD
+
+static void *
+WorkerThreadDoWork(void *arg)
+{
+    WorkerPoolPtr pool = arg;
+    WorkerTaskPtr task;
+    sigset_t set;
+    char byte = 0;
+
+    /* Don't handle any signals on this thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np (pthread_self(), pool->name);
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np (pool->name);
+#endif
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->running && xorg_list_is_empty(&pool->queued))
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+
+        if (xorg_list_is_empty(&pool->queued))
+            break;
+
+        task = xorg_list_first_entry(&pool->queued, WorkerTaskRec, entry);
+        xorg_list_del(&task->entry);
+        pthread_mutex_unlock(&pool->lock);
+
+        (*task->task) (task->data);
+
+        pthread_mutex_lock(&pool->lock);
+        xorg_list_append(&task->entry, &pool->finished);
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->idle_cond);
+
+        /* Kick the main thread to run the completion function */
+        while (write(pool->writePipe, &byte, 1) < 0 && errno == EINTR);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/*
+ * Run the completion functions of all finished tasks
+ */
+static void
+WorkerPoolDispatch(WorkerPoolPtr pool)
+{
+    struct xorg_list finished;
+    WorkerTaskPtr task, tmp;
+
+    xorg_list_init(&finished);
+
+    pthread_mutex_lock(&pool->lock);
+    if (!xorg_list_is_empty(&pool->finished)) {
+        xorg_list_append(&finished, &pool->finished);
+        xorg_list_del(&pool->finished);
+        xorg_list_init(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    xorg_list_for_each_entry_safe(task, tmp, &finished, entry) {
+        xorg_list_del(&task->entry);
+        if (task->done)
+            (*task->done) (task->data);
+        free(task);
+    }
+}
+
+static void
+WorkerPoolNotifyPipe(int fd, int ready, void *data)
+{
+    WorkerPoolPtr pool = data;
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0);
+    WorkerPoolDispatch(pool);
+}
+
+static Bool
+WorkerPoolStart(WorkerPoolPtr pool)
+{
+    int fds[2];
+    int i;
+
+    if (pipe(fds) < 0)
+        return FALSE;
+
+    pool->readPipe = fds[0];
+    pool->writePipe = fds[1];
+    fcntl(pool->readPipe, F_SETFL, O_NONBLOCK);
+    fcntl(pool->readPipe, F_SETFD, FD_CLOEXEC);
+    fcntl(pool->writePipe, F_SETFL, O_NONBLOCK);
+    fcntl(pool->writePipe, F_SETFD, FD_CLOEXEC);
+
+    pool->threads = calloc(pool->nthreads, sizeof(pthread_t));
+    if (!pool->threads)
+        goto bail;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    pool->running = TRUE;
+
+    for (i = 0; i < pool->nthreads; i++) {
+        if (pthread_create(&pool->threads[i], NULL,
+                           WorkerThreadDoWork, pool) != 0)
+            break;
+    }
+
+    if (i == 0) {
+        pthread_cond_destroy(&pool->idle_cond);
+        pthread_cond_destroy(&pool->work_cond);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->threads);
+        pool->threads = NULL;
+        goto bail;
+    }
+    pool->nthreads = i;
+
+    SetNotifyFd(pool->readPipe, WorkerPoolNotifyPipe, X_NOTIFY_READ, pool);
+    return TRUE;
+
+bail:
+    close(pool->readPipe);
+    close(pool->writePipe);
+    pool->readPipe = -1;
+    pool->writePipe = -1;
+    return FALSE;
+}
+
+#endif /* INPUTTHREAD */
+
+/**
+ * Number of threads to start for work which can use all CPUs: one per
+ * online CPU, but no more than @max if it is positive.
+ */
+int
+WorkerPoolDefaultThreads(int max)
+{
+    int nthreads = 0;
+
+#ifdef _SC_NPROCESSORS_ONLN
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (nthreads <= 0)
+        nthreads = 1;
+    if (max > 0 && nthreads > max)
+        nthreads = max;
+    return nthreads;
+}
+
+/**
+ * Create a pool of @nthreads worker threads; zero or less selects one
+ * thread per online CPU. Returns NULL only on allocation failure; if the
+ * threads cannot be started the pool runs tasks synchronously.
+ */
+WorkerPoolPtr
+WorkerPoolCreate(const char *name, int nthreads)
+{
+    WorkerPoolPtr pool;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->name = strdup(name);
+    if (!pool->name) {
+        free(pool);
+        return NULL;
+    }
+
+    if (nthreads <= 0)
+        nthreads = WorkerPoolDefaultThreads(0);
+    pool->nthreads = nthreads;
+    xorg_list_init(&pool->queued);
+    xorg_list_init(&pool->finished);
+
+#if INPUTTHREAD
+    if (!WorkerPoolStart(pool)) {
+        ErrorF("%s: could not start worker threads, running synchronously\n",
+               name);
+        pool->nthreads = 0;
+    }
+#else
+    pool->nthreads = 0;
+#endif
+
+    return pool;
+}
+
+/**
+ * Wait for all queued tasks and run their completion functions
+ */
+void
+WorkerPoolDrain(WorkerPoolPtr pool)
+{
+#if INPUTTHREAD
+    if (!pool || !pool->nthreads)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending)
+        pthread_cond_wait(&pool->idle_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    WorkerPoolDispatch(pool);
+#endif
+}
+
+void
+WorkerPoolDestroy(WorkerPoolPtr pool)
+{
+    if (!pool)
+        return;
+
+#if INPUTTHREAD
+    if (pool->nthreads) {
+        int i;
+
+        WorkerPoolDrain(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->running = FALSE;
+        pthread_cond_broadcast(&pool->work_cond);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (i = 0; i < pool->nthreads; i++)
+            pthread_join(pool->threads[i], NULL);
+
+        RemoveNotifyFd(pool->readPipe);
+        close(pool->readPipe);
+        close(pool->writePipe);
+
+        pthread_cond_destroy(&pool->idle_cond);
+        pthread_cond_destroy(&pool->work_cond);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->threads);
+    }
+#endif
+
+    free(pool->name);
+    free(pool);
+}
+
+/**
+ * Queue @task to run on a worker thread with @data. Once it has run,
+ * @done (if not NULL) is called with @data on the main thread.
+ */
+Bool
+WorkerPoolQueue(WorkerPoolPtr pool, WorkerTaskProcPtr task,
+                WorkerTaskProcPtr done, void *data)
+{
+    WorkerTaskPtr t;
+
+    t = malloc(sizeof(*t));
+    if (!t)
+        return FALSE;
+
+    t->task = task;
+    t->done = done;
+    t->data = data;
+
+    if (!pool->nthreads) {
+        WorkerPoolRunTask(t);
+        return TRUE;
+    }
+
+#if INPUTTHREAD
+    pthread_mutex_lock(&pool->lock);
+    xorg_list_append(&t->entry, &pool->queued);
+    pool->pending++;
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+#endif
+    return TRUE;
+}
+
+/**
+ * Number of threads in the pool; zero when tasks run synchronously
+ */
+int
+WorkerPoolThreads(WorkerPoolPtr pool)
+{
+    return pool ? pool->nthreads : 0;
+}
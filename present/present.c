@@ -771,6 +771,29 @@ present_execute(present_vblank_ptr vblank, uint64_t ust, uint64_t crtc_msc)
     present_vblank_destroy(vblank);
 }
 
+/*
+ * A newer presentation has superseded this queued one; release the
+ * pixmap right away and let the vblank complete as a skip
+ */
+static void
+present_vblank_skip(present_vblank_ptr vblank)
+{
+    DebugPresent(("\tx %lld %p %8lld: %08lx -> %08lx (crtc %p)\n",
+                  vblank->event_id, vblank, vblank->target_msc,
+                  vblank->pixmap->drawable.id, vblank->window->drawable.id,
+                  vblank->crtc));
+
+    present_pixmap_idle(vblank->pixmap, vblank->window, vblank->serial, vblank->idle_fence);
+    present_fence_destroy(vblank->idle_fence);
+    dixDestroyPixmap(vblank->pixmap, vblank->pixmap->drawable.id);
+
+    vblank->pixmap = NULL;
+    vblank->idle_fence = NULL;
+    vblank->flip = FALSE;
+    if (vblank->flip_ready)
+        present_re_execute(vblank);
+}
+
 int
 present_pixmap(WindowPtr window,
                PixmapPtr pixmap,
@@ -797,6 +820,8 @@ present_pixmap(WindowPtr window,
     ScreenPtr                   screen = window->drawable.pScreen;
     present_window_priv_ptr     window_priv = present_get_window_priv(window, TRUE);
     present_screen_priv_ptr     screen_priv = present_screen_priv(screen);
+    RegionPtr                   merged_update = NULL;
+    Bool                        full_update = FALSE;
 
     if (!window_priv)
         return BadAlloc;
@@ -848,7 +873,7 @@ present_pixmap(WindowPtr window,
      * in the same frame
      */
 
-    if (!update && pixmap) {
+    if (pixmap && (!update || present_mailbox)) {
         xorg_list_for_each_entry_safe(vblank, tmp, &window_priv->vblank, window_list) {
 
             if (!vblank->pixmap)
@@ -860,26 +885,66 @@ present_pixmap(WindowPtr window,
             if (vblank->crtc != target_crtc || vblank->target_msc != target_msc)
                 continue;
 
-            DebugPresent(("\tx %lld %p %8lld: %08lx -> %08lx (crtc %p)\n",
-                          vblank->event_id, vblank, vblank->target_msc,
-                          vblank->pixmap->drawable.id, vblank->window->drawable.id,
-                          vblank->crtc));
+            /* In mailbox mode, the replacement must also cover
+             * whatever the superseded presentation would have updated
+             */
+            if (update && !full_update) {
+                if (!vblank->update) {
+                    full_update = TRUE;
+                } else {
+                    RegionRec   superseded;
+
+                    if (!merged_update) {
+                        merged_update = RegionDuplicate(update);
+                        if (!merged_update)
+                            return BadAlloc;
+                    }
+                    RegionNull(&superseded);
+                    if (!RegionCopy(&superseded, vblank->update)) {
+                        RegionDestroy(merged_update);
+                        return BadAlloc;
+                    }
+                    RegionTranslate(&superseded,
+                                    vblank->x_off - x_off, vblank->y_off - y_off);
+                    RegionUnion(merged_update, merged_update, &superseded);
+                    RegionUninit(&superseded);
+                }
+            }
 
-            present_pixmap_idle(vblank->pixmap, vblank->window, vblank->serial, vblank->idle_fence);
-            present_fence_destroy(vblank->idle_fence);
-            dixDestroyPixmap(vblank->pixmap, vblank->pixmap->drawable.id);
+            present_vblank_skip(vblank);
+        }
+    }
 
-            vblank->pixmap = NULL;
-            vblank->idle_fence = NULL;
-            vblank->flip = FALSE;
-            if (vblank->flip_ready)
-                present_re_execute(vblank);
+    /*
+     * Enforce the maximum queue depth by dropping the oldest pending
+     * presentations for this window
+     */
+    if (pixmap && present_max_queue_depth > 0) {
+        int depth = 0;
+
+        xorg_list_for_each_entry(vblank, &window_priv->vblank, window_list) {
+            if (vblank->pixmap && vblank->queued)
+                depth++;
+        }
+
+        xorg_list_for_each_entry_safe(vblank, tmp, &window_priv->vblank, window_list) {
+            if (depth < present_max_queue_depth)
+                break;
+
+            if (!vblank->pixmap || !vblank->queued)
+                continue;
+
+            present_vblank_skip(vblank);
+            depth--;
         }
     }
 
     vblank = calloc (1, sizeof (present_vblank_rec));
-    if (!vblank)
+    if (!vblank) {
+        if (merged_update)
+            RegionDestroy(merged_update);
         return BadAlloc;
+    }
 
     xorg_list_append(&vblank->window_list, &window_priv->vblank);
     xorg_list_init(&vblank->event_queue);
@@ -901,7 +966,12 @@ present_pixmap(WindowPtr window,
         if (!vblank->valid)
             goto no_mem;
     }
-    if (update) {
+    if (full_update) {
+        if (merged_update)
+            RegionDestroy(merged_update);
+    } else if (merged_update) {
+        vblank->update = merged_update;
+    } else if (update) {
         vblank->update = RegionDuplicate(update);
         if (!vblank->update)
             goto no_mem;
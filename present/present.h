@@ -125,4 +125,15 @@ typedef void (*present_complete_notify_proc)(WindowPtr window,
 extern _X_EXPORT void
 present_register_complete_notify(present_complete_notify_proc proc);
 
+/* When set, a PresentPixmap request replaces any pending presentation
+ * for the same window and target MSC, even when it carries an update
+ * region. The superseded pixmap is released immediately.
+ */
+extern _X_EXPORT Bool present_mailbox;
+
+/* Maximum number of pending PresentPixmap requests per window; older
+ * ones are skipped once the limit is reached. Zero means no limit.
+ */
+extern _X_EXPORT int present_max_queue_depth;
+
 #endif /* _PRESENT_H_ */
@@ -41,6 +41,7 @@ and Jim Haggerty of Metheus.
 #include "extinit.h"
 #include <X11/extensions/recordproto.h>
 #include "set.h"
+#include "ring.h"
 #include "swaprep.h"
 #include "inputstr.h"
 #include "eventconvert.h"
@@ -49,6 +50,10 @@ and Jim Haggerty of Metheus.
 #include <stdio.h>
 #include <assert.h>
 
+#ifdef RECORD_RING
+#include <unistd.h>
+#endif
+
 #ifdef PANORAMIX
 #include "globals.h"
 #include "panoramiX.h"
@@ -78,6 +83,9 @@ typedef struct {
     int numBufBytes;            /* number of bytes in replyBuffer */
     char replyBuffer[REPLY_BUF_SIZE];   /* buffered recorded protocol */
     int inFlush;                /*  are we inside RecordFlushReplyBuffer */
+#ifdef RECORD_RING
+    RecordRingPtr pRing;        /* shared memory transport, if enabled */
+#endif
 } RecordContextRec, *RecordContextPtr;
 
 /*  RecordMinorOpRec - to hold minor opcode selections for extension requests
@@ -139,6 +147,8 @@ static int numEnabledRCAPs;
 static int RecordDeleteContext(void     *value,
                                XID      id);
 
+static void RecordDisableContext(RecordContextPtr pContext);
+
 /***************************************************************************/
 
 /* client private stuff */
@@ -213,6 +223,148 @@ RecordFindContextOnAllContexts(RecordContextPtr pContext)
 
 /***************************************************************************/
 
+#ifdef RECORD_RING
+
+/* Length of the recorded message at pMsg, including its header */
+static int
+RecordRingMessageLength(RecordContextPtr pContext, char *pMsg)
+{
+    CARD32 length = ((xRecordEnableContextReply *) pMsg)->length;
+
+    if (pContext->pRecordingClient->swapped)
+        swapl(&length);
+    return SIZEOF(xRecordEnableContextReply) + (length << 2);
+}                               /* RecordRingMessageLength */
+
+/* RecordRingFlush
+ *
+ * Arguments:
+ *	pContext is a context recording into a ring.
+ *
+ * Returns: nothing.
+ *
+ * Side Effects:
+ *	Held back messages are written to the ring as far as they fit,
+ *	followed by the staged message once all of it has been recorded.
+ *	A staged message that doesn't fit is held back or dropped;
+ *	one larger than the ring is always dropped.
+ */
+static void
+RecordRingFlush(RecordContextPtr pContext)
+{
+    RecordRingPtr pRing = pContext->pRing;
+    size_t done = 0;
+    int len;
+
+    while (done < pRing->backlogBytes) {
+        len = RecordRingMessageLength(pContext, pRing->backlog + done);
+        if (!RecordRingPut(pRing, pRing->backlog + done, len))
+            break;
+        done += len;
+    }
+    if (done) {
+        pRing->backlogBytes -= done;
+        memmove(pRing->backlog, pRing->backlog + done, pRing->backlogBytes);
+    }
+
+    if (!pContext->numBufBytes ||
+        pContext->numBufBytes <
+        RecordRingMessageLength(pContext, pRing->stage))
+        return;
+
+    len = pContext->numBufBytes;
+    if ((CARD32) len > pRing->size) {
+        /* It would never fit, don't hold back what follows */
+        RecordRingDrop(pRing, RecordRingMessageElements(pRing->stage));
+    }
+    else if (pRing->backlogBytes || !RecordRingPut(pRing, pRing->stage, len)) {
+        if (pRing->dropOnFull || !RecordRingDefer(pRing, pRing->stage, len))
+            RecordRingDrop(pRing, RecordRingMessageElements(pRing->stage));
+    }
+    pContext->numBufBytes = 0;
+}                               /* RecordRingFlush */
+
+/* RecordRingReserve
+ *
+ * Arguments:
+ *	pContext is a context recording into a ring.
+ *	len is the number of bytes about to be staged.
+ *	futurelen is as for RecordAProtocolElement.
+ *
+ * Returns: TRUE if the element should be staged, FALSE if it is dropped.
+ *
+ * Side Effects:
+ *	The staging buffer is grown to hold the whole element, so ring
+ *	messages are never split.  If that fails, the staged message and
+ *	the remainder of the element are dropped.
+ */
+static Bool
+RecordRingReserve(RecordContextPtr pContext, int len, int futurelen)
+{
+    RecordRingPtr pRing = pContext->pRing;
+    int size = pRing->stageSize;
+    char *stage;
+
+    if (futurelen >= 0)
+        pRing->discarding = FALSE;
+    else if (pRing->discarding)
+        return FALSE;
+
+    len += pContext->numBufBytes + SIZEOF(xRecordEnableContextReply);
+    while (size < len)
+        size *= 2;
+    if (size == pRing->stageSize)
+        return TRUE;
+
+    stage = realloc(pRing->stage, size);
+    if (stage) {
+        pRing->stage = stage;
+        pRing->stageSize = size;
+        return TRUE;
+    }
+
+    RecordRingDrop(pRing, (pContext->numBufBytes ?
+                           RecordRingMessageElements(pRing->stage) : 0) +
+                   (futurelen >= 0));
+    pContext->numBufBytes = 0;
+    pRing->discarding = futurelen > 0;
+    return FALSE;
+}                               /* RecordRingReserve */
+
+/* RecordRingClose
+ *
+ * Arguments:
+ *	pContext is a context recording into a ring.
+ *
+ * Returns: nothing.
+ *
+ * Side Effects:
+ *	Whatever can still be written is written, the rest is counted as
+ *	dropped, and the reader is told no more data will follow.  The
+ *	server's mapping of the ring is released.
+ */
+static void
+RecordRingClose(RecordContextPtr pContext)
+{
+    RecordRingPtr pRing = pContext->pRing;
+    size_t done;
+    int len;
+
+    RecordRingFlush(pContext);
+    for (done = 0; done < pRing->backlogBytes; done += len) {
+        len = RecordRingMessageLength(pContext, pRing->backlog + done);
+        RecordRingDrop(pRing, RecordRingMessageElements(pRing->backlog + done));
+    }
+
+    RecordRingStore(&pRing->pHeader->flags,
+                    pRing->pHeader->flags | XRecordRingClosed);
+    RecordRingDestroy(pRing);
+    pContext->pRing = NULL;
+    pContext->numBufBytes = 0;
+}                               /* RecordRingClose */
+
+#endif                          /* RECORD_RING */
+
 /* RecordFlushReplyBuffer
  *
  * Arguments:
@@ -236,6 +388,13 @@ RecordFlushReplyBuffer(RecordContextPtr pContext,
     if (!pContext->pRecordingClient || pContext->pRecordingClient->clientGone ||
         pContext->inFlush)
         return;
+#ifdef RECORD_RING
+    if (pContext->pRing) {
+        /* RecordRingReserve makes sure there is never anything extra */
+        RecordRingFlush(pContext);
+        return;
+    }
+#endif
     ++pContext->inFlush;
     if (pContext->numBufBytes)
         WriteToClient(pContext->pRecordingClient, pContext->numBufBytes,
@@ -287,10 +446,22 @@ RecordAProtocolElement(RecordContextPtr pContext, ClientPtr pClient,
     CARD32 serverTime = 0;
     Bool gotServerTime = FALSE;
     int replylen;
+    char *replyBuffer = pContext->replyBuffer;
+    int replyBufSize = REPLY_BUF_SIZE;
+
+#ifdef RECORD_RING
+    if (pContext->pRing) {
+        if (!RecordRingReserve(pContext, datalen + sizeof(elemHeaderData),
+                               futurelen))
+            return;
+        replyBuffer = pContext->pRing->stage;
+        replyBufSize = pContext->pRing->stageSize;
+    }
+#endif
 
     if (futurelen >= 0) {       /* start of new protocol element */
         xRecordEnableContextReply *pRep = (xRecordEnableContextReply *)
-            pContext->replyBuffer;
+            replyBuffer;
 
         if (pContext->pBufClient != pClient ||
             pContext->bufCategory != category) {
@@ -308,6 +479,8 @@ RecordAProtocolElement(RecordContextPtr pContext, ClientPtr pClient,
             pRep->length = 0;
             pRep->elementHeader = pContext->elemHeaders;
             pRep->serverTime = serverTime;
+            pRep->pad3 = 0;
+            pRep->pad4 = 0;
             if (pClient) {
                 pRep->clientSwapped =
                     (pClient->swapped != recordingClientSwapped);
@@ -365,25 +538,29 @@ RecordAProtocolElement(RecordContextPtr pContext, ClientPtr pClient,
         if (recordingClientSwapped)
             swapl(&replylen);
         pRep->length = replylen;
+#ifdef RECORD_RING
+        if (pContext->pRing)
+            pRep->pad3++;       /* element count, see RecordRingPut */
+#endif
     }                           /* end if not continued reply */
 
     numElemHeaders *= 4;
 
     /* if space available >= space needed, buffer the data */
 
-    if (REPLY_BUF_SIZE - pContext->numBufBytes >= datalen + numElemHeaders) {
+    if (replyBufSize - pContext->numBufBytes >= datalen + numElemHeaders) {
         if (numElemHeaders) {
-            memcpy(pContext->replyBuffer + pContext->numBufBytes,
+            memcpy(replyBuffer + pContext->numBufBytes,
                    elemHeaderData, numElemHeaders);
             pContext->numBufBytes += numElemHeaders;
         }
         if (datalen) {
             static char padBuffer[3];   /* as in FlushClient */
 
-            memcpy(pContext->replyBuffer + pContext->numBufBytes,
+            memcpy(replyBuffer + pContext->numBufBytes,
                    data, datalen - padlen);
             pContext->numBufBytes += datalen - padlen;
-            memcpy(pContext->replyBuffer + pContext->numBufBytes,
+            memcpy(replyBuffer + pContext->numBufBytes,
                    padBuffer, padlen);
             pContext->numBufBytes += padlen;
         }
@@ -826,6 +1003,10 @@ RecordFlushAllContexts(CallbackListPtr *pcbl,
          */
         if (pContext->numBufBytes)
             RecordFlushReplyBuffer(ppAllContexts[eci], NULL, 0, NULL, 0);
+#ifdef RECORD_RING
+        else if (pContext->pRing && pContext->pRing->backlogBytes)
+            RecordRingFlush(pContext);
+#endif
     }
 }                               /* RecordFlushAllContexts */
 
@@ -1822,7 +2003,11 @@ ProcRecordQueryVersion(ClientPtr client)
         .sequenceNumber = client->sequence,
         .length = 0,
         .majorVersion = SERVER_RECORD_MAJOR_VERSION,
+#ifdef RECORD_RING
+        .minorVersion = SERVER_RECORD_RING_MINOR_VERSION
+#else
         .minorVersion = SERVER_RECORD_MINOR_VERSION
+#endif
     };
 
     REQUEST_SIZE_MATCH(xRecordQueryVersionReq);
@@ -1867,6 +2052,9 @@ ProcRecordCreateContext(ClientPtr client)
     pContext->pBufClient = NULL;
     pContext->continuedReply = 0;
     pContext->inFlush = 0;
+#ifdef RECORD_RING
+    pContext->pRing = NULL;
+#endif
 
     err = RecordRegisterClients(pContext, client,
                                 (xRecordRegisterClientsReq *) stuff);
@@ -2275,20 +2463,28 @@ ProcRecordGetContext(ClientPtr client)
     return err;
 }                               /* ProcRecordGetContext */
 
+/* RecordEnableContext
+ *
+ * Arguments:
+ *	client is the client enabling the context.
+ *	pContext is the context to enable.
+ *	ignore is TRUE if recorded protocol is sent to client as replies.
+ *
+ * Returns: an X error code if the context could not be enabled, else
+ *	Success.
+ *
+ * Side Effects:
+ *	Recording hooks are installed, the context is moved to the front
+ *	part of ppAllContexts and StartOfData is recorded.  If ignore is
+ *	TRUE, request processing on client stops until the context is
+ *	disabled.
+ */
 static int
-ProcRecordEnableContext(ClientPtr client)
+RecordEnableContext(ClientPtr client, RecordContextPtr pContext, Bool ignore)
 {
-    RecordContextPtr pContext;
-
-    REQUEST(xRecordEnableContextReq);
     int i;
     RecordClientsAndProtocolPtr pRCAP;
 
-    REQUEST_SIZE_MATCH(xRecordGetContextReq);
-    VERIFY_CONTEXT(pContext, stuff->context, client);
-    if (pContext->pRecordingClient)
-        return BadMatch;        /* already enabled */
-
     /* install record hooks for each RCAP */
 
     for (pRCAP = pContext->pListOfRCAP; pRCAP; pRCAP = pRCAP->pNextRCAP) {
@@ -2309,7 +2505,8 @@ ProcRecordEnableContext(ClientPtr client)
     /* Disallow further request processing on this connection until
      * the context is disabled.
      */
-    IgnoreClient(client);
+    if (ignore)
+        IgnoreClient(client);
     pContext->pRecordingClient = client;
 
     /* Don't allow the data connection to record itself; unregister it. */
@@ -2333,8 +2530,82 @@ ProcRecordEnableContext(ClientPtr client)
     RecordAProtocolElement(pContext, NULL, XRecordStartOfData, NULL, 0, 0, 0);
     RecordFlushReplyBuffer(pContext, NULL, 0, NULL, 0);
     return Success;
+}                               /* RecordEnableContext */
+
+static int
+ProcRecordEnableContext(ClientPtr client)
+{
+    RecordContextPtr pContext;
+
+    REQUEST(xRecordEnableContextReq);
+
+    REQUEST_SIZE_MATCH(xRecordGetContextReq);
+    VERIFY_CONTEXT(pContext, stuff->context, client);
+    if (pContext->pRecordingClient)
+        return BadMatch;        /* already enabled */
+
+    return RecordEnableContext(client, pContext, TRUE);
 }                               /* ProcRecordEnableContext */
 
+#ifdef RECORD_RING
+static int
+ProcRecordEnableContextRing(ClientPtr client)
+{
+    RecordContextPtr pContext;
+    RecordRingPtr pRing;
+    xRecordEnableContextRingReply rep;
+    int fd, err;
+
+    REQUEST(xRecordEnableContextRingReq);
+
+    REQUEST_SIZE_MATCH(xRecordEnableContextRingReq);
+    VERIFY_CONTEXT(pContext, stuff->context, client);
+    if (pContext->pRecordingClient)
+        return BadMatch;        /* already enabled */
+    if (stuff->flags & ~XRecordRingDropOnFull) {
+        client->errorValue = stuff->flags;
+        return BadValue;
+    }
+
+    pRing = RecordRingCreate(stuff->size,
+                             (stuff->flags & XRecordRingDropOnFull) != 0, &fd);
+    if (!pRing)
+        return BadAlloc;
+
+    rep = (xRecordEnableContextRingReply) {
+        .type = X_Reply,
+        .nfd = 1,
+        .sequenceNumber = client->sequence,
+        .length = 0,
+        .size = pRing->size,
+        .dataOffset = sizeof(xRecordRingHeader)
+    };
+
+    pContext->pRing = pRing;
+    err = RecordEnableContext(client, pContext, FALSE);
+    if (err != Success) {
+        RecordRingDestroy(pRing);
+        pContext->pRing = NULL;
+        close(fd);
+        return err;
+    }
+
+    if (WriteFdToClient(client, fd, TRUE) < 0) {
+        RecordDisableContext(pContext);
+        close(fd);
+        return BadAlloc;
+    }
+
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.size);
+        swapl(&rep.dataOffset);
+    }
+    WriteToClient(client, sizeof(rep), &rep);
+    return Success;
+}                               /* ProcRecordEnableContextRing */
+#endif                          /* RECORD_RING */
+
 /* RecordDisableContext
  *
  * Arguments:
@@ -2359,6 +2630,13 @@ RecordDisableContext(RecordContextPtr pContext)
 
     if (!pContext->pRecordingClient)
         return;
+#ifdef RECORD_RING
+    if (pContext->pRing) {
+        RecordAProtocolElement(pContext, NULL, XRecordEndOfData, NULL, 0, 0, 0);
+        RecordRingClose(pContext);
+    }
+    else
+#endif
     if (!pContext->pRecordingClient->clientGone) {
         RecordAProtocolElement(pContext, NULL, XRecordEndOfData, NULL, 0, 0, 0);
         RecordFlushReplyBuffer(pContext, NULL, 0, NULL, 0);
@@ -2481,6 +2759,10 @@ ProcRecordDispatch(ClientPtr client)
         return ProcRecordDisableContext(client);
     case X_RecordFreeContext:
         return ProcRecordFreeContext(client);
+#ifdef RECORD_RING
+    case X_RecordEnableContextRing:
+        return ProcRecordEnableContextRing(client);
+#endif
     default:
         return BadRequest;
     }
@@ -2605,6 +2887,21 @@ SProcRecordFreeContext(ClientPtr client)
     return ProcRecordFreeContext(client);
 }                               /* SProcRecordFreeContext */
 
+#ifdef RECORD_RING
+static int _X_COLD
+SProcRecordEnableContextRing(ClientPtr client)
+{
+    REQUEST(xRecordEnableContextRingReq);
+
+    swaps(&stuff->length);
+    REQUEST_SIZE_MATCH(xRecordEnableContextRingReq);
+    swapl(&stuff->context);
+    swapl(&stuff->size);
+    swapl(&stuff->flags);
+    return ProcRecordEnableContextRing(client);
+}                               /* SProcRecordEnableContextRing */
+#endif
+
 static int _X_COLD
 SProcRecordDispatch(ClientPtr client)
 {
@@ -2627,6 +2924,10 @@ SProcRecordDispatch(ClientPtr client)
         return SProcRecordDisableContext(client);
     case X_RecordFreeContext:
         return SProcRecordFreeContext(client);
+#ifdef RECORD_RING
+    case X_RecordEnableContextRing:
+        return SProcRecordEnableContextRing(client);
+#endif
     default:
         return BadRequest;
     }
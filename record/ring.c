@@ -0,0 +1,191 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include "ring.h"
+
+#ifdef RECORD_RING
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Initial size of the staging buffer, grown as needed */
+#define RECORD_RING_STAGE_SIZE  1024
+
+/* RecordRingCreate
+ *
+ * Arguments:
+ *	size is the requested size of the data area in bytes.
+ *	dropOnFull selects dropping messages that don't fit over holding
+ *	  them back.
+ *	pfd is a pointer to an int that receives the ring's file descriptor.
+ *
+ * Returns: the new ring, or NULL if it could not be created.
+ *
+ * Side Effects:
+ *	A memfd is created, sized and mapped.  The caller owns *pfd.
+ */
+RecordRingPtr
+RecordRingCreate(CARD32 size, Bool dropOnFull, int *pfd)
+{
+    RecordRingPtr pRing;
+    CARD32 dataSize = RECORD_RING_MIN_SIZE;
+    void *map;
+    int fd;
+
+    while (dataSize < size && dataSize < RECORD_RING_MAX_SIZE)
+        dataSize <<= 1;
+
+    pRing = calloc(1, sizeof(RecordRingRec));
+    if (!pRing)
+        return NULL;
+
+    pRing->stageSize = RECORD_RING_STAGE_SIZE;
+    pRing->stage = malloc(pRing->stageSize);
+    if (!pRing->stage)
+        goto bail;
+
+    fd = memfd_create("xserver-record", MFD_CLOEXEC);
+    if (fd < 0)
+        goto bail;
+
+    pRing->mapSize = sizeof(xRecordRingHeader) + dataSize;
+    if (ftruncate(fd, pRing->mapSize) < 0)
+        goto bail_fd;
+
+    map = mmap(NULL, pRing->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        goto bail_fd;
+
+    pRing->pHeader = map;
+    pRing->pData = (char *) map + sizeof(xRecordRingHeader);
+    pRing->size = dataSize;
+    pRing->dropOnFull = dropOnFull;
+
+    pRing->pHeader->magic = XRecordRingMagic;
+    pRing->pHeader->size = dataSize;
+    pRing->pHeader->dataOffset = sizeof(xRecordRingHeader);
+    pRing->pHeader->flags = dropOnFull ? XRecordRingDropOnFull : 0;
+
+    *pfd = fd;
+    return pRing;
+
+bail_fd:
+    close(fd);
+bail:
+    free(pRing->stage);
+    free(pRing);
+    return NULL;
+}                               /* RecordRingCreate */
+
+void
+RecordRingDestroy(RecordRingPtr pRing)
+{
+    munmap(pRing->pHeader, pRing->mapSize);
+    free(pRing->backlog);
+    free(pRing->stage);
+    free(pRing);
+}                               /* RecordRingDestroy */
+
+/* RecordRingPut
+ *
+ * Arguments:
+ *	pRing is the ring to write to.
+ *	pMsg is a complete message of len bytes.
+ *
+ * Returns: TRUE if the message was written, FALSE if it didn't fit.
+ *
+ * Side Effects:
+ *	The message is copied into the ring and published to the reader.
+ *	If the reader's tail is inconsistent with head, the ring is emptied
+ *	first by moving head to tail.
+ */
+Bool
+RecordRingPut(RecordRingPtr pRing, char *pMsg, int len)
+{
+    xRecordRingHeader *pHeader = pRing->pHeader;
+    CARD32 tail = RecordRingLoad(&pHeader->tail);
+    CARD32 head = pRing->head;
+    CARD32 used = head - tail;
+    CARD32 offset, elements;
+    int first;
+
+    if (used > pRing->size) {
+        head = pRing->head = tail;
+        used = 0;
+        RecordRingStore(&pHeader->head, head);
+    }
+
+    if ((CARD32) len > pRing->size - used)
+        return FALSE;
+
+    elements = RecordRingMessageElements(pMsg);
+    RecordRingMessageElements(pMsg) = 0;
+
+    offset = head & (pRing->size - 1);
+    first = min(len, pRing->size - offset);
+    memcpy(pRing->pData + offset, pMsg, first);
+    memcpy(pRing->pData, pMsg + first, len - first);
+
+    pHeader->elements += elements;
+    pRing->head = head + len;
+    RecordRingStore(&pHeader->head, pRing->head);
+    return TRUE;
+}                               /* RecordRingPut */
+
+void
+RecordRingDrop(RecordRingPtr pRing, CARD32 elements)
+{
+    RecordRingStore(&pRing->pHeader->dropped,
+                    pRing->pHeader->dropped + elements);
+}                               /* RecordRingDrop */
+
+/* Hold back a message the reader has no room for yet */
+Bool
+RecordRingDefer(RecordRingPtr pRing, char *pMsg, int len)
+{
+    CARD64 limit = min((CARD64) RECORD_RING_BACKLOG * pRing->size, SIZE_MAX);
+    CARD64 needed = (CARD64) pRing->backlogBytes + len;
+
+    if ((CARD32) len > pRing->size || needed > limit)
+        return FALSE;
+
+    if (needed > pRing->backlogSize) {
+        size_t size = min(max((CARD64) pRing->backlogSize * 2, needed), limit);
+        char *backlog;
+
+        backlog = realloc(pRing->backlog, size);
+        if (!backlog)
+            return FALSE;
+        pRing->backlog = backlog;
+        pRing->backlogSize = size;
+    }
+    memcpy(pRing->backlog + pRing->backlogBytes, pMsg, len);
+    pRing->backlogBytes += len;
+    return TRUE;
+}                               /* RecordRingDefer */
+
+#endif                          /* RECORD_RING */
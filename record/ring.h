@@ -0,0 +1,148 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Shared memory ring transport for the RECORD extension.
+ */
+
+#ifndef _RECORD_RING_H_
+#define _RECORD_RING_H_
+
+#include "misc.h"
+#include <X11/extensions/recordproto.h>
+
+#if defined(HAVE_MEMFD_CREATE) && XTRANS_SEND_FDS
+#define RECORD_RING 1
+#endif
+
+/* EnableContextRing: like EnableContext, but the recorded protocol is
+ * written to a ring buffer in shared memory instead of being sent as
+ * replies.  The single reply carries a file descriptor for the ring;
+ * the recording connection stays usable for other requests.
+ *
+ * The ring starts with an xRecordRingHeader.  The data area holds the
+ * same xRecordEnableContextReply messages the reply-based protocol
+ * would send, each one complete and contiguous modulo the ring size.
+ * The server advances head after writing a message, the reader
+ * advances tail after consuming one; both count bytes and wrap at
+ * 2^32.  When a message does not fit, it is either dropped or held
+ * back until the reader catches up, as selected by the flags.
+ * Messages larger than the data area are always dropped.  A tail
+ * more than the data area size behind head, or ahead of it, discards
+ * whatever the ring holds and writing restarts at tail.
+ *
+ * Servers which support it report version 1.14.
+ */
+#ifndef X_RecordEnableContextRing
+#define X_RecordEnableContextRing       8
+
+#define XRecordRingDropOnFull           (1L << 0)
+#define XRecordRingClosed               (1L << 1)
+
+#define XRecordRingMagic                0x58524352      /* "XRCR" */
+
+typedef struct {
+    CARD8 reqType;
+    CARD8 recordReqType;
+    CARD16 length;
+    CARD32 context;
+    CARD32 size;                /* requested data area size in bytes */
+    CARD32 flags;
+} xRecordEnableContextRingReq;
+
+#define sz_xRecordEnableContextRingReq  16
+
+typedef struct {
+    CARD8 type;
+    CARD8 nfd;
+    CARD16 sequenceNumber;
+    CARD32 length;
+    CARD32 size;                /* data area size, a power of two */
+    CARD32 dataOffset;          /* offset of the data area in the ring */
+    CARD32 pad0;
+    CARD32 pad1;
+    CARD32 pad2;
+    CARD32 pad3;
+} xRecordEnableContextRingReply;
+
+#define sz_xRecordEnableContextRingReply 32
+
+typedef struct {
+    CARD32 magic;
+    CARD32 size;
+    CARD32 dataOffset;
+    CARD32 flags;               /* XRecordRing* */
+    CARD32 head;                /* written by the server */
+    CARD32 tail;                /* written by the reader */
+    CARD32 elements;            /* protocol elements written */
+    CARD32 dropped;             /* protocol elements dropped */
+    CARD32 pad[8];
+} xRecordRingHeader;
+#endif
+
+#ifdef RECORD_RING
+
+#define RECORD_RING_MIN_SIZE    (1 << 16)
+#define RECORD_RING_MAX_SIZE    (1 << 30)
+
+/* Held back messages are dropped past this many times the ring size */
+#define RECORD_RING_BACKLOG     4
+
+typedef struct {
+    xRecordRingHeader *pHeader;
+    char *pData;
+    CARD32 size;
+    CARD32 head;                /* the server's copy, pHeader->head is shared */
+    size_t mapSize;
+    Bool dropOnFull;
+    Bool discarding;            /* dropping the rest of an element */
+    char *stage;                /* message being assembled */
+    int stageSize;
+    char *backlog;              /* complete messages waiting for space */
+    size_t backlogBytes;
+    size_t backlogSize;
+} RecordRingRec, *RecordRingPtr;
+
+#define RecordRingLoad(p)       __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define RecordRingStore(p, v)   __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/* While a message is staged, pad3 of its header counts its elements */
+#define RecordRingMessageElements(pMsg) \
+    (((xRecordEnableContextReply *) (pMsg))->pad3)
+
+extern RecordRingPtr
+RecordRingCreate(CARD32 size, Bool dropOnFull, int *pfd);
+
+extern void
+RecordRingDestroy(RecordRingPtr pRing);
+
+extern Bool
+RecordRingPut(RecordRingPtr pRing, char *pMsg, int len);
+
+extern void
+RecordRingDrop(RecordRingPtr pRing, CARD32 elements);
+
+extern Bool
+RecordRingDefer(RecordRingPtr pRing, char *pMsg, int len);
+
+#endif                          /* RECORD_RING */
+
+#endif                          /* _RECORD_RING_H_ */
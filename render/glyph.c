@@ -26,7 +26,7 @@
 #include <dix-config.h>
 #endif
 
-#include "xsha1.h"
+#include <stdint.h>
 
 #include "misc.h"
 #include "scrnintstr.h"
@@ -89,6 +89,8 @@ GlyphUninit(ScreenPtr pScreen)
     GlyphPtr glyph;
     int fdepth, i;
 
+    GlyphRunUninit(pScreen);
+
     for (fdepth = 0; fdepth < GlyphFormatNum; fdepth++) {
         if (!globalGlyphs[fdepth].hashSet)
             continue;
@@ -117,9 +119,39 @@ FindGlyphHashSet(CARD32 filled)
     return 0;
 }
 
+/*
+ * A glyph's hash only picks its slot in the global table, so lookups by
+ * contents compare the glyphs themselves.
+ */
+typedef struct {
+    unsigned char *sha1;
+    xGlyphInfo *gi;
+    CARD8 *bits;
+    unsigned long size;
+} GlyphKeyRec, *GlyphKeyPtr;
+
+typedef Bool (*GlyphMatchProcPtr) (GlyphPtr glyph, void *closure);
+
+static Bool
+GlyphMatchContents(GlyphPtr glyph, void *closure)
+{
+    GlyphKeyPtr key = closure;
+
+    return (memcmp(glyph->sha1, key->sha1, GLYPH_HASH_SIZE) == 0 &&
+            memcmp(&glyph->info, key->gi, sizeof(xGlyphInfo)) == 0 &&
+            glyph->size == sizeof(xGlyphInfo) + key->size &&
+            memcmp(glyph->bits, key->bits, key->size) == 0);
+}
+
+static Bool
+GlyphMatchSelf(GlyphPtr glyph, void *closure)
+{
+    return glyph == closure;
+}
+
 static GlyphRefPtr
 FindGlyphRef(GlyphHashPtr hash,
-             CARD32 signature, Bool match, unsigned char sha1[20])
+             CARD32 signature, GlyphMatchProcPtr match, void *closure)
 {
     CARD32 elt, step, s;
     GlyphPtr glyph;
@@ -145,8 +177,7 @@ FindGlyphRef(GlyphHashPtr hash,
             else if (gr == del)
                 break;
         }
-        else if (s == signature &&
-                 (!match || memcmp(glyph->sha1, sha1, 20) == 0)) {
+        else if (s == signature && (!match || (*match) (glyph, closure))) {
             break;
         }
         if (!step) {
@@ -161,38 +192,90 @@ FindGlyphRef(GlyphHashPtr hash,
     return gr;
 }
 
+static inline uint64_t
+GlyphHashMix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t glyphHashSeed;
+static unsigned long glyphHashGeneration;
+
+/*
+ * Despite the name, this is no longer SHA1: lookups compare the glyph
+ * contents anyway, so a fast 64 bit hash will do.  It fills the first
+ * GLYPH_HASH_SIZE bytes of sha1 and clears the rest, which AllocateGlyph
+ * uses to make glyph->sha1 unique to the glyph.
+ *
+ * The hash is keyed with a secret drawn for each server generation, so
+ * that clients can't pick glyphs which all land in the same bucket.
+ */
 int
 HashGlyph(xGlyphInfo * gi,
           CARD8 *bits, unsigned long size, unsigned char sha1[20])
 {
-    void *ctx = x_sha1_init();
-    int success;
-
-    if (!ctx)
-        return BadAlloc;
-
-    success = x_sha1_update(ctx, gi, sizeof(xGlyphInfo));
-    if (!success)
-        return BadAlloc;
-    success = x_sha1_update(ctx, bits, size);
-    if (!success)
-        return BadAlloc;
-    success = x_sha1_final(ctx, sha1);
-    if (!success)
-        return BadAlloc;
+    const uint64_t k = 0x9e3779b97f4a7c15ull;
+    uint64_t h0, h1, h2, h3;
+    uint64_t w[4];
+    unsigned long i;
+
+    if (glyphHashGeneration != serverGeneration) {
+        GenerateRandomData(sizeof(glyphHashSeed), (char *) &glyphHashSeed);
+        glyphHashGeneration = serverGeneration;
+    }
+    h0 = glyphHashSeed ^ size;
+    h1 = glyphHashSeed ^ 2;
+    h2 = glyphHashSeed ^ 3;
+    h3 = glyphHashSeed ^ 4;
+
+    memset(w, 0, sizeof(w));
+    memcpy(w, gi, sizeof(xGlyphInfo));
+    h0 = (h0 ^ w[0]) * k;
+    h1 = (h1 ^ w[1]) * k;
+
+    /* Four independent lanes keep the multiplies in flight */
+    for (i = 0; i + 32 <= size; i += 32) {
+        memcpy(w, bits + i, sizeof(w));
+        h0 = (h0 ^ w[0]) * k;
+        h1 = (h1 ^ w[1]) * k;
+        h2 = (h2 ^ w[2]) * k;
+        h3 = (h3 ^ w[3]) * k;
+    }
+    for (; i + 8 <= size; i += 8) {
+        memcpy(w, bits + i, 8);
+        h2 = (h2 ^ w[0]) * k;
+    }
+    for (; i < size; i++)
+        h3 = (h3 ^ bits[i]) * k;
+
+    h0 = GlyphHashMix(h0);
+    h0 = GlyphHashMix(h0 ^ h1);
+    h0 = GlyphHashMix(h0 ^ h2);
+    h0 = GlyphHashMix(h0 ^ h3 ^ glyphHashSeed);
+
+    memset(sha1, 0, 20);
+    memcpy(sha1, &h0, GLYPH_HASH_SIZE);
     return Success;
 }
 
 GlyphPtr
-FindGlyphByHash(unsigned char sha1[20], int format)
+FindGlyphByHash(unsigned char sha1[20], xGlyphInfo * gi,
+                CARD8 *bits, unsigned long size, int format)
 {
     GlyphRefPtr gr;
     CARD32 signature = *(CARD32 *) sha1;
+    GlyphKeyRec key = { sha1, gi, bits, size };
 
     if (!globalGlyphs[format].hashSet)
         return NULL;
 
-    gr = FindGlyphRef(&globalGlyphs[format], signature, TRUE, sha1);
+    gr = FindGlyphRef(&globalGlyphs[format], signature,
+                      GlyphMatchContents, &key);
 
     if (gr->glyph && gr->glyph != DeletedGlyph)
         return gr->glyph;
@@ -264,7 +347,8 @@ FreeGlyph(GlyphPtr glyph, int format)
             }
 
         signature = *(CARD32 *) glyph->sha1;
-        gr = FindGlyphRef(&globalGlyphs[format], signature, TRUE, glyph->sha1);
+        gr = FindGlyphRef(&globalGlyphs[format], signature,
+                          GlyphMatchSelf, glyph);
         if (gr - globalGlyphs[format].table != first)
             DuplicateRef(glyph, "Found wrong one");
         if (gr->glyph && gr->glyph != DeletedGlyph) {
@@ -283,12 +367,16 @@ AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id)
 {
     GlyphRefPtr gr;
     CARD32 signature;
+    GlyphKeyRec key = {
+        glyph->sha1, &glyph->info, glyph->bits,
+        glyph->size - sizeof(xGlyphInfo)
+    };
 
     CheckDuplicates(&globalGlyphs[glyphSet->fdepth], "AddGlyph top global");
     /* Locate existing matching glyph */
     signature = *(CARD32 *) glyph->sha1;
     gr = FindGlyphRef(&globalGlyphs[glyphSet->fdepth], signature,
-                      TRUE, glyph->sha1);
+                      GlyphMatchContents, &key);
     if (gr->glyph && gr->glyph != DeletedGlyph && gr->glyph != glyph) {
         FreeGlyphPicture(glyph);
         dixFreeObjectWithPrivates(glyph, PRIVATE_GLYPH);
@@ -301,7 +389,7 @@ AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id)
     }
 
     /* Insert/replace glyphset value */
-    gr = FindGlyphRef(&glyphSet->hash, id, FALSE, 0);
+    gr = FindGlyphRef(&glyphSet->hash, id, NULL, NULL);
     ++glyph->refcnt;
     if (gr->glyph && gr->glyph != DeletedGlyph)
         FreeGlyph(gr->glyph, glyphSet->fdepth);
@@ -318,7 +406,7 @@ DeleteGlyph(GlyphSetPtr glyphSet, Glyph id)
     GlyphRefPtr gr;
     GlyphPtr glyph;
 
-    gr = FindGlyphRef(&glyphSet->hash, id, FALSE, 0);
+    gr = FindGlyphRef(&glyphSet->hash, id, NULL, NULL);
     glyph = gr->glyph;
     if (glyph && glyph != DeletedGlyph) {
         gr->glyph = DeletedGlyph;
@@ -334,15 +422,21 @@ FindGlyph(GlyphSetPtr glyphSet, Glyph id)
 {
     GlyphPtr glyph;
 
-    glyph = FindGlyphRef(&glyphSet->hash, id, FALSE, 0)->glyph;
+    glyph = FindGlyphRef(&glyphSet->hash, id, NULL, NULL)->glyph;
     if (glyph == DeletedGlyph)
         glyph = 0;
     return glyph;
 }
 
+/*
+ * The bits are kept with the glyph, for the pictures, which are only made
+ * once the glyph is drawn on a screen, and for lookups by contents.
+ */
 GlyphPtr
-AllocateGlyph(xGlyphInfo * gi, int fdepth)
+AllocateGlyph(xGlyphInfo * gi, PictFormatPtr format,
+              CARD8 *bits, unsigned long bits_size, unsigned char sha1[20])
 {
+    static CARD64 serial;
     PictureScreenPtr ps;
     int size;
     GlyphPtr glyph;
@@ -351,14 +445,25 @@ AllocateGlyph(xGlyphInfo * gi, int fdepth)
 
     head_size = sizeof(GlyphRec) + screenInfo.numScreens * sizeof(PicturePtr);
     size = (head_size + dixPrivatesSize(PRIVATE_GLYPH));
-    glyph = (GlyphPtr) malloc(size);
+    glyph = (GlyphPtr) malloc(size + bits_size);
     if (!glyph)
         return 0;
     glyph->refcnt = 0;
-    glyph->size = size + sizeof(xGlyphInfo);
+    glyph->size = sizeof(xGlyphInfo) + bits_size;
     glyph->info = *gi;
+    glyph->format = format;
+    glyph->bits = (CARD8 *) glyph + size;
+    memcpy(glyph->bits, bits, bits_size);
     dixInitPrivates(glyph, (char *) glyph + head_size, PRIVATE_GLYPH);
 
+    /* Drivers caching glyphs by glyph->sha1 must not mistake two glyphs
+     * whose hashes collide for one another */
+    serial++;
+    memcpy(glyph->sha1, sha1, GLYPH_HASH_SIZE);
+    memcpy(glyph->sha1 + GLYPH_HASH_SIZE, &serial, sizeof(serial));
+    memset(glyph->sha1 + GLYPH_HASH_SIZE + sizeof(serial), 0,
+           sizeof(glyph->sha1) - GLYPH_HASH_SIZE - sizeof(serial));
+
     for (i = 0; i < screenInfo.numScreens; i++) {
         ScreenPtr pScreen = screenInfo.screens[i];
         SetGlyphPicture(glyph, pScreen, NULL);
@@ -420,7 +525,8 @@ ResizeGlyphHash(GlyphHashPtr hash, CARD32 change, Bool global)
             glyph = hash->table[i].glyph;
             if (glyph && glyph != DeletedGlyph) {
                 s = hash->table[i].signature;
-                gr = FindGlyphRef(&newHash, s, global, glyph->sha1);
+                gr = FindGlyphRef(&newHash, s,
+                                  global ? GlyphMatchSelf : NULL, glyph);
 
                 gr->signature = s;
                 gr->glyph = glyph;
@@ -494,8 +600,8 @@ FreeGlyphSet(void *value, XID gid)
     return Success;
 }
 
-static void
-GlyphExtents(int nlist, GlyphListPtr list, GlyphPtr * glyphs, BoxPtr extents)
+void
+miGlyphExtents(int nlist, GlyphListPtr list, GlyphPtr * glyphs, BoxPtr extents)
 {
     int x1, x2, y1, y2;
     int n;
@@ -543,6 +649,81 @@ GlyphExtents(int nlist, GlyphListPtr list, GlyphPtr * glyphs, BoxPtr extents)
 
 #define NeedsComponent(f) (PICT_FORMAT_A(f) != 0 && PICT_FORMAT_RGB(f) != 0)
 
+static Bool
+RealizeGlyphPicture(GlyphPtr glyph, ScreenPtr pScreen)
+{
+    int width = glyph->info.width;
+    int height = glyph->info.height;
+    PictFormatPtr format = glyph->format;
+    int depth = format->depth;
+    CARD32 component_alpha = NeedsComponent(format->format);
+    PixmapPtr pSrcPix, pDstPix;
+    PicturePtr pSrc, pDst = NULL;
+    int error;
+
+    pSrcPix = GetScratchPixmapHeader(pScreen, width, height,
+                                     depth, depth, -1, glyph->bits);
+    if (!pSrcPix)
+        return FALSE;
+
+    pSrc = CreatePicture(0, &pSrcPix->drawable, format, 0, NULL,
+                         serverClient, &error);
+    if (!pSrc) {
+        FreeScratchPixmapHeader(pSrcPix);
+        return FALSE;
+    }
+
+    pDstPix = (pScreen->CreatePixmap) (pScreen, width, height, depth,
+                                       CREATE_PIXMAP_USAGE_GLYPH_PICTURE);
+    if (pDstPix) {
+        pDst = CreatePicture(0, &pDstPix->drawable, format,
+                             CPComponentAlpha, &component_alpha,
+                             serverClient, &error);
+
+        /* The picture takes a reference to the pixmap, so we
+           drop ours. */
+        (pScreen->DestroyPixmap) (pDstPix);
+    }
+
+    if (pDst) {
+        CompositePicture(PictOpSrc, pSrc, None, pDst,
+                         0, 0, 0, 0, 0, 0, width, height);
+        SetGlyphPicture(glyph, pScreen, pDst);
+    }
+
+    FreePicture((void *) pSrc, 0);
+    FreeScratchPixmapHeader(pSrcPix);
+    return pDst != NULL;
+}
+
+/*
+ * Make the pictures for all the glyphs of a request which haven't been
+ * drawn on this screen yet, so that the Glyphs hook finds them all.
+ */
+static Bool
+RealizeGlyphPictures(ScreenPtr pScreen,
+                     int nlist, GlyphListPtr list, GlyphPtr * glyphs)
+{
+    GlyphPtr glyph;
+    int n;
+
+    if (pScreen->isGPU)
+        return TRUE;
+
+    while (nlist--) {
+        n = list->len;
+        while (n--) {
+            glyph = *glyphs++;
+            if (glyph->info.width && glyph->info.height &&
+                !GetGlyphPicture(glyph, pScreen) &&
+                !RealizeGlyphPicture(glyph, pScreen))
+                return FALSE;
+        }
+        list++;
+    }
+    return TRUE;
+}
+
 void
 CompositeGlyphs(CARD8 op,
                 PicturePtr pSrc,
@@ -551,10 +732,18 @@ CompositeGlyphs(CARD8 op,
                 INT16 xSrc,
                 INT16 ySrc, int nlist, GlyphListPtr lists, GlyphPtr * glyphs)
 {
-    PictureScreenPtr ps = GetPictureScreen(pDst->pDrawable->pScreen);
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+
+    /* Nothing is drawn unless every glyph has its picture */
+    if (!RealizeGlyphPictures(pScreen, nlist, lists, glyphs))
+        return;
 
     ValidatePicture(pSrc);
     ValidatePicture(pDst);
+    if (GlyphRunComposite(op, pSrc, pDst, maskFormat, xSrc, ySrc,
+                          nlist, lists, glyphs))
+        return;
     (*ps->Glyphs) (op, pSrc, pDst, maskFormat, xSrc, ySrc, nlist, lists,
                    glyphs);
 }
@@ -595,7 +784,7 @@ miGlyphs(CARD8 op,
         GCPtr pGC;
         xRectangle rect;
 
-        GlyphExtents(nlist, list, glyphs, &extents);
+        miGlyphExtents(nlist, list, glyphs, &extents);
 
         if (extents.x2 <= extents.x1 || extents.y2 <= extents.y1)
             return;
@@ -0,0 +1,387 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Cache of rendered glyph runs.
+ *
+ * Terminals and editors draw the same strings over and over.  When a
+ * CompositeGlyphs request with a mask format draws a run of glyphs for the
+ * second time, the mask the glyphs are added into is kept, and later
+ * requests for the same run composite it in a single operation instead of
+ * going through the Glyphs hook.
+ *
+ * Runs are keyed by screen, mask format, the glyphs' serials (see
+ * AllocateGlyph) and their relative positions, so a run can be drawn
+ * anywhere, and a glyph which was freed can never match.  Stale runs are
+ * simply left to age out of the LRU list.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <string.h>
+
+#include "misc.h"
+#include "scrnintstr.h"
+#include "os.h"
+#include "pixmapstr.h"
+#include "gcstruct.h"
+#include "servermd.h"
+#include "list.h"
+#include "picturestr.h"
+#include "glyphstr.h"
+#include "mipict.h"
+
+#define GLYPH_RUN_MAX_GLYPHS    256
+#define GLYPH_RUN_MAX_AREA      (256 * 256)     /* pixels */
+#define GLYPH_RUN_MAX_ENTRIES   1024
+#define GLYPH_RUN_CACHE_SIZE    (4 * 1024 * 1024)       /* bytes of masks */
+#define GLYPH_RUN_HASH_SIZE     256
+#define GLYPH_RUN_REPORT_INTERVAL 10000000      /* us */
+
+/* Two words per list and per glyph, see GlyphRunKey */
+#define GLYPH_RUN_MAX_KEY       (GLYPH_RUN_MAX_GLYPHS * 2)
+
+typedef struct _GlyphRun {
+    struct xorg_list lru;
+    struct xorg_list link;      /* in its hash bucket */
+    CARD32 hash;
+    ScreenPtr pScreen;
+    PictFormatPtr maskFormat;
+    BoxRec extents;             /* relative to the first list's origin */
+    PicturePtr mask;            /* NULL until the run is drawn again */
+    int size;                   /* of the mask, in bytes */
+    int nkey;
+    /* key follows */
+} GlyphRunRec, *GlyphRunPtr;
+
+#define GlyphRunKeyData(run) ((CARD32 *) ((run) + 1))
+
+static struct xorg_list glyph_run_lru;
+static struct xorg_list glyph_run_hash[GLYPH_RUN_HASH_SIZE];
+static int glyph_run_entries;
+static int glyph_run_size;
+
+static struct {
+    unsigned hits;
+    unsigned misses;
+    unsigned evicted;
+    CARD64 report_time;
+} GlyphRunStats;
+
+static void
+GlyphRunAccount(Bool hit)
+{
+    CARD64 now = GetTimeInMicros();
+    unsigned total;
+
+    if (hit)
+        GlyphRunStats.hits++;
+    else
+        GlyphRunStats.misses++;
+
+    if (!GlyphRunStats.report_time)
+        GlyphRunStats.report_time = now;
+    if (now - GlyphRunStats.report_time < GLYPH_RUN_REPORT_INTERVAL)
+        return;
+
+    total = GlyphRunStats.hits + GlyphRunStats.misses;
+    LogMessageVerb(X_INFO, 4,
+                   "Glyph runs: %u hits, %u misses, %u%% hit rate, "
+                   "%u evicted, %d runs and %d kB cached\n",
+                   GlyphRunStats.hits, GlyphRunStats.misses,
+                   GlyphRunStats.hits * 100 / total, GlyphRunStats.evicted,
+                   glyph_run_entries, glyph_run_size / 1024);
+
+    memset(&GlyphRunStats, 0, sizeof(GlyphRunStats));
+    GlyphRunStats.report_time = now;
+}
+
+static void
+GlyphRunFree(GlyphRunPtr run)
+{
+    xorg_list_del(&run->lru);
+    xorg_list_del(&run->link);
+    glyph_run_entries--;
+    glyph_run_size -= run->size;
+    if (run->mask)
+        FreePicture((void *) run->mask, 0);
+    free(run);
+}
+
+static void
+GlyphRunTrim(void)
+{
+    GlyphRunPtr run;
+
+    while (glyph_run_entries > GLYPH_RUN_MAX_ENTRIES ||
+           glyph_run_size > GLYPH_RUN_CACHE_SIZE) {
+        run = xorg_list_last_entry(&glyph_run_lru, GlyphRunRec, lru);
+        GlyphRunFree(run);
+        GlyphRunStats.evicted++;
+    }
+}
+
+/*
+ * Each list is described by its length and offset, except for the offset
+ * of the first one, which only moves the whole run, and each glyph by its
+ * serial.
+ */
+static int
+GlyphRunKey(CARD32 *key, int nlist, GlyphListPtr list, GlyphPtr * glyphs)
+{
+    int nkey = 0, nglyphs = 0, i, n;
+    CARD64 serial;
+
+    for (i = 0; i < nlist; i++, list++) {
+        n = list->len;
+        nglyphs += n;
+        if (nglyphs + i >= GLYPH_RUN_MAX_GLYPHS)
+            return 0;
+
+        key[nkey++] = n;
+        key[nkey++] = i ? (CARD16) list->xOff | (CARD32) list->yOff << 16 : 0;
+        while (n--) {
+            memcpy(&serial, (*glyphs++)->sha1 + GLYPH_HASH_SIZE,
+                   sizeof(serial));
+            key[nkey++] = serial;
+            key[nkey++] = serial >> 32;
+        }
+    }
+    return nkey;
+}
+
+static CARD32
+GlyphRunHash(CARD32 *key, int nkey)
+{
+    CARD32 h = 2166136261u;
+    int i;
+
+    for (i = 0; i < nkey; i++)
+        h = (h ^ key[i]) * 16777619u;
+    return h ^ (h >> 16);
+}
+
+static GlyphRunPtr
+GlyphRunFind(ScreenPtr pScreen, PictFormatPtr maskFormat,
+             CARD32 hash, CARD32 *key, int nkey)
+{
+    struct xorg_list *bucket = &glyph_run_hash[hash % GLYPH_RUN_HASH_SIZE];
+    GlyphRunPtr run;
+
+    xorg_list_for_each_entry(run, bucket, link) {
+        if (run->hash == hash && run->pScreen == pScreen &&
+            run->maskFormat == maskFormat && run->nkey == nkey &&
+            memcmp(GlyphRunKeyData(run), key, nkey * sizeof(CARD32)) == 0)
+            return run;
+    }
+    return NULL;
+}
+
+#define NeedsComponent(f) (PICT_FORMAT_A(f) != 0 && PICT_FORMAT_RGB(f) != 0)
+
+/* Add the glyphs into a new mask, the way miGlyphs does */
+static Bool
+GlyphRunRender(GlyphRunPtr run, int nlist, GlyphListPtr list,
+               GlyphPtr * glyphs)
+{
+    ScreenPtr pScreen = run->pScreen;
+    PictFormatPtr maskFormat = run->maskFormat;
+    PicturePtr pPicture, pMask;
+    PixmapPtr pMaskPixmap;
+    CARD32 component_alpha;
+    GlyphPtr glyph;
+    GCPtr pGC;
+    xRectangle rect;
+    BoxRec extents;
+    int width, height;
+    int xOrigin = list->xOff, yOrigin = list->yOff;
+    int x, y, n;
+    int error;
+
+    miGlyphExtents(nlist, list, glyphs, &extents);
+    if (extents.x2 <= extents.x1 || extents.y2 <= extents.y1)
+        return FALSE;
+
+    /* Runs which miGlyphExtents clipped would only fit where they are */
+    if (extents.x1 == MINSHORT || extents.y1 == MINSHORT ||
+        extents.x2 == MAXSHORT || extents.y2 == MAXSHORT)
+        return FALSE;
+
+    width = extents.x2 - extents.x1;
+    height = extents.y2 - extents.y1;
+    if (width * height > GLYPH_RUN_MAX_AREA)
+        return FALSE;
+
+    pMaskPixmap = (*pScreen->CreatePixmap) (pScreen, width, height,
+                                            maskFormat->depth, 0);
+    if (!pMaskPixmap)
+        return FALSE;
+    component_alpha = NeedsComponent(maskFormat->format);
+    pMask = CreatePicture(0, &pMaskPixmap->drawable,
+                          maskFormat, CPComponentAlpha, &component_alpha,
+                          serverClient, &error);
+    /* The picture takes a reference to the pixmap, so we drop ours. */
+    (*pScreen->DestroyPixmap) (pMaskPixmap);
+    if (!pMask)
+        return FALSE;
+
+    pGC = GetScratchGC(pMaskPixmap->drawable.depth, pScreen);
+    ValidateGC(&pMaskPixmap->drawable, pGC);
+    rect.x = 0;
+    rect.y = 0;
+    rect.width = width;
+    rect.height = height;
+    (*pGC->ops->PolyFillRect) (&pMaskPixmap->drawable, pGC, 1, &rect);
+    FreeScratchGC(pGC);
+
+    x = -extents.x1;
+    y = -extents.y1;
+    while (nlist--) {
+        x += list->xOff;
+        y += list->yOff;
+        n = list->len;
+        while (n--) {
+            glyph = *glyphs++;
+            pPicture = GetGlyphPicture(glyph, pScreen);
+            if (pPicture)
+                CompositePicture(PictOpAdd, pPicture, None, pMask,
+                                 0, 0, 0, 0,
+                                 x - glyph->info.x, y - glyph->info.y,
+                                 glyph->info.width, glyph->info.height);
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+        }
+        list++;
+    }
+
+    run->mask = pMask;
+    run->extents.x1 = extents.x1 - xOrigin;
+    run->extents.y1 = extents.y1 - yOrigin;
+    run->extents.x2 = extents.x2 - xOrigin;
+    run->extents.y2 = extents.y2 - yOrigin;
+    run->size = width * height * BitsPerPixel(maskFormat->depth) / 8;
+    return TRUE;
+}
+
+/**
+ * Composite the glyphs from the cache of glyph runs.  Returns FALSE when
+ * the caller should draw them itself.
+ */
+Bool
+GlyphRunComposite(CARD8 op,
+                  PicturePtr pSrc,
+                  PicturePtr pDst,
+                  PictFormatPtr maskFormat,
+                  INT16 xSrc,
+                  INT16 ySrc, int nlist, GlyphListPtr list, GlyphPtr * glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    CARD32 key[GLYPH_RUN_MAX_KEY];
+    GlyphRunPtr run;
+    CARD32 hash;
+    int nkey, i;
+    int x, y;
+
+    if (!maskFormat || pScreen->isGPU)
+        return FALSE;
+
+    nkey = GlyphRunKey(key, nlist, list, glyphs);
+    if (!nkey)
+        return FALSE;
+
+    if (!glyph_run_lru.next) {
+        xorg_list_init(&glyph_run_lru);
+        for (i = 0; i < GLYPH_RUN_HASH_SIZE; i++)
+            xorg_list_init(&glyph_run_hash[i]);
+    }
+
+    hash = GlyphRunHash(key, nkey);
+    run = GlyphRunFind(pScreen, maskFormat, hash, key, nkey);
+
+    if (!run) {
+        /* Only remember it for now */
+        run = malloc(sizeof(GlyphRunRec) + nkey * sizeof(CARD32));
+        if (run) {
+            run->hash = hash;
+            run->pScreen = pScreen;
+            run->maskFormat = maskFormat;
+            run->mask = NULL;
+            run->size = 0;
+            run->nkey = nkey;
+            memcpy(GlyphRunKeyData(run), key, nkey * sizeof(CARD32));
+            xorg_list_add(&run->lru, &glyph_run_lru);
+            xorg_list_add(&run->link,
+                          &glyph_run_hash[hash % GLYPH_RUN_HASH_SIZE]);
+            glyph_run_entries++;
+            GlyphRunTrim();
+        }
+        GlyphRunAccount(FALSE);
+        return FALSE;
+    }
+
+    xorg_list_del(&run->lru);
+    xorg_list_add(&run->lru, &glyph_run_lru);
+
+    if (!run->mask) {
+        if (!GlyphRunRender(run, nlist, list, glyphs)) {
+            GlyphRunAccount(FALSE);
+            return FALSE;
+        }
+        glyph_run_size += run->size;
+        GlyphRunAccount(FALSE);
+    }
+    else
+        GlyphRunAccount(TRUE);
+
+    /* Where miGlyphs would have composited its mask */
+    x = list->xOff + run->extents.x1;
+    y = list->yOff + run->extents.y1;
+    if (x < MINSHORT || y < MINSHORT ||
+        x + run->extents.x2 - run->extents.x1 > MAXSHORT ||
+        y + run->extents.y2 - run->extents.y1 > MAXSHORT)
+        return FALSE;
+
+    CompositePicture(op, pSrc, run->mask, pDst,
+                     xSrc + x - list->xOff, ySrc + y - list->yOff,
+                     0, 0, x, y,
+                     run->extents.x2 - run->extents.x1,
+                     run->extents.y2 - run->extents.y1);
+
+    GlyphRunTrim();
+    return TRUE;
+}
+
+/* Drop the runs drawn on a screen which is going away */
+void
+GlyphRunUninit(ScreenPtr pScreen)
+{
+    GlyphRunPtr run, tmp;
+
+    if (!glyph_run_lru.next)
+        return;
+
+    xorg_list_for_each_entry_safe(run, tmp, &glyph_run_lru, lru) {
+        if (run->pScreen == pScreen)
+            GlyphRunFree(run);
+    }
+}
@@ -45,9 +45,14 @@ typedef struct _Glyph {
     unsigned char sha1[20];
     CARD32 size;                /* info + bitmap */
     xGlyphInfo info;
+    PictFormatPtr format;       /* of the pictures */
+    CARD8 *bits;
     /* per-screen pixmaps follow */
 } GlyphRec, *GlyphPtr;
 
+/* The bytes of sha1 holding the hash of the glyph contents */
+#define GLYPH_HASH_SIZE 8
+
 #define GlyphPicture(glyph) ((PicturePtr *) ((glyph) + 1))
 
 typedef struct _GlyphRef {
@@ -93,7 +98,16 @@ typedef struct _GlyphList {
 extern void
  GlyphUninit(ScreenPtr pScreen);
 
-extern GlyphPtr FindGlyphByHash(unsigned char sha1[20], int format);
+extern Bool
+GlyphRunComposite(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+                  PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+                  int nlist, GlyphListPtr list, GlyphPtr * glyphs);
+
+extern void
+ GlyphRunUninit(ScreenPtr pScreen);
+
+extern GlyphPtr FindGlyphByHash(unsigned char sha1[20], xGlyphInfo * gi,
+                                CARD8 *bits, unsigned long size, int format);
 
 extern int
 HashGlyph(xGlyphInfo * gi,
@@ -107,7 +121,9 @@ extern Bool
 
 extern GlyphPtr FindGlyph(GlyphSetPtr glyphSet, Glyph id);
 
-extern GlyphPtr AllocateGlyph(xGlyphInfo * gi, int format);
+extern GlyphPtr AllocateGlyph(xGlyphInfo * gi, PictFormatPtr format,
+                              CARD8 *bits, unsigned long bits_size,
+                              unsigned char sha1[20]);
 
 extern Bool
  ResizeGlyphSet(GlyphSetPtr glyphSet, CARD32 change);
@@ -77,6 +77,10 @@ extern _X_EXPORT Bool
 extern _X_EXPORT void
  miUnrealizeGlyph(ScreenPtr pScreen, GlyphPtr glyph);
 
+extern void
+miGlyphExtents(int nlist, GlyphListPtr list, GlyphPtr * glyphs,
+               BoxPtr extents);
+
 extern _X_EXPORT void
 
 miGlyphs(CARD8 op,
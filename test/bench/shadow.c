@@ -0,0 +1,197 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Time the shadow update functions on a full screen 3840x2160 update:
+ * shadowUpdateRotatePacked, the specialized shrot* variant for the depth
+ * and rotation, and shadowUpdateTiled on one thread and on a pool of
+ * worker threads.
+ *
+ * Not run by "make check"; build it with "make bench-shadow" in test/.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "scrnintstr.h"
+#include "pixmapstr.h"
+#include "shadow.h"
+#include "osdep.h"
+
+#define BENCH_WIDTH     3840
+#define BENCH_HEIGHT    2160
+#define BENCH_RUNS      20
+
+typedef struct {
+    ScreenRec screen;
+    PixmapRec pixmap;
+    DamageRec damage;
+    shadowBufRec buf;
+    CARD8 *fb;
+    int fb_stride;
+} shadow_bench_setup;
+
+static void *
+shadow_bench_window(ScreenPtr pScreen, CARD32 row, CARD32 offset, int mode,
+                    CARD32 *size, void *closure)
+{
+    shadow_bench_setup *s = closure;
+
+    *size = s->fb_stride - offset;
+    return s->fb + row * s->fb_stride + offset;
+}
+
+static void
+shadow_bench_init(shadow_bench_setup *s, int bpp, int randr)
+{
+    int stride = (BENCH_WIDTH * bpp / 8 + 3) & ~3;
+    BoxRec all = { 0, 0, BENCH_WIDTH, BENCH_HEIGHT };
+    int fb_width;
+    size_t i;
+
+    memset(s, 0, sizeof(*s));
+
+    s->screen.width = BENCH_WIDTH;
+    s->screen.height = BENCH_HEIGHT;
+
+    s->pixmap.drawable.type = DRAWABLE_PIXMAP;
+    s->pixmap.drawable.bitsPerPixel = bpp;
+    s->pixmap.drawable.depth = bpp == 32 ? 24 : bpp;
+    s->pixmap.drawable.width = BENCH_WIDTH;
+    s->pixmap.drawable.height = BENCH_HEIGHT;
+    s->pixmap.drawable.pScreen = &s->screen;
+    s->pixmap.devKind = stride;
+    s->pixmap.devPrivate.ptr = malloc((size_t) stride * BENCH_HEIGHT);
+    assert(s->pixmap.devPrivate.ptr);
+    for (i = 0; i < (size_t) stride * BENCH_HEIGHT; i++)
+        ((CARD8 *) s->pixmap.devPrivate.ptr)[i] = i * 0x9e3779b1u >> 24;
+
+    fb_width = randr & (SHADOW_ROTATE_90 | SHADOW_ROTATE_270) ?
+        BENCH_HEIGHT : BENCH_WIDTH;
+    s->fb_stride = (fb_width * bpp / 8 + 63) & ~63;
+    s->fb = calloc(BENCH_HEIGHT > BENCH_WIDTH ? BENCH_HEIGHT : BENCH_WIDTH,
+                   s->fb_stride);
+    assert(s->fb);
+
+    RegionInit(&s->damage.damage, &all, 1);
+
+    s->buf.pDamage = &s->damage;
+    s->buf.pPixmap = &s->pixmap;
+    s->buf.window = shadow_bench_window;
+    s->buf.closure = s;
+    s->buf.randr = randr;
+}
+
+static void
+shadow_bench_fini(shadow_bench_setup *s)
+{
+    RegionUninit(&s->damage.damage);
+    free(s->pixmap.devPrivate.ptr);
+    free(s->fb);
+}
+
+static void
+shadow_bench_one(int bpp, int randr, const char *name,
+                 ShadowUpdateProc update, WorkerPoolPtr pool)
+{
+    shadow_bench_setup s;
+    CARD64 start, end;
+    int i;
+
+    shadow_bench_init(&s, bpp, randr);
+    s.buf.pool = pool;
+
+    /* Warm up */
+    (*update) (&s.screen, &s.buf);
+
+    start = GetTimeInMicros();
+    for (i = 0; i < BENCH_RUNS; i++)
+        (*update) (&s.screen, &s.buf);
+    end = GetTimeInMicros();
+
+    printf("%2dbpp %3d: %-28s %8.2f ms\n", bpp,
+           randr == SHADOW_ROTATE_0 ? 0 :
+           randr == SHADOW_ROTATE_90 ? 90 :
+           randr == SHADOW_ROTATE_180 ? 180 : 270,
+           name, (end - start) / (BENCH_RUNS * 1000.0));
+
+    shadow_bench_fini(&s);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const struct {
+        int randr;
+        ShadowUpdateProc update[3];     /* 8, 16 and 32bpp */
+    } rotations[] = {
+        { SHADOW_ROTATE_0,
+          { shadowUpdatePacked, shadowUpdatePacked, shadowUpdatePacked } },
+        { SHADOW_ROTATE_90,
+          { shadowUpdateRotate8_90, shadowUpdateRotate16_90,
+            shadowUpdateRotate32_90 } },
+        { SHADOW_ROTATE_180,
+          { shadowUpdateRotate8_180, shadowUpdateRotate16_180,
+            shadowUpdateRotate32_180 } },
+        { SHADOW_ROTATE_270,
+          { shadowUpdateRotate8_270, shadowUpdateRotate16_270,
+            shadowUpdateRotate32_270 } },
+    };
+    static const int depths[] = { 8, 16, 32 };
+    WorkerPoolPtr pool;
+    char threaded[32];
+    int i, j;
+
+    server_poll = ospoll_create();
+    assert(server_poll);
+    pool = WorkerPoolCreate("shadow-bench",
+                            WorkerPoolDefaultThreads(SHADOW_TILE_MAX_TASKS -
+                                                     1));
+    assert(pool);
+    snprintf(threaded, sizeof(threaded), "shadowUpdateTiled, %d threads",
+             WorkerPoolThreads(pool) + 1);
+
+    printf("Full screen %dx%d shadow update:\n", BENCH_WIDTH, BENCH_HEIGHT);
+    for (i = 0; i < ARRAY_SIZE(rotations); i++) {
+        for (j = 0; j < ARRAY_SIZE(depths); j++) {
+            int bpp = depths[j], randr = rotations[i].randr;
+
+            shadow_bench_one(bpp, randr, "shadowUpdateRotatePacked",
+                             shadowUpdateRotatePacked, NULL);
+            shadow_bench_one(bpp, randr, "specialized",
+                             rotations[i].update[j], NULL);
+            shadow_bench_one(bpp, randr, "shadowUpdateTiled",
+                             shadowUpdateTiled, NULL);
+            shadow_bench_one(bpp, randr, threaded, shadowUpdateTiled, pool);
+        }
+    }
+
+    WorkerPoolDestroy(pool);
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Time pixman_composite_trapezoids against fbCompositeSpanTrapezoids,
+ * drawing OVER a 1920x1080 destination through an a8 mask: a filled
+ * circle in thin slices, stroked lines and small scattered shapes, the
+ * same loads test/trapezoids.c checks.
+ *
+ * Not run by "make check"; build it with "make bench-trapezoids" in test/.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "misc.h"
+#include "fb.h"
+#include "fbpict.h"
+#include "osdep.h"
+
+#define BENCH_WIDTH     1920
+#define BENCH_HEIGHT    1080
+#define BENCH_RUNS      20
+
+#define DoubleToFixed(d) ((xFixed) ((d) * 65536.0))
+
+typedef int (*trap_bench_shape) (xTrapezoid * traps, int width, int height);
+
+static uint32_t trap_bench_seed;
+
+static double
+trap_bench_random(double max)
+{
+    trap_bench_seed = trap_bench_seed * 1103515245 + 12345;
+    return (trap_bench_seed >> 8) * max / (1 << 24);
+}
+
+static void
+trap_bench_set(xTrapezoid * trap, double top, double bottom,
+               double l1, double l2, double r1, double r2)
+{
+    trap->top = DoubleToFixed(top);
+    trap->bottom = DoubleToFixed(bottom);
+    trap->left.p1.x = DoubleToFixed(l1);
+    trap->left.p1.y = trap->top;
+    trap->left.p2.x = DoubleToFixed(l2);
+    trap->left.p2.y = trap->bottom;
+    trap->right.p1.x = DoubleToFixed(r1);
+    trap->right.p1.y = trap->top;
+    trap->right.p2.x = DoubleToFixed(r2);
+    trap->right.p2.y = trap->bottom;
+}
+
+static int
+trap_bench_circle(xTrapezoid * traps, int width, int height)
+{
+    double r = min(width, height) * 0.45;
+    double cx = width / 2.0 + 0.3, cy = height / 2.0 + 0.7;
+    int i, n = 2 * r / 1.5;
+
+    for (i = 0; i < n; i++) {
+        double y1 = cy - r + 2 * r * i / n;
+        double y2 = cy - r + 2 * r * (i + 1) / n;
+        double w1 = sqrt(max(r * r - (y1 - cy) * (y1 - cy), 0));
+        double w2 = sqrt(max(r * r - (y2 - cy) * (y2 - cy), 0));
+
+        trap_bench_set(&traps[i], y1, y2, cx - w1, cx - w2, cx + w1, cx + w2);
+    }
+    return n;
+}
+
+static int
+trap_bench_strokes(xTrapezoid * traps, int width, int height)
+{
+    int i, n = 500;
+
+    for (i = 0; i < n; i++) {
+        double x1 = trap_bench_random(width), x2 = trap_bench_random(width);
+        double y1 = trap_bench_random(height), y2 = trap_bench_random(height);
+
+        if (y2 < y1 + 1)
+            y2 = y1 + 1;
+        trap_bench_set(&traps[i], y1, y2, x1, x2, x1 + 1.3, x2 + 1.3);
+    }
+    return n;
+}
+
+static int
+trap_bench_scatter(xTrapezoid * traps, int width, int height)
+{
+    int i, n = 3000;
+
+    for (i = 0; i < n; i++) {
+        double x = trap_bench_random(width - 8) - 4;
+        double y = trap_bench_random(height - 8) - 4;
+
+        trap_bench_set(&traps[i], y, y + 6.5, x + 2, x, x + 5, x + 7.25);
+    }
+    return n;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        trap_bench_shape shape;
+    } shapes[] = {
+        { "circle", trap_bench_circle },
+        { "strokes", trap_bench_strokes },
+        { "scatter", trap_bench_scatter },
+    };
+    pixman_color_t color = { 0x8000, 0x4000, 0xc000, 0xc000 };
+    BoxRec clip = { 0, 0, BENCH_WIDTH, BENCH_HEIGHT };
+    pixman_image_t *src, *dst;
+    xTrapezoid *traps;
+    CARD64 start, mid, end;
+    int i, j, ntrap;
+
+    /* For the worker pool of the span path */
+    server_poll = ospoll_create();
+    assert(server_poll);
+
+    traps = calloc(4096, sizeof(xTrapezoid));
+    assert(traps);
+    src = pixman_image_create_solid_fill(&color);
+    dst = pixman_image_create_bits(PIXMAN_a8r8g8b8, BENCH_WIDTH, BENCH_HEIGHT,
+                                   NULL, -1);
+    assert(src && dst);
+
+    printf("Trapezoids, OVER through an a8 mask on %dx%d:\n",
+           BENCH_WIDTH, BENCH_HEIGHT);
+    for (i = 0; i < ARRAY_SIZE(shapes); i++) {
+        trap_bench_seed = 1;
+        ntrap = (*shapes[i].shape) (traps, BENCH_WIDTH, BENCH_HEIGHT);
+
+        start = GetTimeInMicros();
+        for (j = 0; j < BENCH_RUNS; j++)
+            pixman_composite_trapezoids(PIXMAN_OP_OVER, src, dst, PIXMAN_a8,
+                                        0, 0, 0, 0, ntrap,
+                                        (pixman_trapezoid_t *) traps);
+        mid = GetTimeInMicros();
+        for (j = 0; j < BENCH_RUNS; j++)
+            fbCompositeSpanTrapezoids(PIXMAN_OP_OVER, src, dst, PIXMAN_a8,
+                                      0, 0, 0, 0, &clip, ntrap, traps);
+        end = GetTimeInMicros();
+
+        printf("%-8s %5d traps: pixman %8.2f ms, spans %8.2f ms\n",
+               shapes[i].name, ntrap,
+               (mid - start) / (BENCH_RUNS * 1000.0),
+               (end - mid) / (BENCH_RUNS * 1000.0));
+    }
+
+    pixman_image_unref(src);
+    pixman_image_unref(dst);
+    free(traps);
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check who gets to consume the frame buffers Xvfb exports, and what they
+ * may do with them.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "misc.h"
+#include "osdep.h"
+#include "vfbexport.h"
+
+#include "tests-common.h"
+
+#ifdef VFB_EXPORT
+
+static int
+fbexport_connect(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+
+    strcpy(addr.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    assert(fd >= 0);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Whether the server hung up on the consumer @fd */
+static Bool
+fbexport_refused(int fd)
+{
+    char buf[64];
+
+    return recv(fd, buf, sizeof(buf), MSG_DONTWAIT) == 0;
+}
+
+static void
+fbexport_socket_test(void)
+{
+    char dir[] = "/tmp/fbexport-XXXXXX";
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    int fd;
+
+    assert(mkdtemp(dir));
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/socket", dir);
+
+    /* Anything but a socket is left alone */
+    fd = open(addr.sun_path, O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0600);
+    assert(fd >= 0);
+    close(fd);
+    assert(!vfbExportInit(addr.sun_path, FALSE));
+    assert(lstat(addr.sun_path, &st) == 0 && S_ISREG(st.st_mode));
+    unlink(addr.sun_path);
+
+    /* A socket nobody listens on any more is replaced, with one only the
+     * server's user can connect to */
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    assert(fd >= 0);
+    assert(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+    close(fd);
+    assert(vfbExportInit(addr.sun_path, FALSE));
+    assert(lstat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode));
+    assert((st.st_mode & 0777) == 0600);
+
+    /* Consumers running as the server's user are kept */
+    fd = fbexport_connect(addr.sun_path);
+    assert(fd >= 0);
+    ospoll_wait(server_poll, 1000);
+    assert(!fbexport_refused(fd));
+    close(fd);
+
+    /* Those of anyone else are turned away; as the socket doesn't let them
+     * connect in the first place, pretend the server runs as someone else
+     */
+    if (geteuid() == 0) {
+        fd = fbexport_connect(addr.sun_path);
+        assert(fd >= 0);
+        assert(seteuid(65534) == 0);
+        ospoll_wait(server_poll, 1000);
+        assert(seteuid(0) == 0);
+        assert(fbexport_refused(fd));
+        close(fd);
+    }
+
+    /* One still in use isn't */
+    assert(!vfbExportInit(addr.sun_path, FALSE));
+    assert(lstat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode));
+
+    vfbExportFini();
+    assert(lstat(addr.sun_path, &st) < 0 && errno == ENOENT);
+    rmdir(dir);
+}
+
+static void
+fbexport_read_only_test(void)
+{
+    char *map, *ro_map;
+    int fd, ro;
+
+    fd = memfd_create("fbexport", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    assert(fd >= 0);
+    assert(ftruncate(fd, 4096) == 0);
+    map = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(map != MAP_FAILED);
+
+    ro = vfbExportReadOnlyFd(fd);
+    assert(ro >= 0);
+
+    /* Consumers see what the server draws, but can't draw themselves */
+    ro_map = mmap(NULL, 4096, PROT_READ, MAP_SHARED, ro, 0);
+    assert(ro_map != MAP_FAILED);
+    map[100] = 42;
+    assert(ro_map[100] == 42);
+    assert(mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, ro, 0) ==
+           MAP_FAILED);
+
+#ifdef F_SEAL_FUTURE_WRITE
+    /* Not even when reopening the descriptor for writing */
+    {
+        char path[32];
+        int rw;
+
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", ro);
+        rw = open(path, O_RDWR | O_CLOEXEC);
+        if (rw >= 0) {
+            assert(mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        rw, 0) == MAP_FAILED);
+            close(rw);
+        }
+    }
+#endif
+
+    munmap(ro_map, 4096);
+    munmap(map, 4096);
+    close(ro);
+    close(fd);
+}
+
+#endif                          /* VFB_EXPORT */
+
+int
+fbexport_test(void)
+{
+#ifdef VFB_EXPORT
+    if (!server_poll)
+        server_poll = ospoll_create();
+
+    fbexport_socket_test();
+    fbexport_read_only_test();
+#endif
+
+    return 0;
+}
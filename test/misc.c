@@ -30,6 +30,9 @@
 #include "scrnintstr.h"
 #include "dix.h"
 #include "dixstruct.h"
+#include "resource.h"
+#include "opaque.h"
+#include "osdep.h"
 
 #include "tests-common.h"
 
@@ -222,6 +225,165 @@ bswap_test(void)
     assert(result_64 == expect_64);
 }
 
+static void
+dix_resource_id_check(int limit, unsigned int bits)
+{
+    XID all = (1U << RESOURCE_AND_CLIENT_COUNT) - 1;
+    XID id;
+    int client;
+
+    LimitClients = limit;
+    assert(ResourceClientBits() == bits);
+    assert(CLIENTOFFSET == RESOURCE_AND_CLIENT_COUNT - bits);
+
+    /* The two fields cover the XID exactly, and SERVER_BIT is in neither */
+    assert((RESOURCE_ID_MASK & RESOURCE_CLIENT_MASK) == 0);
+    assert((RESOURCE_ID_MASK | RESOURCE_CLIENT_MASK) == all);
+    assert(((RESOURCE_ID_MASK | RESOURCE_CLIENT_MASK) & SERVER_BIT) == 0);
+
+    /* Every client index fits, and round trips */
+    assert(limit <= (1 << bits));
+    for (client = 0; client < limit; client += max(limit / 7, 1)) {
+        id = ((XID) client << CLIENTOFFSET) | RESOURCE_ID_MASK;
+        assert(CLIENT_ID(id) == client);
+        assert(CLIENT_BITS(id) == (XID) client << CLIENTOFFSET);
+        assert(CLIENT_ID(id | SERVER_BIT) == client);
+        assert((id & RESOURCE_ID_MASK) == RESOURCE_ID_MASK);
+    }
+    id = ((XID) (limit - 1) << CLIENTOFFSET) | 1;
+    assert(CLIENT_ID(id) == limit - 1);
+}
+
+static void
+dix_resource_id_bits(void)
+{
+    int saved = LimitClients;
+    int limit;
+    unsigned int bits;
+
+    for (limit = 64, bits = 6; limit <= MAXCLIENTS; limit *= 2, bits++)
+        dix_resource_id_check(limit, bits);
+
+    /* Other limits get the client field of the next power of two */
+    dix_resource_id_check(65, 7);
+    dix_resource_id_check(3000, 12);
+    dix_resource_id_check(MAXCLIENTS - 1, 14);
+
+    /* And the cached split follows changes of the limit */
+    dix_resource_id_check(256, 8);
+    assert(RESOURCE_ID_MASK == 0x1fffff);
+    dix_resource_id_check(MAXCLIENTS, 14);
+    assert(RESOURCE_ID_MASK == 0x7fff);
+
+    LimitClients = saved;
+}
+
+struct worker_test_task {
+    int index;
+    int ran;
+    int done;
+    int *order;
+    int *ndone;
+};
+
+static int worker_tasks_ran;
+
+static void
+worker_test_run(void *data)
+{
+    struct worker_test_task *t = data;
+
+    t->ran++;
+    __atomic_fetch_add(&worker_tasks_ran, 1, __ATOMIC_RELAXED);
+}
+
+static void
+worker_test_done(void *data)
+{
+    struct worker_test_task *t = data;
+
+    /* The task has finished before its completion function runs */
+    assert(t->ran == 1);
+    t->done++;
+    t->order[(*t->ndone)++] = t->index;
+}
+
+static void
+worker_pool_run(int nthreads, int ntasks)
+{
+    struct worker_test_task *tasks = calloc(ntasks, sizeof(*tasks));
+    int *order = calloc(ntasks, sizeof(int));
+    int ndone = 0;
+    WorkerPoolPtr pool;
+    int i;
+
+    assert(tasks && order);
+
+    pool = WorkerPoolCreate("test", nthreads);
+    assert(pool);
+#if INPUTTHREAD
+    assert(WorkerPoolThreads(pool) > 0);
+    assert(nthreads <= 0 || WorkerPoolThreads(pool) <= nthreads);
+#else
+    assert(WorkerPoolThreads(pool) == 0);
+#endif
+
+    worker_tasks_ran = 0;
+    for (i = 0; i < ntasks; i++) {
+        tasks[i].index = i;
+        tasks[i].order = order;
+        tasks[i].ndone = &ndone;
+        assert(WorkerPoolQueue(pool, worker_test_run, worker_test_done,
+                               &tasks[i]));
+    }
+
+    WorkerPoolDrain(pool);
+    assert(__atomic_load_n(&worker_tasks_ran, __ATOMIC_RELAXED) == ntasks);
+    assert(ndone == ntasks);
+    for (i = 0; i < ntasks; i++) {
+        assert(tasks[i].ran == 1);
+        assert(tasks[i].done == 1);
+    }
+
+    /* A single thread completes tasks in the order they were queued */
+    if (WorkerPoolThreads(pool) <= 1) {
+        for (i = 0; i < ntasks; i++)
+            assert(order[i] == i);
+    }
+
+    /* Draining an idle pool returns right away */
+    WorkerPoolDrain(pool);
+    assert(ndone == ntasks);
+
+    /* Destroying the pool finishes tasks still queued */
+    ndone = 0;
+    for (i = 0; i < ntasks; i++) {
+        tasks[i].ran = tasks[i].done = 0;
+        assert(WorkerPoolQueue(pool, worker_test_run, worker_test_done,
+                               &tasks[i]));
+    }
+    WorkerPoolDestroy(pool);
+    assert(ndone == ntasks);
+
+    free(order);
+    free(tasks);
+}
+
+static void
+worker_pool_test(void)
+{
+    if (!server_poll)
+        server_poll = ospoll_create();
+    assert(server_poll);
+
+    assert(WorkerPoolThreads(NULL) == 0);
+    WorkerPoolDestroy(NULL);
+
+    worker_pool_run(1, 100);
+    worker_pool_run(4, 1000);
+    worker_pool_run(0, 1000);
+}
+
 int
 misc_test(void)
 {
@@ -229,6 +391,8 @@ misc_test(void)
     dix_update_desktop_dimensions();
     dix_request_size_checks();
     bswap_test();
+    dix_resource_id_bits();
+    worker_pool_test();
 
     return 0;
 }
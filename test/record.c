@@ -0,0 +1,223 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check the shared memory ring of the RECORD extension against readers
+ * which keep up, fall behind or corrupt the tail.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "misc.h"
+#include "ring.h"
+
+#include "tests-common.h"
+
+#ifdef RECORD_RING
+
+/* Build a message of len bytes holding elements protocol elements */
+static char *
+record_ring_message(int len, CARD32 elements, CARD8 fill)
+{
+    char *msg = malloc(len);
+
+    assert(msg);
+    memset(msg, fill, len);
+    ((xRecordEnableContextReply *) msg)->length =
+        (len - SIZEOF(xRecordEnableContextReply)) >> 2;
+    RecordRingMessageElements(msg) = elements;
+    return msg;
+}
+
+/* Check that len bytes of fill follow the header at ring position pos */
+static void
+record_ring_check(RecordRingPtr pRing, CARD32 pos, int len, CARD8 fill)
+{
+    int i;
+
+    for (i = SIZEOF(xRecordEnableContextReply); i < len; i++)
+        assert((CARD8) pRing->pData[(pos + i) & (pRing->size - 1)] == fill);
+}
+
+static RecordRingPtr
+record_ring_create(void)
+{
+    RecordRingPtr pRing;
+    int fd;
+
+    pRing = RecordRingCreate(0, FALSE, &fd);
+    assert(pRing);
+    close(fd);
+
+    assert(pRing->size == RECORD_RING_MIN_SIZE);
+    assert(pRing->pHeader->magic == XRecordRingMagic);
+    assert(pRing->pHeader->size == pRing->size);
+    assert(pRing->pHeader->head == 0);
+    return pRing;
+}
+
+static void
+record_ring_valid_tail(void)
+{
+    RecordRingPtr pRing = record_ring_create();
+    xRecordRingHeader *pHeader = pRing->pHeader;
+    int len = 4096;
+    char *msg = record_ring_message(len, 3, 0x5a);
+    CARD32 head;
+
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == (CARD32) len);
+    assert(pHeader->elements == 3);
+    /* The element count doesn't leak into the ring */
+    assert(RecordRingMessageElements(pRing->pData) == 0);
+    record_ring_check(pRing, 0, len, 0x5a);
+
+    /* Once consumed, there is room again */
+    pHeader->tail = pHeader->head;
+    RecordRingMessageElements(msg) = 1;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == (CARD32) (2 * len));
+    assert(pHeader->elements == 4);
+
+    /* Messages wrap around the end of the data area */
+    memset(msg + SIZEOF(xRecordEnableContextReply), 0xa5,
+           len - SIZEOF(xRecordEnableContextReply));
+    RecordRingMessageElements(msg) = 1;
+    pRing->head = pHeader->head = head = pRing->size - len / 2;
+    pHeader->tail = head;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == head + len);
+    record_ring_check(pRing, head, len, 0xa5);
+
+    /* Head counts bytes and wraps at 2^32 */
+    pRing->head = pHeader->head = head = 0xffffffff - 100;
+    pHeader->tail = head;
+    RecordRingMessageElements(msg) = 1;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == head + len);
+    record_ring_check(pRing, head, len, 0xa5);
+
+    free(msg);
+    RecordRingDestroy(pRing);
+}
+
+static void
+record_ring_full(void)
+{
+    RecordRingPtr pRing = record_ring_create();
+    xRecordRingHeader *pHeader = pRing->pHeader;
+    int len = 1000;
+    char *msg = record_ring_message(len, 1, 0x11);
+    char *big;
+    int n = 0;
+
+    while (RecordRingPut(pRing, msg, len)) {
+        RecordRingMessageElements(msg) = 1;
+        n++;
+    }
+    assert(n == pRing->size / len);
+    assert(pHeader->head == (CARD32) (n * len));
+    assert(pHeader->head - pHeader->tail <= pRing->size);
+
+    /* Nothing is written until the reader makes room */
+    assert(!RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == (CARD32) (n * len));
+    pHeader->tail = len;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head - pHeader->tail <= pRing->size);
+
+    /* A message larger than the ring never fits, and is never held back */
+    big = record_ring_message(pRing->size + 4, 1, 0x22);
+    pHeader->tail = pHeader->head;
+    assert(!RecordRingPut(pRing, big, pRing->size + 4));
+    assert(pHeader->head == pHeader->tail);
+    assert(!RecordRingDefer(pRing, big, pRing->size + 4));
+    assert(pRing->backlogBytes == 0);
+
+    /* Held back messages are bounded */
+    n = 0;
+    while (RecordRingDefer(pRing, msg, len))
+        n++;
+    assert(n == RECORD_RING_BACKLOG * pRing->size / len);
+    assert(pRing->backlogBytes <= RECORD_RING_BACKLOG * pRing->size);
+
+    free(big);
+    free(msg);
+    RecordRingDestroy(pRing);
+}
+
+static void
+record_ring_corrupt_tail(void)
+{
+    RecordRingPtr pRing = record_ring_create();
+    xRecordRingHeader *pHeader = pRing->pHeader;
+    int len = 2048;
+    char *msg = record_ring_message(len, 1, 0x33);
+    CARD32 tail;
+
+    assert(RecordRingPut(pRing, msg, len));
+
+    /* A tail ahead of head empties the ring, writing restarts at tail */
+    tail = pHeader->head + 12345;
+    pHeader->tail = tail;
+    RecordRingMessageElements(msg) = 1;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == tail + len);
+    assert(pRing->head == pHeader->head);
+    record_ring_check(pRing, tail, len, 0x33);
+
+    /* As does one too far behind */
+    tail = pHeader->head - pRing->size - 4;
+    pHeader->tail = tail;
+    RecordRingMessageElements(msg) = 1;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == tail + len);
+
+    /* The server doesn't trust head in shared memory either */
+    pHeader->head = 0x80000000;
+    pHeader->tail = pRing->head;
+    RecordRingMessageElements(msg) = 1;
+    assert(RecordRingPut(pRing, msg, len));
+    assert(pHeader->head == tail + 2 * len);
+
+    free(msg);
+    RecordRingDestroy(pRing);
+}
+
+#endif                          /* RECORD_RING */
+
+int
+record_test(void)
+{
+#ifdef RECORD_RING
+    record_ring_valid_tail();
+    record_ring_full();
+    record_ring_corrupt_tail();
+#endif
+
+    return 0;
+}
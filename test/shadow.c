@@ -0,0 +1,429 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check shadowUpdateTiled against shadowUpdateRotatePacked, on one thread
+ * and split over worker threads, and shadowDiffDamage against what was
+ * actually changed.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "scrnintstr.h"
+#include "pixmapstr.h"
+#include "shadow.h"
+#include "osdep.h"
+
+#include "tests-common.h"
+
+typedef struct {
+    CARD8 *bits;
+    int width;                  /* in bytes */
+    int height;
+    int stride;
+    int size;
+} shadow_test_fb;
+
+typedef struct {
+    ScreenRec screen;
+    PixmapRec pixmap;
+    DamageRec damage;
+    shadowBufRec buf;
+    shadow_test_fb fb;
+} shadow_test_setup;
+
+static void *
+shadow_test_window(ScreenPtr pScreen, CARD32 row, CARD32 offset, int mode,
+                   CARD32 *size, void *closure)
+{
+    shadow_test_fb *fb = closure;
+
+    *size = fb->stride - offset;
+    return fb->bits + row * fb->stride + offset;
+}
+
+static void
+shadow_test_init(shadow_test_setup *s, int width, int height, int bpp,
+                 int randr)
+{
+    int stride = (width * bpp / 8 + 3) & ~3;
+    int fb_width, fb_height;
+
+    memset(s, 0, sizeof(*s));
+
+    s->screen.width = width;
+    s->screen.height = height;
+
+    s->pixmap.drawable.type = DRAWABLE_PIXMAP;
+    s->pixmap.drawable.bitsPerPixel = bpp;
+    s->pixmap.drawable.depth = bpp == 32 ? 24 : 16;
+    s->pixmap.drawable.width = width;
+    s->pixmap.drawable.height = height;
+    s->pixmap.drawable.pScreen = &s->screen;
+    s->pixmap.devKind = stride;
+    s->pixmap.devPrivate.ptr = calloc(height, stride);
+    assert(s->pixmap.devPrivate.ptr);
+
+    if (randr & (SHADOW_ROTATE_90 | SHADOW_ROTATE_270)) {
+        fb_width = height;
+        fb_height = width;
+    }
+    else {
+        fb_width = width;
+        fb_height = height;
+    }
+
+    s->fb.width = fb_width * bpp / 8;
+    s->fb.height = fb_height;
+    s->fb.stride = s->fb.width + 16;
+    s->fb.size = fb_height * s->fb.stride;
+    s->fb.bits = calloc(1, s->fb.size);
+    assert(s->fb.bits);
+
+    RegionNull(&s->damage.damage);
+
+    s->buf.pDamage = &s->damage;
+    s->buf.pPixmap = &s->pixmap;
+    s->buf.window = shadow_test_window;
+    s->buf.closure = &s->fb;
+    s->buf.randr = randr;
+}
+
+static void
+shadow_test_fini(shadow_test_setup *s)
+{
+    RegionUninit(&s->damage.damage);
+    free(s->pixmap.devPrivate.ptr);
+    free(s->fb.bits);
+}
+
+static void
+shadow_test_fill(shadow_test_setup *s, BoxPtr box, uint32_t seed)
+{
+    CARD8 *bits = s->pixmap.devPrivate.ptr;
+    int x, y;
+
+    for (y = box->y1; y < box->y2; y++) {
+        for (x = box->x1; x < box->x2; x++) {
+            uint32_t p = (x * 0x9e3779b1u) ^ (y * 0x85ebca6bu) ^ seed;
+
+            if (s->pixmap.drawable.bitsPerPixel == 16)
+                ((CARD16 *) (bits + y * s->pixmap.devKind))[x] = p;
+            else
+                ((CARD32 *) (bits + y * s->pixmap.devKind))[x] = p;
+        }
+    }
+}
+
+static void
+shadow_test_damage(shadow_test_setup *s, BoxPtr boxes, int nbox)
+{
+    RegionRec region;
+    int i;
+
+    RegionEmpty(&s->damage.damage);
+    for (i = 0; i < nbox; i++) {
+        RegionInit(&region, &boxes[i], 1);
+        RegionUnion(&s->damage.damage, &s->damage.damage, &region);
+        RegionUninit(&region);
+    }
+}
+
+static void
+shadow_test_update(shadow_test_setup *s, ShadowUpdateProc update,
+                   CARD8 *fb)
+{
+    CARD8 *bits = s->fb.bits;
+
+    s->fb.bits = fb;
+    (*update) (&s->screen, &s->buf);
+    s->fb.bits = bits;
+}
+
+/*
+ * shadowUpdateRotatePacked works in whole FbBits, so it may write a pixel
+ * beyond the end of a row; only compare what is visible.
+ */
+static void
+shadow_test_compare(shadow_test_setup *s, CARD8 *reference)
+{
+    int y;
+
+    for (y = 0; y < s->fb.height; y++)
+        assert(memcmp(reference + y * s->fb.stride,
+                      s->fb.bits + y * s->fb.stride, s->fb.width) == 0);
+}
+
+static void
+shadow_test_tiled(int width, int height, int bpp, int randr,
+                  WorkerPoolPtr pool)
+{
+    BoxRec all = { 0, 0, width, height };
+    BoxRec boxes[] = {
+        { 0, 0, 1, 1 },
+        { 3, 5, 21, 9 },
+        { width / 3, height / 4, width - 7, height / 4 + 70 },
+        { width - 9, height - 3, width, height },
+        { 1, height / 2 + 40, 130, height / 2 + 45 },
+    };
+    shadow_test_setup s;
+    CARD8 *reference;
+    int i;
+
+    shadow_test_init(&s, width, height, bpp, randr);
+    s.buf.pool = pool;
+    reference = calloc(1, s.fb.size);
+    assert(reference);
+
+    /* A full update first */
+    shadow_test_fill(&s, &all, 0);
+    shadow_test_damage(&s, &all, 1);
+    shadow_test_update(&s, shadowUpdateRotatePacked, reference);
+    shadow_test_update(&s, shadowUpdateTiled, s.fb.bits);
+    shadow_test_compare(&s, reference);
+
+    /* Then some odd sized pieces, the rest must stay untouched */
+    for (i = 0; i < ARRAY_SIZE(boxes); i++) {
+        boxes[i].x2 = min(boxes[i].x2, width);
+        boxes[i].y2 = min(boxes[i].y2, height);
+        shadow_test_fill(&s, &boxes[i], 0x5a5a5a5a + i);
+    }
+    shadow_test_damage(&s, boxes, ARRAY_SIZE(boxes));
+    shadow_test_update(&s, shadowUpdateRotatePacked, reference);
+    shadow_test_update(&s, shadowUpdateTiled, s.fb.bits);
+    shadow_test_compare(&s, reference);
+
+    free(reference);
+    shadow_test_fini(&s);
+}
+
+static void
+shadow_tiled_test(void)
+{
+    static const int rotations[] = {
+        SHADOW_ROTATE_0, SHADOW_ROTATE_90,
+        SHADOW_ROTATE_180, SHADOW_ROTATE_270,
+    };
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(rotations); i++) {
+        shadow_test_tiled(173, 131, 16, rotations[i], NULL);
+        shadow_test_tiled(173, 131, 32, rotations[i], NULL);
+        shadow_test_tiled(64, 257, 16, rotations[i], NULL);
+        shadow_test_tiled(64, 257, 32, rotations[i], NULL);
+    }
+}
+
+/*
+ * Updates this large are split between the calling thread and the pool,
+ * into more pieces than there are threads
+ */
+static void
+shadow_tiled_threads_test(void)
+{
+    static const int rotations[] = {
+        SHADOW_ROTATE_0, SHADOW_ROTATE_90,
+        SHADOW_ROTATE_180, SHADOW_ROTATE_270,
+    };
+    WorkerPoolPtr pool;
+    int i;
+
+    if (!server_poll)
+        server_poll = ospoll_create();
+    assert(server_poll);
+
+    pool = WorkerPoolCreate("shadow-test", 3);
+    assert(pool);
+
+    for (i = 0; i < ARRAY_SIZE(rotations); i++) {
+        shadow_test_tiled(643, 517, 16, rotations[i], pool);
+        shadow_test_tiled(643, 517, 32, rotations[i], pool);
+    }
+
+    WorkerPoolDestroy(pool);
+}
+
+static void
+shadow_test_poke(shadow_test_setup *s, int x, int y, uint32_t p)
+{
+    CARD8 *bits = s->pixmap.devPrivate.ptr;
+
+    if (s->pixmap.drawable.bitsPerPixel == 16)
+        ((CARD16 *) (bits + y * s->pixmap.devKind))[x] = p;
+    else
+        ((CARD32 *) (bits + y * s->pixmap.devKind))[x] = p;
+}
+
+static void
+shadow_test_diff_check(shadow_test_setup *s, CARD8 *copy,
+                       xRectangle *expected, int nexpected)
+{
+    RegionPtr region = RegionFromRects(nexpected, expected, CT_NONE);
+
+    shadowDiffDamage(&s->screen, &s->buf, copy);
+    assert(RegionEqual(&s->damage.damage, region));
+    RegionDestroy(region);
+}
+
+static void
+shadow_diff_test_bpp(int bpp)
+{
+    BoxRec all = { 0, 0, 173, 131 };
+    BoxRec part = { 64, 64, 128, 128 };
+    xRectangle whole = { 0, 0, 173, 131 };
+    xRectangle changed[] = {
+        { 16, 37, 16, 1 },
+        { 96, 50, 16, 11 },
+        { 160, 128, 13, 3 },
+    };
+    xRectangle inside = { 64, 70, 16, 1 };
+    xRectangle outside = { 0, 5, 16, 1 };
+    shadow_test_setup s;
+    CARD8 *copy;
+    int x, y;
+
+    shadow_test_init(&s, all.x2, all.y2, bpp, SHADOW_ROTATE_0);
+    copy = calloc(all.y2, s.pixmap.devKind);
+    assert(copy);
+
+    /* Everything differs from the cleared copy, which catches up */
+    shadow_test_fill(&s, &all, 0x12345678);
+    shadow_test_damage(&s, &all, 1);
+    shadow_test_diff_check(&s, copy, &whole, 1);
+    assert(memcmp(copy, s.pixmap.devPrivate.ptr,
+                  all.y2 * s.pixmap.devKind) == 0);
+
+    /* Damage without changes goes away */
+    shadow_test_damage(&s, &all, 1);
+    shadow_test_diff_check(&s, copy, NULL, 0);
+
+    /* Only the changed rows of the changed tiles are left */
+    shadow_test_poke(&s, 20, 37, 1);
+    for (y = 50; y < 61; y++)
+        for (x = 100; x < 104; x++)
+            shadow_test_poke(&s, x, y, 2);
+    shadow_test_poke(&s, 172, 128, 3);
+    shadow_test_poke(&s, 160, 130, 3);
+    shadow_test_damage(&s, &all, 1);
+    shadow_test_diff_check(&s, copy, changed, ARRAY_SIZE(changed));
+    assert(memcmp(copy, s.pixmap.devPrivate.ptr,
+                  all.y2 * s.pixmap.devKind) == 0);
+
+    /* Changes outside the damage are neither reported nor copied */
+    shadow_test_poke(&s, 5, 5, 4);
+    shadow_test_poke(&s, 70, 70, 5);
+    shadow_test_damage(&s, &part, 1);
+    shadow_test_diff_check(&s, copy, &inside, 1);
+    assert(memcmp(copy, s.pixmap.devPrivate.ptr,
+                  all.y2 * s.pixmap.devKind) != 0);
+    shadow_test_damage(&s, &all, 1);
+    shadow_test_diff_check(&s, copy, &outside, 1);
+
+    free(copy);
+    shadow_test_fini(&s);
+}
+
+/*
+ * Large updates are shared with the pool, which mustn't change the
+ * outcome
+ */
+static void
+shadow_diff_threads_test_bpp(WorkerPoolPtr pool, int bpp)
+{
+    BoxRec all = { 0, 0, 643, 517 };
+    BoxRec boxes[] = {
+        { 0, 0, 1, 1 },
+        { 3, 5, 21, 9 },
+        { 200, 100, 600, 170 },
+        { 634, 514, 643, 517 },
+        { 1, 300, 130, 305 },
+    };
+    shadow_test_setup s;
+    CARD8 *copy[2];
+    RegionRec expected;
+    int round, i;
+
+    shadow_test_init(&s, all.x2, all.y2, bpp, SHADOW_ROTATE_0);
+    for (i = 0; i < 2; i++) {
+        copy[i] = calloc(all.y2, s.pixmap.devKind);
+        assert(copy[i]);
+    }
+    RegionNull(&expected);
+
+    shadow_test_fill(&s, &all, 0);
+    for (round = 0; round < 3; round++) {
+        for (i = 0; round && i < ARRAY_SIZE(boxes); i++)
+            shadow_test_fill(&s, &boxes[i], 0x5a5a5a5a + round * 8 + i);
+
+        s.buf.pool = NULL;
+        shadow_test_damage(&s, &all, 1);
+        shadowDiffDamage(&s.screen, &s.buf, copy[0]);
+        RegionCopy(&expected, &s.damage.damage);
+
+        s.buf.pool = pool;
+        shadow_test_damage(&s, &all, 1);
+        shadowDiffDamage(&s.screen, &s.buf, copy[1]);
+        assert(RegionEqual(&s.damage.damage, &expected));
+        assert(memcmp(copy[0], copy[1], all.y2 * s.pixmap.devKind) == 0);
+    }
+
+    RegionUninit(&expected);
+    for (i = 0; i < 2; i++)
+        free(copy[i]);
+    shadow_test_fini(&s);
+}
+
+static void
+shadow_diff_test(void)
+{
+    WorkerPoolPtr pool;
+
+    shadow_diff_test_bpp(16);
+    shadow_diff_test_bpp(32);
+
+    if (!server_poll)
+        server_poll = ospoll_create();
+    assert(server_poll);
+
+    pool = WorkerPoolCreate("shadow-test", 3);
+    assert(pool);
+    shadow_diff_threads_test_bpp(pool, 16);
+    shadow_diff_threads_test_bpp(pool, 32);
+    WorkerPoolDestroy(pool);
+}
+
+int
+shadow_test(void)
+{
+    shadow_tiled_test();
+    shadow_tiled_threads_test();
+    shadow_diff_test();
+
+    return 0;
+}
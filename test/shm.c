@@ -0,0 +1,112 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check the region ShmGetImageDamage fetches for a given damage.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+
+#include "misc.h"
+#include "regionstr.h"
+#include "resource.h"
+#include "shmint.h"
+
+#include "tests-common.h"
+
+static void
+shm_damage_add(RegionPtr pDamaged, int x1, int y1, int x2, int y2)
+{
+    BoxRec box = { x1, y1, x2, y2 };
+    RegionRec region;
+
+    RegionInit(&region, &box, 1);
+    RegionUnion(pDamaged, pDamaged, &region);
+    RegionUninit(&region);
+}
+
+static void
+shm_damage_clip_test(void)
+{
+    BoxRec box = { 10, 20, 110, 120 };
+    RegionRec damaged, region;
+    BoxPtr pbox;
+    int i;
+
+    RegionNull(&damaged);
+    RegionNull(&region);
+
+    /* Nothing damaged, nothing fetched */
+    ShmClipCaptureDamage(&region, &damaged, &box, 32);
+    assert(!RegionNotEmpty(&region));
+
+    /* Damage is clipped to the captured rectangle, box by box */
+    shm_damage_add(&damaged, 0, 0, 20, 30);
+    shm_damage_add(&damaged, 50, 60, 70, 80);
+    shm_damage_add(&damaged, 200, 200, 210, 210);
+    ShmClipCaptureDamage(&region, &damaged, &box, 32);
+    assert(RegionNumRects(&region) == 2);
+    pbox = RegionRects(&region);
+    assert(pbox[0].x1 == 10 && pbox[0].y1 == 20);
+    assert(pbox[0].x2 == 20 && pbox[0].y2 == 30);
+    assert(pbox[1].x1 == 50 && pbox[1].y1 == 60);
+    assert(pbox[1].x2 == 70 && pbox[1].y2 == 80);
+
+    /* Sub-byte pixels are fetched in whole rows */
+    ShmClipCaptureDamage(&region, &damaged, &box, 1);
+    assert(RegionNumRects(&region) == 1);
+    pbox = RegionRects(&region);
+    assert(pbox->x1 == box.x1 && pbox->x2 == box.x2);
+    assert(pbox->y1 == 20 && pbox->y2 == 80);
+
+    /* Fragmented damage is fetched as its extents */
+    RegionEmpty(&damaged);
+    for (i = 0; i <= SHM_CAPTURE_MAX_RECTS; i++)
+        shm_damage_add(&damaged, 10 + i, 20 + i, 11 + i, 21 + i);
+    ShmClipCaptureDamage(&region, &damaged, &box, 32);
+    assert(RegionNumRects(&region) == 1);
+    pbox = RegionRects(&region);
+    assert(pbox->x1 == 10 && pbox->y1 == 20);
+    assert(pbox->x2 == 11 + SHM_CAPTURE_MAX_RECTS);
+    assert(pbox->y2 == 21 + SHM_CAPTURE_MAX_RECTS);
+
+    /* Up to the limit, the boxes are kept */
+    RegionEmpty(&damaged);
+    for (i = 0; i < SHM_CAPTURE_MAX_RECTS; i++)
+        shm_damage_add(&damaged, 10 + i, 20 + i, 11 + i, 21 + i);
+    ShmClipCaptureDamage(&region, &damaged, &box, 16);
+    assert(RegionNumRects(&region) == SHM_CAPTURE_MAX_RECTS);
+
+    RegionUninit(&region);
+    RegionUninit(&damaged);
+}
+
+int
+shm_test(void)
+{
+    shm_damage_clip_test();
+
+    return 0;
+}
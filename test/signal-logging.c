@@ -29,6 +29,11 @@
 #include <unistd.h>
 #include "assert.h"
 #include "misc.h"
+#include "osdep.h"
+
+#if INPUTTHREAD
+#include <pthread.h>
+#endif
 
 #include "tests-common.h"
 
@@ -396,11 +401,110 @@ static void logging_format(void)
 }
 #pragma GCC diagnostic pop /* "-Wformat-security" */
 
+#if INPUTTHREAD
+
+#define LOG_STRESS_THREADS      4
+#define LOG_STRESS_MESSAGES     20000
+#define LOG_STRESS_PAD          200
+
+static int
+log_stress_pad(int id, int i)
+{
+    return (i * 7 + id * 13) % LOG_STRESS_PAD;
+}
+
+static void *
+log_stress_thread(void *arg)
+{
+    int id = (intptr_t) arg;
+    char pad[LOG_STRESS_PAD];
+    int i;
+
+    memset(pad, 'a' + id, sizeof(pad));
+    for (i = 0; i < LOG_STRESS_MESSAGES; i++)
+        LogMessageVerb(X_INFO, 1, "stress %d %d %.*s\n", id, i,
+                       log_stress_pad(id, i), pad);
+
+    return NULL;
+}
+
+/*
+ * Several threads logging through the writer thread at once, wrapping
+ * around the ring many times over.  Every message must come out whole
+ * and in order, or be counted as dropped.
+ */
+static void
+logging_threads(void)
+{
+    const char *log_file_path = "/tmp/Xorg-logging-threads-test.log";
+    pthread_t threads[LOG_STRESS_THREADS];
+    int last[LOG_STRESS_THREADS];
+    int received = 0, dropped = 0;
+    char read_buf[2048];
+    FILE *f;
+    int i;
+
+    LogInit(log_file_path, NULL);
+    LogSetParameter(XLOG_VERBOSITY, 0);
+    LogSetParameter(XLOG_FILE_VERBOSITY, 1);
+    LogThreadInit();
+
+    for (i = 0; i < LOG_STRESS_THREADS; i++) {
+        last[i] = -1;
+        assert(pthread_create(&threads[i], NULL, log_stress_thread,
+                              (void *) (intptr_t) i) == 0);
+    }
+    for (i = 0; i < LOG_STRESS_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    /* Writes out whatever is still queued */
+    LogClose(EXIT_NO_ERROR);
+
+    assert(f = fopen(log_file_path, "r"));
+    while (fgets(read_buf, sizeof(read_buf), f)) {
+        char *msg;
+        int id, seq, n, pad;
+        unsigned count;
+
+        if ((msg = strstr(read_buf, "(II) stress "))) {
+            assert(sscanf(msg, "(II) stress %d %d%n", &id, &seq, &n) == 2);
+            assert(id >= 0 && id < LOG_STRESS_THREADS);
+            assert(seq > last[id] && seq < LOG_STRESS_MESSAGES);
+            last[id] = seq;
+
+            assert(msg[n] == ' ');
+            msg += n + 1;
+            pad = log_stress_pad(id, seq);
+            for (i = 0; i < pad; i++)
+                assert(msg[i] == 'a' + id);
+            assert(strcmp(msg + pad, "\n") == 0);
+            received++;
+        }
+        else if ((msg = strstr(read_buf, "(WW) "))) {
+            assert(sscanf(msg, "(WW) %u log messages dropped", &count) == 1);
+            dropped += count;
+        }
+        else
+            assert(strstr(read_buf, "Server terminated"));
+    }
+    fclose(f);
+
+    assert(received > 0);
+    assert(received + dropped == LOG_STRESS_THREADS * LOG_STRESS_MESSAGES);
+
+    unlink(log_file_path);
+}
+
+#endif /* INPUTTHREAD */
+
 int
 signal_logging_test(void)
 {
     number_formatting();
     logging_format();
+#if INPUTTHREAD
+    logging_threads();
+#endif
 
     return 0;
 }
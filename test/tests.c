@@ -12,8 +12,11 @@ main(int argc, char **argv)
     run_test(fixes_test);
     run_test(input_test);
     run_test(misc_test);
+    run_test(record_test);
+    run_test(shadow_test);
     run_test(signal_logging_test);
     run_test(touch_test);
+    run_test(trapezoids_test);
     run_test(xfree86_test);
     run_test(xkb_test);
     run_test(xtest_test);
@@ -22,6 +25,14 @@ main(int argc, char **argv)
     run_test(hashtabletest_test);
 #endif
 
+#ifdef MITSHM_TESTS
+    run_test(shm_test);
+#endif
+
+#ifdef XVFB_TESTS
+    run_test(fbexport_test);
+#endif
+
 #ifdef LDWRAP_TESTS
     run_test(protocol_xchangedevicecontrol_test);
 
@@ -0,0 +1,355 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check fbCompositeSpanTrapezoids against pixman_composite_trapezoids, on
+ * the kind of trapezoids cairo sends for antialiased fills and strokes,
+ * and triangles split by fbTriangleToTrapezoids and drawn with it against
+ * pixman_composite_triangles.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.h"
+#include "fb.h"
+#include "fbpict.h"
+
+#include "tests-common.h"
+
+#define DoubleToFixed(d) ((xFixed) ((d) * 65536.0))
+
+typedef int (*trap_test_shape) (xTrapezoid * traps, int width, int height);
+
+static uint32_t trap_test_seed;
+
+static double
+trap_test_random(double max)
+{
+    trap_test_seed = trap_test_seed * 1103515245 + 12345;
+    return (trap_test_seed >> 8) * max / (1 << 24);
+}
+
+static void
+trap_test_set(xTrapezoid * trap, double top, double bottom,
+              double l1, double l2, double r1, double r2)
+{
+    trap->top = DoubleToFixed(top);
+    trap->bottom = DoubleToFixed(bottom);
+    trap->left.p1.x = DoubleToFixed(l1);
+    trap->left.p1.y = trap->top;
+    trap->left.p2.x = DoubleToFixed(l2);
+    trap->left.p2.y = trap->bottom;
+    trap->right.p1.x = DoubleToFixed(r1);
+    trap->right.p1.y = trap->top;
+    trap->right.p2.x = DoubleToFixed(r2);
+    trap->right.p2.y = trap->bottom;
+}
+
+/* A filled circle, in thin horizontal slices */
+static int
+trap_test_circle(xTrapezoid * traps, int width, int height)
+{
+    double r = min(width, height) * 0.45;
+    double cx = width / 2.0 + 0.3, cy = height / 2.0 + 0.7;
+    int i, n = 2 * r / 1.5;
+
+    for (i = 0; i < n; i++) {
+        double y1 = cy - r + 2 * r * i / n;
+        double y2 = cy - r + 2 * r * (i + 1) / n;
+        double w1 = sqrt(max(r * r - (y1 - cy) * (y1 - cy), 0));
+        double w2 = sqrt(max(r * r - (y2 - cy) * (y2 - cy), 0));
+
+        trap_test_set(&traps[i], y1, y2, cx - w1, cx - w2, cx + w1, cx + w2);
+    }
+    return n;
+}
+
+/* Stroked lines, a pixel and a bit wide */
+static int
+trap_test_strokes(xTrapezoid * traps, int width, int height)
+{
+    int i, n = 500;
+
+    for (i = 0; i < n; i++) {
+        double x1 = trap_test_random(width), x2 = trap_test_random(width);
+        double y1 = trap_test_random(height), y2 = trap_test_random(height);
+
+        if (y2 < y1 + 1)
+            y2 = y1 + 1;
+        trap_test_set(&traps[i], y1, y2, x1, x2, x1 + 1.3, x2 + 1.3);
+    }
+    return n;
+}
+
+/* Small shapes all over, like text drawn as paths */
+static int
+trap_test_scatter(xTrapezoid * traps, int width, int height)
+{
+    int i, n = 3000;
+
+    for (i = 0; i < n; i++) {
+        double x = trap_test_random(width - 8) - 4;
+        double y = trap_test_random(height - 8) - 4;
+
+        trap_test_set(&traps[i], y, y + 6.5, x + 2, x, x + 5, x + 7.25);
+    }
+    return n;
+}
+
+static const struct {
+    const char *name;
+    trap_test_shape shape;
+} trap_test_shapes[] = {
+    { "circle", trap_test_circle },
+    { "strokes", trap_test_strokes },
+    { "scatter", trap_test_scatter },
+};
+
+typedef int (*tri_test_shape) (xTriangle * tris, int width, int height);
+
+static void
+tri_test_set(xTriangle * tri, double x1, double y1,
+             double x2, double y2, double x3, double y3)
+{
+    tri->p1.x = DoubleToFixed(x1);
+    tri->p1.y = DoubleToFixed(y1);
+    tri->p2.x = DoubleToFixed(x2);
+    tri->p2.y = DoubleToFixed(y2);
+    tri->p3.x = DoubleToFixed(x3);
+    tri->p3.y = DoubleToFixed(y3);
+}
+
+/* A filled circle, as a fan of thin triangles around its center */
+static int
+tri_test_fan(xTriangle * tris, int width, int height)
+{
+    double r = min(width, height) * 0.45;
+    double cx = width / 2.0 + 0.3, cy = height / 2.0 + 0.7;
+    int i, n = 200;
+
+    for (i = 0; i < n; i++) {
+        double a1 = 2 * M_PI * i / n, a2 = 2 * M_PI * (i + 1) / n;
+
+        tri_test_set(&tris[i], cx, cy,
+                     cx + r * cos(a1), cy + r * sin(a1),
+                     cx + r * cos(a2), cy + r * sin(a2));
+    }
+    return n;
+}
+
+/* Small triangles all over, with their vertices in any order */
+static int
+tri_test_scatter(xTriangle * tris, int width, int height)
+{
+    int i, n = 2000;
+
+    for (i = 0; i < n; i++) {
+        double x = trap_test_random(width - 8) - 4;
+        double y = trap_test_random(height - 8) - 4;
+        double y1 = y + trap_test_random(7);
+        double y2 = y + trap_test_random(7);
+        double y3 = y + trap_test_random(7);
+
+        /* Some with a flat top or bottom */
+        if (i % 3 == 0)
+            y2 = y1;
+        tri_test_set(&tris[i], x + trap_test_random(7), y1,
+                     x + trap_test_random(7), y2, x + trap_test_random(7), y3);
+    }
+    return n;
+}
+
+static const struct {
+    const char *name;
+    tri_test_shape shape;
+} tri_test_shapes[] = {
+    { "fan", tri_test_fan },
+    { "scatter", tri_test_scatter },
+};
+
+static pixman_image_t *
+trap_test_dst(int width, int height)
+{
+    pixman_image_t *dst;
+    uint32_t *bits;
+    int i;
+
+    dst = pixman_image_create_bits(PIXMAN_a8r8g8b8, width, height, NULL, -1);
+    assert(dst);
+    bits = pixman_image_get_data(dst);
+    for (i = 0; i < width * height; i++)
+        bits[i] = i * 0x9e3779b1u;
+    return dst;
+}
+
+static void
+trap_test_one(trap_test_shape shape, pixman_op_t op,
+              pixman_format_code_t format, int width, int height,
+              BoxPtr clip)
+{
+    pixman_color_t color = { 0x8000, 0x4000, 0xc000, 0xc000 };
+    pixman_image_t *src, *ref, *dst;
+    pixman_region16_t region;
+    xTrapezoid *traps;
+    BoxRec box;
+    int ntrap;
+
+    traps = calloc(4096, sizeof(xTrapezoid));
+    assert(traps);
+    trap_test_seed = 1;
+    ntrap = (*shape) (traps, width, height);
+
+    src = pixman_image_create_solid_fill(&color);
+    ref = trap_test_dst(width + 7, height + 5);
+    dst = trap_test_dst(width + 7, height + 5);
+
+    /* The trapezoids are drawn at (7, 5) in the destination, as for a
+     * window; the clip is in the destination's coordinates */
+    pixman_region_init_rect(&region, clip->x1, clip->y1,
+                            clip->x2 - clip->x1, clip->y2 - clip->y1);
+    pixman_image_set_clip_region(ref, &region);
+    pixman_image_set_clip_region(dst, &region);
+
+    pixman_composite_trapezoids(op, src, ref, format, 0, 0, 7, 5,
+                                ntrap, (pixman_trapezoid_t *) traps);
+
+    box.x1 = clip->x1 - 7;
+    box.y1 = clip->y1 - 5;
+    box.x2 = clip->x2 - 7;
+    box.y2 = clip->y2 - 5;
+    fbCompositeSpanTrapezoids(op, src, dst, format, 0, 0, 7, 5, &box,
+                              ntrap, traps);
+
+    assert(memcmp(pixman_image_get_data(ref), pixman_image_get_data(dst),
+                  pixman_image_get_stride(dst) * (height + 5)) == 0);
+
+    pixman_region_fini(&region);
+    pixman_image_unref(src);
+    pixman_image_unref(ref);
+    pixman_image_unref(dst);
+    free(traps);
+}
+
+static void
+tri_test_one(tri_test_shape shape, pixman_op_t op,
+             pixman_format_code_t format, int width, int height)
+{
+    pixman_color_t color = { 0x8000, 0x4000, 0xc000, 0xc000 };
+    pixman_image_t *src, *ref, *dst;
+    xTriangle *tris;
+    xTrapezoid *traps;
+    BoxRec box = { 0, 0, width, height };
+    int i, ntri;
+
+    tris = calloc(2048, sizeof(xTriangle));
+    traps = calloc(2 * 2048, sizeof(xTrapezoid));
+    assert(tris && traps);
+    trap_test_seed = 1;
+    ntri = (*shape) (tris, width, height);
+
+    src = pixman_image_create_solid_fill(&color);
+    ref = trap_test_dst(width, height);
+    dst = trap_test_dst(width, height);
+
+    pixman_composite_triangles(op, src, ref, format, 0, 0, 0, 0,
+                               ntri, (pixman_triangle_t *) tris);
+
+    /* As fbTriangles does it */
+    for (i = 0; i < ntri; i++)
+        fbTriangleToTrapezoids(&tris[i], &traps[2 * i]);
+    fbCompositeSpanTrapezoids(op, src, dst, format, 0, 0, 0, 0, &box,
+                              2 * ntri, traps);
+
+    assert(memcmp(pixman_image_get_data(ref), pixman_image_get_data(dst),
+                  pixman_image_get_stride(dst) * height) == 0);
+
+    pixman_image_unref(src);
+    pixman_image_unref(ref);
+    pixman_image_unref(dst);
+    free(traps);
+    free(tris);
+}
+
+static void
+tri_span_test(void)
+{
+    static const pixman_format_code_t formats[] = {
+        PIXMAN_a8, PIXMAN_a4, PIXMAN_a1,
+    };
+    int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(tri_test_shapes); i++) {
+        for (j = 0; j < ARRAY_SIZE(formats); j++) {
+            tri_test_one(tri_test_shapes[i].shape, PIXMAN_OP_OVER,
+                         formats[j], 300, 200);
+            tri_test_one(tri_test_shapes[i].shape, PIXMAN_OP_ADD,
+                         formats[j], 300, 200);
+        }
+    }
+}
+
+static void
+trap_span_test(void)
+{
+    static const pixman_format_code_t formats[] = {
+        PIXMAN_a8, PIXMAN_a4, PIXMAN_a1,
+    };
+    int i, j;
+
+    for (i = 0; i < ARRAY_SIZE(trap_test_shapes); i++) {
+        for (j = 0; j < ARRAY_SIZE(formats); j++) {
+            BoxRec all = { 0, 0, 300 + 7, 200 + 5 };
+            BoxRec part = { 40, 33, 211, 150 };
+
+            trap_test_one(trap_test_shapes[i].shape, PIXMAN_OP_OVER,
+                          formats[j], 300, 200, &all);
+            trap_test_one(trap_test_shapes[i].shape, PIXMAN_OP_ADD,
+                          formats[j], 300, 200, &all);
+            trap_test_one(trap_test_shapes[i].shape, PIXMAN_OP_OVER,
+                          formats[j], 300, 200, &part);
+        }
+
+        /* Large enough to be split between threads */
+        {
+            BoxRec all = { 0, 0, 1024 + 7, 768 + 5 };
+
+            trap_test_one(trap_test_shapes[i].shape, PIXMAN_OP_OVER,
+                          PIXMAN_a8, 1024, 768, &all);
+        }
+    }
+}
+
+int
+trapezoids_test(void)
+{
+    trap_span_test();
+    tri_span_test();
+
+    return 0;
+}
@@ -32,6 +32,8 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <stdio.h>
 #include <ctype.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include <X11/X.h>
 #include <X11/Xos.h>
 #include <X11/Xproto.h>
@@ -44,6 +46,7 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <xkbsrv.h>
 #include <X11/extensions/XI.h>
 #include "xkb.h"
+#include "xsha1.h"
 
 #define	PRE_ERROR_MSG "\"The XKEYBOARD keymap compiler (xkbcomp) reports:\""
 #define	ERROR_PREFIX	"\"> \""
@@ -57,7 +60,8 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #endif
 
 static unsigned
-LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn);
+LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn,
+        const char *cachePath);
 
 static void
 OutputDirectory(char *outdir, size_t size)
@@ -280,7 +284,7 @@ XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
         return 0;
     }
 
-    have = LoadXKM(want, need, map_name, xkbRtrn);
+    have = LoadXKM(want, need, map_name, xkbRtrn, NULL);
     free(map_name);
 
     return have;
@@ -322,8 +326,219 @@ XkbDDXOpenConfigFile(const char *mapName, char *fileNameRtrn, int fileNameRtrnLe
     return file;
 }
 
+/***====================================================================***/
+
+/*
+ * Compiled keymaps are kept on disk, named after the SHA1 of the RMLVO they
+ * were compiled from and of a fingerprint of the XKB data, so that starting
+ * a server or adding a keyboard doesn't have to run xkbcomp again.  The
+ * fingerprint covers the rules file, the component directories and xkbcomp
+ * itself; as it is based on their inodes and modification times, editing a
+ * component file in place requires touching its directory.
+ *
+ * As a stale entry silently gives the wrong keymap, the cache is only used
+ * when $XKB_CACHE_DIR names a directory for it.
+ */
+
+#ifndef WIN32
+/* Whether a cache file or directory could only have been written by us */
+static Bool
+XkbKeymapCacheTrusted(const struct stat *st)
+{
+    return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static const char *
+XkbKeymapCacheDir(void)
+{
+    static char dir[PATH_MAX];
+    static Bool done = FALSE;
+    const char *env = NULL;
+    struct stat st;
+
+    if (done)
+        return dir[0] ? dir : NULL;
+    done = TRUE;
+
+    /* Don't trust the environment of a setuid server */
+    if (getuid() == geteuid())
+        env = getenv("XKB_CACHE_DIR");
+
+    if (env && *env && (mkdir(env, 0700) == 0 || errno == EEXIST) &&
+        stat(env, &st) == 0 && S_ISDIR(st.st_mode) &&
+        XkbKeymapCacheTrusted(&st) &&
+        snprintf(dir, sizeof(dir), "%s/", env) >= sizeof(dir))
+        dir[0] = '\0';
+
+    return dir[0] ? dir : NULL;
+}
+
+static void
+XkbKeymapCacheHashString(void *ctx, const char *str)
+{
+    /* Include the terminator so that strings can't run together */
+    if (!str)
+        str = "";
+    x_sha1_update(ctx, (void *) str, strlen(str) + 1);
+}
+
+static void
+XkbKeymapCacheHashFile(void *ctx, const char *path)
+{
+    struct stat st;
+    CARD64 id[4] = { 0 };
+
+    if (stat(path, &st) == 0) {
+        id[0] = st.st_dev;
+        id[1] = st.st_ino;
+        id[2] = st.st_size;
+        id[3] = st.st_mtime;
+    }
+    x_sha1_update(ctx, id, sizeof(id));
+}
+
+/**
+ * Path of the compiled keymap for @rmlvo in the cache, or NULL if there is
+ * no cache.
+ */
+static char *
+XkbKeymapCachePath(XkbRMLVOSet * rmlvo, unsigned want, unsigned need)
+{
+    static const char *const components[] = {
+        "keycodes", "types", "compat", "symbols", "geometry"
+    };
+    const char *base = XkbBaseDirectory ? XkbBaseDirectory : "";
+    const char *dir = XkbKeymapCacheDir();
+    unsigned version = XkmFileVersion;
+    unsigned char sha1[20];
+    char name[sizeof(sha1) * 2 + 1], path[PATH_MAX];
+    char *cachePath;
+    void *ctx;
+    int i;
+
+    if (!dir)
+        return NULL;
+
+    ctx = x_sha1_init();
+    if (!ctx)
+        return NULL;
+
+    x_sha1_update(ctx, &version, sizeof(version));
+    XkbKeymapCacheHashString(ctx, rmlvo->rules);
+    XkbKeymapCacheHashString(ctx, rmlvo->model);
+    XkbKeymapCacheHashString(ctx, rmlvo->layout);
+    XkbKeymapCacheHashString(ctx, rmlvo->variant);
+    XkbKeymapCacheHashString(ctx, rmlvo->options);
+    x_sha1_update(ctx, &want, sizeof(want));
+    x_sha1_update(ctx, &need, sizeof(need));
+
+    XkbKeymapCacheHashString(ctx, base);
+    if (rmlvo->rules && strchr(rmlvo->rules, '/') == NULL &&
+        snprintf(path, sizeof(path), "%s/rules/%s", base,
+                 rmlvo->rules) < sizeof(path))
+        XkbKeymapCacheHashFile(ctx, path);
+    for (i = 0; i < ARRAY_SIZE(components); i++) {
+        if (snprintf(path, sizeof(path), "%s/%s", base,
+                     components[i]) < sizeof(path))
+            XkbKeymapCacheHashFile(ctx, path);
+    }
+
+    XkbKeymapCacheHashString(ctx, XkbBinDirectory);
+    if (XkbBinDirectory &&
+        snprintf(path, sizeof(path), "%s%sxkbcomp", XkbBinDirectory,
+                 PATHSEPARATOR) < sizeof(path))
+        XkbKeymapCacheHashFile(ctx, path);
+
+    if (!x_sha1_final(ctx, sha1))
+        return NULL;
+
+    for (i = 0; i < sizeof(sha1); i++)
+        snprintf(name + i * 2, 3, "%02x", sha1[i]);
+
+    if (asprintf(&cachePath, "%sxkm-%s.xkm", dir, name) < 0)
+        return NULL;
+    return cachePath;
+}
+
+/**
+ * Load the compiled keymap at @cachePath, if it is there and provides at
+ * least @need.
+ */
+static XkbDescPtr
+XkbKeymapCacheLoad(const char *cachePath, unsigned want, unsigned need)
+{
+    XkbDescPtr xkb = NULL;
+    struct stat st;
+    unsigned missing;
+    FILE *file;
+
+    file = fopen(cachePath, "rb");
+    if (!file)
+        return NULL;
+
+    /* Only trust what we wrote ourselves */
+    if (fstat(fileno(file), &st) < 0 || !XkbKeymapCacheTrusted(&st)) {
+        fclose(file);
+        return NULL;
+    }
+
+    missing = XkmReadFile(file, need, want, &xkb);
+    fclose(file);
+
+    if (!xkb || (need & missing)) {
+        if (xkb)
+            XkbFreeKeyboard(xkb, 0, TRUE);
+        (void) unlink(cachePath);
+        return NULL;
+    }
+
+    LogMessageVerb(X_INFO, 4, "XKB: Loaded compiled keymap %s\n", cachePath);
+    return xkb;
+}
+
+/**
+ * Copy the freshly compiled keymap in @fileName to @cachePath.  The copy is
+ * written to a temporary file first, so that other servers sharing the
+ * cache never see a partial keymap.
+ */
+static void
+XkbKeymapCacheStore(const char *fileName, const char *cachePath)
+{
+    char buf[4096], *tmp;
+    Bool written = TRUE;
+    FILE *in;
+    size_t n;
+    int fd;
+
+    in = fopen(fileName, "rb");
+    if (!in)
+        return;
+
+    if (asprintf(&tmp, "%s.XXXXXX", cachePath) < 0) {
+        fclose(in);
+        return;
+    }
+
+    fd = mkstemp(tmp);
+    if (fd >= 0) {
+        while (written && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+            written = write(fd, buf, n) == n;
+        written = written && !ferror(in);
+        close(fd);
+        if (!written || rename(tmp, cachePath) < 0)
+            unlink(tmp);
+    }
+
+    free(tmp);
+    fclose(in);
+}
+#endif                          /* WIN32 */
+
+/***====================================================================***/
+
 static unsigned
-LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
+LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn,
+        const char *cachePath)
 {
     FILE *file;
     char fileName[PATH_MAX];
@@ -347,16 +562,21 @@ LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
                (*xkbRtrn)->defined);
     }
     fclose(file);
+#ifndef WIN32
+    if (cachePath && !(need & missing))
+        XkbKeymapCacheStore(fileName, cachePath);
+#endif
     (void) unlink(fileName);
     return (need | want) & (~missing);
 }
 
-unsigned
-XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
-                        XkbComponentNamesPtr names,
-                        unsigned want,
-                        unsigned need,
-                        XkbDescPtr *xkbRtrn, char *nameRtrn, int nameRtrnLen)
+static unsigned
+LoadKeymapByNames(DeviceIntPtr keybd,
+                  XkbComponentNamesPtr names,
+                  unsigned want,
+                  unsigned need,
+                  XkbDescPtr *xkbRtrn, char *nameRtrn, int nameRtrnLen,
+                  const char *cachePath)
 {
     XkbDescPtr xkb;
 
@@ -379,7 +599,18 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
         return 0;
     }
 
-    return LoadXKM(want, need, nameRtrn, xkbRtrn);
+    return LoadXKM(want, need, nameRtrn, xkbRtrn, cachePath);
+}
+
+unsigned
+XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
+                        XkbComponentNamesPtr names,
+                        unsigned want,
+                        unsigned need,
+                        XkbDescPtr *xkbRtrn, char *nameRtrn, int nameRtrnLen)
+{
+    return LoadKeymapByNames(keybd, names, want, need, xkbRtrn,
+                             nameRtrn, nameRtrnLen, NULL);
 }
 
 Bool
@@ -458,11 +689,23 @@ XkbCompileKeymapForDevice(DeviceIntPtr dev, XkbRMLVOSet * rmlvo, int need)
     unsigned int provided;
     XkbComponentNamesRec kccgst = { 0 };
     char name[PATH_MAX];
+    char *cachePath = NULL;
+
+#ifndef WIN32
+    cachePath = XkbKeymapCachePath(rmlvo, XkmAllIndicesMask, need);
+    if (cachePath) {
+        xkb = XkbKeymapCacheLoad(cachePath, XkmAllIndicesMask, need);
+        if (xkb) {
+            free(cachePath);
+            return xkb;
+        }
+    }
+#endif
 
     if (XkbRMLVOtoKcCGST(dev, rmlvo, &kccgst)) {
         provided =
-            XkbDDXLoadKeymapByNames(dev, &kccgst, XkmAllIndicesMask, need, &xkb,
-                                    name, PATH_MAX);
+            LoadKeymapByNames(dev, &kccgst, XkmAllIndicesMask, need, &xkb,
+                              name, PATH_MAX, cachePath);
         if ((need & provided) != need) {
             if (xkb) {
                 XkbFreeKeyboard(xkb, 0, TRUE);
@@ -472,6 +715,7 @@ XkbCompileKeymapForDevice(DeviceIntPtr dev, XkbRMLVOSet * rmlvo, int need)
     }
 
     XkbFreeComponentNames(&kccgst, FALSE);
+    free(cachePath);
     return xkb;
 }
 
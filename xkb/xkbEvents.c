@@ -165,6 +165,8 @@ XkbSendNewKeyboardNotify(DeviceIntPtr kbd, xkbNewKeyboardNotify * pNKN)
     Time time = GetTimeInMillis();
     CARD16 changed = pNKN->changed;
 
+    XkbKeymapChanged(kbd);
+
     pNKN->type = XkbEventCode + XkbEventBase;
     pNKN->xkbType = XkbNewKeyboardNotify;
 
@@ -270,6 +272,8 @@ XkbSendMapNotify(DeviceIntPtr kbd, xkbMapNotify * pMN)
     CARD16 changed = pMN->changed;
     XkbSrvInfoPtr xkbi = kbd->key->xkbInfo;
 
+    XkbKeymapChanged(kbd);
+
     pMN->minKeyCode = xkbi->desc->min_key_code;
     pMN->maxKeyCode = xkbi->desc->max_key_code;
     pMN->type = XkbEventCode + XkbEventBase;
@@ -612,6 +616,8 @@ XkbSendNamesNotify(DeviceIntPtr kbd, xkbNamesNotify * pEv)
     CARD16 changed, changedVirtualMods;
     CARD32 changedIndicators;
 
+    XkbKeymapChanged(kbd);
+
     interest = kbd->xkb_interest;
     if (!interest)
         return;
@@ -658,6 +664,8 @@ XkbSendCompatMapNotify(DeviceIntPtr kbd, xkbCompatMapNotify * pEv)
     Time time = 0;
     CARD16 firstSI = 0, nSI = 0, nTotalSI = 0;
 
+    XkbKeymapChanged(kbd);
+
     interest = kbd->xkb_interest;
     if (!interest)
         return;
@@ -851,6 +859,7 @@ XkbSendNotification(DeviceIntPtr kbd,
         memset(&in, 0, sizeof(xkbIndicatorNotify));
         in.state = sli->effectiveState;
         in.changed = pChanges->indicators.map_changes;
+        XkbKeymapChanged(kbd);
         XkbSendIndicatorNotify(kbd, XkbIndicatorMapNotify, &in);
     }
     if (pChanges->indicators.state_changes) {
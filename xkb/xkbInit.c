@@ -103,7 +103,18 @@ static char *XkbLayoutUsed = NULL;
 static char *XkbVariantUsed = NULL;
 static char *XkbOptionsUsed = NULL;
 
-static XkbDescPtr xkb_cached_map = NULL;
+/* Keymaps compiled from RMLVO, shared by all devices, most recently used
+ * first.  Devices built from the same one share its keymap serial. */
+#define XKB_NUM_CACHED_MAPS 8
+
+typedef struct {
+    XkbRMLVOSet rmlvo;
+    XkbDescPtr xkb;
+    CARD32 serial;
+} XkbCachedMapRec, *XkbCachedMapPtr;
+
+static XkbCachedMapRec xkb_cached_maps[XKB_NUM_CACHED_MAPS];
+static int xkb_num_cached_maps = 0;
 
 static Bool XkbWantRulesProp = XKB_DFLT_RULES_PROP;
 
@@ -294,26 +305,80 @@ XkbDeleteRulesDflts(void)
     free(XkbOptionsDflt);
     XkbOptionsDflt = NULL;
 
-    XkbFreeKeyboard(xkb_cached_map, XkbAllComponentsMask, TRUE);
-    xkb_cached_map = NULL;
+    while (xkb_num_cached_maps > 0) {
+        XkbCachedMapPtr map = &xkb_cached_maps[--xkb_num_cached_maps];
+
+        XkbFreeKeyboard(map->xkb, XkbAllComponentsMask, TRUE);
+        XkbFreeRMLVOSet(&map->rmlvo, FALSE);
+    }
 }
 
 #define DIFFERS(a, b) (strcmp((a) ? (a) : "", (b) ? (b) : "") != 0)
 
-static Bool
-XkbCompareUsedRMLVO(XkbRMLVOSet * rmlvo)
+/**
+ * Find the keymap compiled for @rmlvo, if it is one of the most recently
+ * used ones.
+ */
+static XkbDescPtr
+XkbLookupCachedMap(XkbRMLVOSet * rmlvo, CARD32 *serial)
 {
-    if (DIFFERS(rmlvo->rules, XkbRulesUsed) ||
-        DIFFERS(rmlvo->model, XkbModelUsed) ||
-        DIFFERS(rmlvo->layout, XkbLayoutUsed) ||
-        DIFFERS(rmlvo->variant, XkbVariantUsed) ||
-        DIFFERS(rmlvo->options, XkbOptionsUsed))
-        return FALSE;
-    return TRUE;
+    XkbCachedMapRec hit;
+    int i;
+
+    for (i = 0; i < xkb_num_cached_maps; i++) {
+        XkbCachedMapPtr map = &xkb_cached_maps[i];
+
+        if (DIFFERS(rmlvo->rules, map->rmlvo.rules) ||
+            DIFFERS(rmlvo->model, map->rmlvo.model) ||
+            DIFFERS(rmlvo->layout, map->rmlvo.layout) ||
+            DIFFERS(rmlvo->variant, map->rmlvo.variant) ||
+            DIFFERS(rmlvo->options, map->rmlvo.options))
+            continue;
+
+        hit = *map;
+        memmove(&xkb_cached_maps[1], &xkb_cached_maps[0],
+                i * sizeof(XkbCachedMapRec));
+        xkb_cached_maps[0] = hit;
+        *serial = hit.serial;
+        return hit.xkb;
+    }
+
+    return NULL;
 }
 
 #undef DIFFERS
 
+/**
+ * Keep @xkb, compiled for @rmlvo, around for the next devices, in place of
+ * the least recently used keymap if need be.  Takes ownership of @xkb.
+ * Returns the keymap serial of the devices built from it.
+ */
+static CARD32
+XkbAddCachedMap(XkbRMLVOSet * rmlvo, XkbDescPtr xkb)
+{
+    XkbCachedMapPtr map;
+
+    if (xkb_num_cached_maps == XKB_NUM_CACHED_MAPS) {
+        map = &xkb_cached_maps[--xkb_num_cached_maps];
+        XkbFreeKeyboard(map->xkb, XkbAllComponentsMask, TRUE);
+        XkbFreeRMLVOSet(&map->rmlvo, FALSE);
+    }
+
+    memmove(&xkb_cached_maps[1], &xkb_cached_maps[0],
+            xkb_num_cached_maps * sizeof(XkbCachedMapRec));
+    xkb_num_cached_maps++;
+
+    map = &xkb_cached_maps[0];
+    map->rmlvo.rules = Xstrdup(rmlvo->rules);
+    map->rmlvo.model = Xstrdup(rmlvo->model);
+    map->rmlvo.layout = Xstrdup(rmlvo->layout);
+    map->rmlvo.variant = Xstrdup(rmlvo->variant);
+    map->rmlvo.options = Xstrdup(rmlvo->options);
+    map->xkb = xkb;
+    map->serial = XkbNextKeymapSerial();
+    return map->serial;
+}
+
 /***====================================================================***/
 
 #include "xkbDflts.h"
@@ -525,6 +590,8 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
     XkbChangesRec changes;
     XkbEventCauseRec cause;
     XkbRMLVOSet rmlvo_dflts = { NULL };
+    XkbDescPtr compiled = NULL, cached;
+    CARD32 serial = 0;
 
     BUG_RETURN_VAL(dev == NULL, FALSE);
     BUG_RETURN_VAL(dev->key != NULL, FALSE);
@@ -559,23 +626,26 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
     }
     dev->key->xkbInfo = xkbi;
 
-    if (xkb_cached_map && (keymap || (rmlvo && !XkbCompareUsedRMLVO(rmlvo)))) {
-        XkbFreeKeyboard(xkb_cached_map, XkbAllComponentsMask, TRUE);
-        xkb_cached_map = NULL;
-    }
-
-    if (xkb_cached_map)
+    cached = rmlvo ? XkbLookupCachedMap(rmlvo, &serial) : NULL;
+    if (cached)
         LogMessageVerb(X_INFO, 4, "XKB: Reusing cached keymap\n");
     else {
         if (rmlvo)
-            xkb_cached_map = XkbCompileKeymap(dev, rmlvo);
+            cached = XkbCompileKeymap(dev, rmlvo);
         else
-            xkb_cached_map = XkbCompileKeymapFromString(dev, keymap, keymap_length);
+            cached = compiled =
+                XkbCompileKeymapFromString(dev, keymap, keymap_length);
 
-        if (!xkb_cached_map) {
+        if (!cached) {
             ErrorF("XKB: Failed to compile keymap\n");
             goto unwind_info;
         }
+
+        /* Keymaps given as strings are rarely seen twice */
+        if (rmlvo)
+            serial = XkbAddCachedMap(rmlvo, cached);
+        else
+            serial = XkbNextKeymapSerial();
     }
 
     xkb = XkbAllocKeyboard();
@@ -584,14 +654,20 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
         goto unwind_info;
     }
 
-    if (!XkbCopyKeymap(xkb, xkb_cached_map)) {
+    if (!XkbCopyKeymap(xkb, cached)) {
         ErrorF("XKB: Failed to copy keymap\n");
         goto unwind_desc;
     }
-    xkb->defined = xkb_cached_map->defined;
-    xkb->flags = xkb_cached_map->flags;
-    xkb->device_spec = xkb_cached_map->device_spec;
+    xkb->defined = cached->defined;
+    xkb->flags = cached->flags;
+    xkb->device_spec = cached->device_spec;
     xkbi->desc = xkb;
+    xkbi->keymapSerial = serial;
+
+    if (compiled) {
+        XkbFreeKeyboard(compiled, XkbAllComponentsMask, TRUE);
+        compiled = NULL;
+    }
 
     if (xkb->min_key_code == 0)
         xkb->min_key_code = 8;
@@ -653,6 +729,8 @@ InitKeyboardDeviceStructInternal(DeviceIntPtr dev, XkbRMLVOSet * rmlvo,
  unwind_desc:
     XkbFreeKeyboard(xkb, 0, TRUE);
  unwind_info:
+    if (compiled)
+        XkbFreeKeyboard(compiled, XkbAllComponentsMask, TRUE);
     free(xkbi);
     dev->key->xkbInfo = NULL;
  unwind_kbdfeed:
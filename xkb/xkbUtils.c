@@ -2029,10 +2029,62 @@ XkbDeviceApplyKeymap(DeviceIntPtr dst, XkbDescPtr desc)
     return ret;
 }
 
+/**
+ * Keymap serials tell whether two devices have the same keymap without
+ * comparing them.  Devices whose keymaps were built from the same compiled
+ * keymap start out with the same serial, a device gets a fresh one
+ * whenever its keymap changes, and a copy takes the serial of its source.
+ * 0 is never handed out, and never matches.
+ */
+CARD32
+XkbNextKeymapSerial(void)
+{
+    static CARD32 serial;
+
+    if (++serial == 0)
+        ++serial;
+    return serial;
+}
+
+/**
+ * Called whenever the keymap of @kbd is changed in place, so that it is
+ * no longer taken for a copy of any other keymap.
+ */
+void
+XkbKeymapChanged(DeviceIntPtr kbd)
+{
+    if (kbd && kbd->key && kbd->key->xkbInfo)
+        kbd->key->xkbInfo->keymapSerial = XkbNextKeymapSerial();
+}
+
+/**
+ * Copy the keymap of @src to @dst, as happens whenever another slave
+ * drives a master keyboard.  If @dst already has the same keymap, only the
+ * controls are copied: this is the common case of several identical
+ * keyboards, and it spares both the copy and the NewKeyboardNotify which
+ * would have every client fetch the keymap again.
+ */
 Bool
 XkbCopyDeviceKeymap(DeviceIntPtr dst, DeviceIntPtr src)
 {
-    return XkbDeviceApplyKeymap(dst, src->key->xkbInfo->desc);
+    XkbSrvInfoPtr sxkbi, dxkbi;
+    CARD32 serial;
+
+    if (!dst->key || !src->key)
+        return FALSE;
+
+    sxkbi = src->key->xkbInfo;
+    dxkbi = dst->key->xkbInfo;
+    serial = sxkbi->keymapSerial;
+
+    if (serial && serial == dxkbi->keymapSerial)
+        return _XkbCopyControls(sxkbi->desc, dxkbi->desc);
+
+    if (!XkbDeviceApplyKeymap(dst, sxkbi->desc))
+        return FALSE;
+
+    dxkbi->keymapSerial = serial;
+    return TRUE;
 }
 
 int